@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+
+// Entry points for MediaForgeBench sub-commands. Each returns a process exit code.
+int runDecodeBench(int argc, char** argv);
+int runDemuxBench(int argc, char** argv);
+int runOpenBench(int argc, char** argv);
+int runConvertBench(int argc, char** argv);
+int runKernelBench(int argc, char** argv);
+
+class BenchTimer {
+public:
+    BenchTimer() : start_(std::chrono::steady_clock::now()) {}
+    double elapsedSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
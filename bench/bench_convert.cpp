@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "frame_converter.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// Per-frame pixel conversion latency for the decoder output formats we see most
+// (8-bit NV12 from hardware decoders, 10-bit P010 / yuv420p10le) at 1080p and 4K,
+// through FrameConverter: swscale across slice-thread counts (kernels disabled), then the
+// SIMD kernel at each level the CPU has. Uses synthetic frames so no input files are needed.
+
+struct ConvertCase {
+    AVPixelFormat srcFmt;
+    AVPixelFormat dstFmt;
+    int width;
+    int height;
+};
+
+static void fillPattern(AVFrame* frame) {
+    // A deterministic gradient; the content does not affect swscale's speed much,
+    // but zeroed planes would hide reads of uninitialized memory.
+    for (int p = 0; p < AV_NUM_DATA_POINTERS && frame->data[p]; p++) {
+        int rows = (p == 0) ? frame->height : (frame->height + 1) / 2;
+        for (int y = 0; y < rows; y++) {
+            uint8_t* row = frame->data[p] + (size_t)y * frame->linesize[p];
+            for (int x = 0; x < frame->linesize[p]; x++) {
+                row[x] = (uint8_t)((x + y * 3 + p * 64) & 0xFF);
+            }
+        }
+    }
+}
+
+// kernelLevel < 0 runs swscale with `threads` slices; otherwise the kernel capped at that level.
+static bool convertOnce(const ConvertCase& c, int threads, int kernelLevel, int frames, double& seconds,
+                        std::string& latency) {
+    AVFrame* src = av_frame_alloc();
+    AVFrame* dst = av_frame_alloc();
+    src->format = c.srcFmt;
+    src->width = c.width;
+    src->height = c.height;
+    dst->format = c.dstFmt;
+    dst->width = c.width;
+    dst->height = c.height;
+
+    bool ok = av_frame_get_buffer(src, 32) >= 0 && av_frame_get_buffer(dst, 32) >= 0;
+    FrameConverter converter;
+    converter.setKernelsEnabled(kernelLevel >= 0);
+    if (kernelLevel >= 0) converter.setMaxSimdLevel((SimdLevel)kernelLevel);
+    if (ok) {
+        fillPattern(src);
+        ok = converter.init(c.width, c.height, c.srcFmt, c.width, c.height, c.dstFmt, threads);
+        // Every case here has a kernel; a missing one would silently time swscale instead.
+        ok = ok && converter.usesKernel() == (kernelLevel >= 0);
+    }
+
+    BenchTimer timer;
+    for (int i = 0; ok && i < frames; i++) {
+        ok = converter.convert(src, dst);
+    }
+    seconds = timer.elapsedSeconds();
+
+    if (ok) latency = converter.latency().summary();
+
+    av_frame_free(&dst);
+    av_frame_free(&src);
+    return ok;
+}
+
+int runConvertBench(int argc, char** argv) {
+    int frames = 200;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    const ConvertCase cases[] = {
+        {AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P,     1920, 1080},
+        {AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P,     1920, 1080},
+        {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P,     1920, 1080},
+        {AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P,     3840, 2160},
+        {AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P,     3840, 2160},
+        {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P,     3840, 2160},
+        {AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P10LE, 3840, 2160},
+    };
+
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int t : {1, 2, 4, 8}) {
+        if (t <= cores) threadCounts.push_back(t);
+    }
+    threadCounts.push_back(0);
+
+    bool anyFailed = false;
+    for (const auto& c : cases) {
+        std::cout << std::endl << "== " << av_get_pix_fmt_name(c.srcFmt) << " -> " << av_get_pix_fmt_name(c.dstFmt)
+                  << " " << c.width << "x" << c.height << std::endl;
+        std::cout << std::left << std::setw(14) << "path" << std::right << std::setw(10) << "fps"
+                  << "  latency" << std::endl;
+
+        auto report = [&](const std::string& label, int threads, int kernelLevel) {
+            std::string latency;
+            double seconds = 0.0;
+            if (!convertOnce(c, threads, kernelLevel, frames, seconds, latency)) {
+                std::cout << std::left << std::setw(14) << label << "failed" << std::endl;
+                anyFailed = true;
+                return;
+            }
+            std::cout << std::left << std::setw(14) << label << std::right << std::setw(10)
+                      << std::fixed << std::setprecision(1) << (frames / seconds) << "  " << latency << std::endl;
+        };
+
+        for (int threads : threadCounts) {
+            report("sws " + (threads > 0 ? std::to_string(threads) : std::string("auto")), threads, -1);
+        }
+        for (int level = (int)SimdLevel::Scalar; level <= (int)PixelConvert::cpuLevel(); level++) {
+            report(std::string("kernel ") + PixelConvert::levelName((SimdLevel)level), 1, level);
+        }
+    }
+
+    return anyFailed ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+#include "bench.h"
+#include "demuxer.h"
+#include "video_decoder.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+// Measures software decode throughput for each threading / skip policy so decode threads
+// can be traded off against JobManager concurrency. Run it on representative 1080p and 4K inputs.
+
+struct DecodeSetting {
+    std::string label;
+    VideoDecoder::Options options;
+};
+
+static std::vector<DecodeSetting> buildSettings() {
+    std::vector<DecodeSetting> settings;
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+
+    std::vector<int> threadCounts = {1, 2, 4, 8};
+    if (cores > 8) threadCounts.push_back(cores);
+
+    for (int threads : threadCounts) {
+        if (threads > cores) continue;
+        for (auto type : {VideoDecoder::Options::ThreadType::Frame, VideoDecoder::Options::ThreadType::Slice}) {
+            DecodeSetting s;
+            s.options.threadCount = threads;
+            s.options.threadType = type;
+            s.label = std::to_string(threads) + (type == VideoDecoder::Options::ThreadType::Frame ? " frame" : " slice");
+            settings.push_back(s);
+        }
+    }
+
+    DecodeSetting autoSetting;
+    autoSetting.label = "auto";
+    settings.push_back(autoSetting);
+
+    DecodeSetting skipLoop;
+    skipLoop.label = "auto skip_loop_filter=nonref";
+    skipLoop.options.skipLoopFilter = AVDISCARD_NONREF;
+    settings.push_back(skipLoop);
+
+    DecodeSetting skipNonRef;
+    skipNonRef.label = "auto skip_frame=nonref";
+    skipNonRef.options.skipFrame = AVDISCARD_NONREF;
+    settings.push_back(skipNonRef);
+
+    return settings;
+}
+
+static bool decodeOnce(const std::string& path, const VideoDecoder::Options& options, int maxFrames,
+                       int& frames, double& seconds, int& width, int& height) {
+    Demuxer demuxer;
+    if (!demuxer.open(path)) return false;
+
+    int videoIdx = demuxer.getVideoStreamIndex();
+    if (videoIdx < 0) return false;
+
+    VideoDecoder decoder;
+    if (!decoder.open(demuxer.getStreams()[videoIdx].codecParams, false, options)) return false;
+    width = decoder.width();
+    height = decoder.height();
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    frames = 0;
+
+    BenchTimer timer;
+    while ((maxFrames <= 0 || frames < maxFrames) && demuxer.readPacket(packet)) {
+        if (packet->stream_index == videoIdx && decoder.sendPacket(packet)) {
+            while (decoder.receiveFrame(frame)) {
+                frames++;
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(packet);
+    }
+    if (decoder.sendPacket(nullptr)) {
+        while (decoder.receiveFrame(frame)) {
+            frames++;
+            av_frame_unref(frame);
+        }
+    }
+    seconds = timer.elapsedSeconds();
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return frames > 0;
+}
+
+int runDecodeBench(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    int maxFrames = 600;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            maxFrames = atoi(argv[++i]);
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "decode: no input files" << std::endl;
+        return 2;
+    }
+
+    std::vector<DecodeSetting> settings = buildSettings();
+    bool anyFailed = false;
+
+    for (const auto& input : inputs) {
+        std::cout << std::endl << "== " << input << std::endl;
+        std::cout << std::left << std::setw(32) << "setting" << std::right
+                  << std::setw(12) << "resolution" << std::setw(10) << "frames" << std::setw(10) << "fps" << std::endl;
+
+        for (const auto& setting : settings) {
+            int frames = 0, width = 0, height = 0;
+            double seconds = 0.0;
+            if (!decodeOnce(input, setting.options, maxFrames, frames, seconds, width, height)) {
+                std::cout << std::left << std::setw(32) << setting.label << "  failed" << std::endl;
+                anyFailed = true;
+                continue;
+            }
+
+            std::string resolution = std::to_string(width) + "x" + std::to_string(height);
+            std::cout << std::left << std::setw(32) << setting.label << std::right
+                      << std::setw(12) << resolution << std::setw(10) << frames
+                      << std::setw(10) << std::fixed << std::setprecision(1) << (frames / seconds) << std::endl;
+        }
+    }
+
+    return anyFailed ? 1 : 0;
+}
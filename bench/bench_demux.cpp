@@ -0,0 +1,187 @@
+#include "bench.h"
+#include "demuxer.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+
+// Measures packet demux throughput for each input mode (FFmpeg's file protocol, the
+// read-ahead thread, a memory mapping) as seen by remux and split jobs, where demuxing is
+// most of the work. Each mode runs several passes and reports the fastest, so with a warm
+// page cache the numbers compare I/O path overhead rather than the storage.
+
+struct DemuxMode {
+    const char* label;
+    size_t readAhead;
+    bool mapped;
+};
+
+static const DemuxMode kModes[] = {
+    {"file protocol", 0, false},
+    {"read-ahead", Demuxer::kDefaultReadAhead, false},
+    {"mmap", 0, true},
+};
+
+// Read syscalls issued by this process so far, or -1 where the kernel doesn't say.
+static long long readSyscalls() {
+#ifdef __linux__
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    long long value = 0;
+    while (io >> key >> value) {
+        if (key == "syscr:") return value;
+    }
+#endif
+    return -1;
+}
+
+struct DemuxResult {
+    long long packets = 0;
+    long long bytes = 0;
+    double seconds = 0.0;
+    double cpuSeconds = 0.0;
+    long long reads = -1;
+};
+
+static bool demuxOnce(const std::string& path, const DemuxMode& mode, DemuxResult& result) {
+    Demuxer demuxer;
+    demuxer.setReadAhead(mode.readAhead);
+    demuxer.setMemoryMapped(mode.mapped);
+
+    long long readsBefore = readSyscalls();
+    std::clock_t cpuStart = std::clock();
+    BenchTimer timer;
+    if (!demuxer.open(path)) return false;
+
+    AVPacket* packet = av_packet_alloc();
+    result.packets = 0;
+    result.bytes = 0;
+    while (demuxer.readPacket(packet)) {
+        result.packets++;
+        result.bytes += packet->size;
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    demuxer.close();
+
+    result.seconds = timer.elapsedSeconds();
+    result.cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    long long readsAfter = readSyscalls();
+    result.reads = (readsBefore >= 0 && readsAfter >= 0) ? readsAfter - readsBefore : -1;
+    return result.packets > 0;
+}
+
+int runDemuxBench(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    int passes = 3;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes = std::max(1, atoi(argv[++i]));
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "demux: no input files" << std::endl;
+        return 2;
+    }
+
+    bool anyFailed = false;
+
+    for (const auto& input : inputs) {
+        std::cout << std::endl << "== " << input << std::endl;
+        std::cout << std::left << std::setw(16) << "mode" << std::right << std::setw(10) << "packets"
+                  << std::setw(10) << "MB/s" << std::setw(10) << "cpu ms" << std::setw(12) << "read calls" << std::endl;
+
+        for (const auto& mode : kModes) {
+            DemuxResult best;
+            bool ok = false;
+            for (int pass = 0; pass < passes; pass++) {
+                DemuxResult result;
+                if (!demuxOnce(input, mode, result)) break;
+                if (!ok || result.seconds < best.seconds) best = result;
+                ok = true;
+            }
+            if (!ok) {
+                std::cout << std::left << std::setw(16) << mode.label << "  failed" << std::endl;
+                anyFailed = true;
+                continue;
+            }
+
+            double megabytes = best.bytes / (1024.0 * 1024.0);
+            std::cout << std::left << std::setw(16) << mode.label << std::right << std::setw(10) << best.packets
+                      << std::setw(10) << std::fixed << std::setprecision(1) << (megabytes / best.seconds)
+                      << std::setw(10) << (int)(best.cpuSeconds * 1000.0)
+                      << std::setw(12) << (best.reads >= 0 ? std::to_string(best.reads) : std::string("n/a")) << std::endl;
+        }
+    }
+
+    return anyFailed ? 1 : 0;
+}
+
+// Open latency per Demuxer probe level, and which tier each open ended at. Read-ahead is
+// off so the numbers don't include its initial fill.
+int runOpenBench(int argc, char** argv) {
+    static const struct {
+        const char* label;
+        Demuxer::Probe probe;
+    } kProbes[] = {
+        {"full", Demuxer::Probe::Full},
+        {"formats", Demuxer::Probe::Formats},
+        {"header", Demuxer::Probe::Header},
+    };
+
+    std::vector<std::string> inputs;
+    int passes = 3;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes = std::max(1, atoi(argv[++i]));
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "open: no input files" << std::endl;
+        return 2;
+    }
+
+    bool anyFailed = false;
+
+    for (const auto& input : inputs) {
+        std::cout << std::endl << "== " << input << std::endl;
+        std::cout << std::left << std::setw(12) << "probe" << std::right << std::setw(10) << "open ms"
+                  << "  " << "tier" << std::endl;
+
+        for (const auto& probe : kProbes) {
+            double best = -1.0;
+            std::string tier;
+            for (int pass = 0; pass < passes; pass++) {
+                Demuxer demuxer;
+                demuxer.setReadAhead(0);
+                demuxer.setProbe(probe.probe);
+                if (!demuxer.open(input)) break;
+                if (best < 0.0 || demuxer.openSeconds() < best) best = demuxer.openSeconds();
+                tier = demuxer.probeUsed();
+            }
+            if (best < 0.0) {
+                std::cout << std::left << std::setw(12) << probe.label << "  failed" << std::endl;
+                anyFailed = true;
+                continue;
+            }
+
+            std::cout << std::left << std::setw(12) << probe.label << std::right << std::setw(10) << std::fixed
+                      << std::setprecision(1) << (best * 1000.0) << "  " << tier << std::endl;
+        }
+    }
+
+    return anyFailed ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+#include "bench.h"
+#include "pixel_convert.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+// Checks every conversion kernel against swscale (the path it replaces) and against the
+// scalar kernel, then times each SIMD level next to single-threaded swscale.
+
+static AVFrame* allocFrame(AVPixelFormat fmt, int width, int height) {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = fmt;
+    frame->width = width;
+    frame->height = height;
+    if (av_frame_get_buffer(frame, 64) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+    return frame;
+}
+
+static int planeRows(const AVFrame* frame, int plane) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    return plane == 0 ? frame->height : AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+}
+
+// Random samples in the format's valid range (10-bit values stay 10-bit, P010 keeps its low bits clear).
+static void fillRandom(AVFrame* frame, unsigned seed) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    int depth = desc->comp[0].depth;
+    int shift = desc->comp[0].shift;
+    unsigned state = seed;
+    for (int p = 0; p < av_pix_fmt_count_planes((AVPixelFormat)frame->format); p++) {
+        int bytes = av_image_get_linesize((AVPixelFormat)frame->format, frame->width, p);
+        for (int y = 0; y < planeRows(frame, p); y++) {
+            uint8_t* row = frame->data[p] + (size_t)y * frame->linesize[p];
+            for (int x = 0; x < (depth > 8 ? bytes / 2 : bytes); x++) {
+                state = state * 1664525u + 1013904223u;
+                unsigned value = (state >> 8) & ((1u << depth) - 1);
+                if (depth > 8) ((uint16_t*)row)[x] = (uint16_t)(value << shift);
+                else row[x] = (uint8_t)value;
+            }
+        }
+    }
+}
+
+// Largest per-sample difference in the format's native precision.
+static int maxDifference(const AVFrame* a, const AVFrame* b) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)a->format);
+    bool wide = desc->comp[0].depth > 8;
+    int shift = desc->comp[0].shift;
+    int worst = 0;
+    for (int p = 0; p < av_pix_fmt_count_planes((AVPixelFormat)a->format); p++) {
+        int bytes = av_image_get_linesize((AVPixelFormat)a->format, a->width, p);
+        for (int y = 0; y < planeRows(a, p); y++) {
+            const uint8_t* ra = a->data[p] + (size_t)y * a->linesize[p];
+            const uint8_t* rb = b->data[p] + (size_t)y * b->linesize[p];
+            for (int x = 0; x < (wide ? bytes / 2 : bytes); x++) {
+                int va = wide ? ((const uint16_t*)ra)[x] >> shift : ra[x];
+                int vb = wide ? ((const uint16_t*)rb)[x] >> shift : rb[x];
+                worst = std::max(worst, std::abs(va - vb));
+            }
+        }
+    }
+    return worst;
+}
+
+static bool verifyPair(AVPixelFormat srcFmt, AVPixelFormat dstFmt, int width, int height) {
+    AVFrame* src = allocFrame(srcFmt, width, height);
+    AVFrame* ref = allocFrame(dstFmt, width, height);
+    AVFrame* scalar = allocFrame(dstFmt, width, height);
+    AVFrame* out = allocFrame(dstFmt, width, height);
+    SwsContext* sws = sws_getContext(width, height, srcFmt, width, height, dstFmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    bool ok = src && ref && scalar && out && sws;
+
+    if (ok) {
+        fillRandom(src, (unsigned)(width * 31 + height));
+        ok = sws_scale_frame(sws, ref, src) >= 0;
+    }
+
+    if (ok) {
+        PixelConvert::find(srcFmt, dstFmt, SimdLevel::Scalar).run(src, scalar);
+        // swscale dithers / rounds differently when it changes bit depth.
+        bool sameDepth = av_pix_fmt_desc_get(srcFmt)->comp[0].depth == av_pix_fmt_desc_get(dstFmt)->comp[0].depth;
+        int tolerance = sameDepth ? 0 : 1;
+        int diff = maxDifference(scalar, ref);
+        std::cout << "  " << width << "x" << height << " vs swscale: max diff " << diff
+                  << (diff <= tolerance ? "" : "  FAIL") << std::endl;
+        ok = diff <= tolerance;
+
+        for (int level = (int)SimdLevel::SSE41; level <= (int)PixelConvert::cpuLevel(); level++) {
+            PixelKernel kernel = PixelConvert::find(srcFmt, dstFmt, (SimdLevel)level);
+            kernel.run(src, out);
+            int simdDiff = maxDifference(out, scalar);
+            if (simdDiff != 0) {
+                std::cout << "  " << width << "x" << height << " " << PixelConvert::levelName(kernel.level)
+                          << " differs from scalar by " << simdDiff << "  FAIL" << std::endl;
+                ok = false;
+            }
+        }
+    }
+
+    sws_freeContext(sws);
+    av_frame_free(&out);
+    av_frame_free(&scalar);
+    av_frame_free(&ref);
+    av_frame_free(&src);
+    return ok;
+}
+
+static void timePair(AVPixelFormat srcFmt, AVPixelFormat dstFmt, int width, int height, int frames) {
+    AVFrame* src = allocFrame(srcFmt, width, height);
+    AVFrame* dst = allocFrame(dstFmt, width, height);
+    SwsContext* sws = sws_getContext(width, height, srcFmt, width, height, dstFmt, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (!src || !dst || !sws) {
+        std::cout << "  " << width << "x" << height << " setup failed" << std::endl;
+        sws_freeContext(sws);
+        av_frame_free(&dst);
+        av_frame_free(&src);
+        return;
+    }
+    fillRandom(src, 7);
+
+    std::cout << "  " << std::left << std::setw(11) << (std::to_string(width) + "x" + std::to_string(height)) << std::right;
+
+    BenchTimer swsTimer;
+    for (int i = 0; i < frames; i++) sws_scale_frame(sws, dst, src);
+    double swsMs = swsTimer.elapsedSeconds() * 1000.0 / frames;
+    std::cout << std::fixed << std::setprecision(2) << "swscale " << swsMs << " ms";
+
+    for (int level = (int)SimdLevel::Scalar; level <= (int)PixelConvert::cpuLevel(); level++) {
+        PixelKernel kernel = PixelConvert::find(srcFmt, dstFmt, (SimdLevel)level);
+        BenchTimer timer;
+        for (int i = 0; i < frames; i++) kernel.run(src, dst);
+        double ms = timer.elapsedSeconds() * 1000.0 / frames;
+        std::cout << "  " << PixelConvert::levelName(kernel.level) << " " << ms << " ms";
+    }
+    std::cout << std::endl;
+
+    sws_freeContext(sws);
+    av_frame_free(&dst);
+    av_frame_free(&src);
+}
+
+int runKernelBench(int argc, char** argv) {
+    int frames = 100;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    std::cout << "CPU level: " << PixelConvert::levelName(PixelConvert::cpuLevel()) << std::endl;
+
+    bool allOk = true;
+    for (const auto& pair : PixelConvert::supportedPairs()) {
+        std::cout << std::endl << "== " << av_get_pix_fmt_name(pair.first) << " -> " << av_get_pix_fmt_name(pair.second) << std::endl;
+        // Odd sizes exercise the scalar tails and the rounded-up chroma planes.
+        allOk &= verifyPair(pair.first, pair.second, 1280, 720);
+        allOk &= verifyPair(pair.first, pair.second, 645, 361);
+        timePair(pair.first, pair.second, 1920, 1080, frames);
+        timePair(pair.first, pair.second, 3840, 2160, frames);
+    }
+
+    std::cout << std::endl << (allOk ? "All kernels match." : "Kernel mismatches found.") << std::endl;
+    return allOk ? 0 : 1;
+}
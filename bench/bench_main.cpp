@@ -0,0 +1,48 @@
+#include "bench.h"
+#include <iostream>
+#include <string>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/log.h>
+}
+
+struct BenchCommand {
+    const char* name;
+    const char* usage;
+    int (*run)(int argc, char** argv);
+};
+
+static const BenchCommand kCommands[] = {
+    {"decode", "decode <input>... [--frames N]   decoder fps per threading setting", runDecodeBench},
+    {"demux", "demux <input>... [--passes N]    packet throughput and read calls per input mode", runDemuxBench},
+    {"open", "open <input>... [--passes N]     open latency per stream probe level", runOpenBench},
+    {"convert", "convert [--frames N]             pixel conversion latency per slice-thread count and kernel level", runConvertBench},
+    {"kernels", "kernels [--frames N]             verify SIMD conversion kernels against swscale and time them", runKernelBench},
+};
+
+static void printUsage() {
+    std::cout << "Usage: MediaForgeBench <command> [args]" << std::endl;
+    for (const auto& cmd : kCommands) {
+        std::cout << "  " << cmd.usage << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 2;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (const auto& cmd : kCommands) {
+        if (strcmp(argv[1], cmd.name) == 0) {
+            return cmd.run(argc - 2, argv + 2);
+        }
+    }
+
+    std::cerr << "Unknown command: " << argv[1] << std::endl;
+    printUsage();
+    return 2;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+// Blocking FIFO with a fixed capacity, used to connect pipeline stages.
+// push() blocks while the queue is full (back-pressure), pop() blocks while it is empty.
+// The queue finishes once every producer has called close(); abort() wakes all waiters immediately.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity, int producers = 1)
+        : capacity_(capacity > 0 ? capacity : 1), producers_(producers) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Returns false if the queue was aborted; the caller keeps ownership of item.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return items_.size() < capacity_ || aborted_; });
+        if (aborted_) return false;
+        items_.push_back(std::move(item));
+        updateGauge();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained, or aborted.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || producers_ <= 0 || aborted_; });
+        if (aborted_ || items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        updateGauge();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // Non-blocking pop, also usable after abort() to reclaim leftover items.
+    bool tryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        updateGauge();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (producers_ > 0) producers_--;
+        notEmpty_.notify_all();
+    }
+
+    void abort() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    bool isAborted() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return aborted_;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Mirrors the current depth into an atomic that can be read without taking the lock.
+    void setDepthGauge(std::atomic<int>* gauge) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        gauge_ = gauge;
+        updateGauge();
+    }
+
+private:
+    void updateGauge() {
+        if (gauge_) gauge_->store((int)items_.size(), std::memory_order_relaxed);
+    }
+
+    const size_t capacity_;
+    int producers_;
+    bool aborted_ = false;
+    std::atomic<int>* gauge_ = nullptr;
+    std::deque<T> items_;
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
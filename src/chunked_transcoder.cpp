@@ -0,0 +1,642 @@
+#include "chunked_transcoder.h"
+#include "transcoder.h"
+#include "muxer.h"
+#include "media_probe.h"
+#include "cpu_budget.h"
+#include <iostream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+#endif
+
+// Packets read after a seek before giving up on finding a keyframe.
+static const int kMaxKeyframeSearchPackets = 5000;
+// Frames of headroom in each chunk file so B-frame dts before the first pts stay non-negative.
+static const int64_t kPrerollFrames = 16;
+// Chunk files use a time base this much finer than the encoder's, leaving room to
+// re-time overlapping dts at chunk seams.
+static const int kTimeBaseSubdivision = 64;
+
+ChunkedTranscoder::ChunkedTranscoder() {}
+
+ChunkedTranscoder::~ChunkedTranscoder() {}
+
+// Chunks are all encoded with the encoder resolved here, so a seam never joins two different encoders.
+static std::string resolveEncoder(const std::string& encoderName, const MediaInfo& info) {
+    return VideoEncoder::resolveEncoderName(encoderName, info.width, info.height,
+                                            av_get_pix_fmt(info.pixelFormat.c_str()));
+}
+
+bool ChunkedTranscoder::checkpoint() {
+    bool keepGoing;
+    if (control_->isPaused()) {
+        metrics_->beginPause();
+        keepGoing = control_->checkpoint();
+        metrics_->endPause();
+    } else {
+        keepGoing = control_->checkpoint();
+    }
+    if (!keepGoing) failed_ = true;
+    return keepGoing;
+}
+
+void ChunkedTranscoder::reportEncodeProgress() {
+    if (chunks_.empty()) return;
+
+    // Encoding is the bulk of the work; the stitch pass takes the last few percent.
+    float total = 0.0f;
+    for (const auto& chunk : chunks_) {
+        total += chunk.progress;
+    }
+    float progress = 0.95f * total / (float)chunks_.size();
+    metrics_->setPosition((int64_t)(progress * durationMicros_));
+    if (onProgress_) onProgress_(progress);
+}
+
+bool ChunkedTranscoder::planChunks(const std::string& inputPath, int chunkCount) {
+    Demuxer demuxer;
+    demuxer.setMemoryMapped(options_.mappedInput);
+    if (!demuxer.open(inputPath)) return false;
+
+    int videoIdx = demuxer.getVideoStreamIndex();
+    if (videoIdx < 0) return false;
+
+    AVFormatContext* fmtCtx = demuxer.getFormatContext();
+    for (unsigned int i = 0; i < fmtCtx->nb_streams; i++) {
+        if ((int)i != videoIdx) fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    videoTimeBase_ = demuxer.getStreams()[videoIdx].timeBase;
+    int64_t startTime = fmtCtx->start_time != AV_NOPTS_VALUE ? fmtCtx->start_time : 0;
+
+    // Seek to evenly spaced targets and take the first keyframe at or after each one.
+    // This costs a few seeks instead of a scan of the whole file.
+    std::vector<int64_t> boundaries;
+    AVPacket* packet = av_packet_alloc();
+    for (int i = 1; i < chunkCount; i++) {
+        int64_t target = startTime + demuxer.getDuration() * i / chunkCount;
+        int64_t targetPts = av_rescale_q(target, AV_TIME_BASE_Q, videoTimeBase_);
+        if (!demuxer.seek(videoIdx, targetPts, AVSEEK_FLAG_BACKWARD)) continue;
+
+        for (int read = 0; read < kMaxKeyframeSearchPackets && demuxer.readPacket(packet); read++) {
+            bool found = packet->stream_index == videoIdx && (packet->flags & AV_PKT_FLAG_KEY) &&
+                         packet->pts != AV_NOPTS_VALUE && packet->pts >= targetPts;
+            int64_t pts = packet->pts;
+            av_packet_unref(packet);
+            if (found) {
+                if (boundaries.empty() || pts > boundaries.back()) {
+                    boundaries.push_back(pts);
+                }
+                break;
+            }
+        }
+    }
+    av_packet_free(&packet);
+
+    buildChunks(boundaries);
+    std::cout << "[ChunkedTranscoder] " << chunks_.size() << " chunk(s) for " << chunkCount << " requested" << std::endl;
+    return true;
+}
+
+void ChunkedTranscoder::buildChunks(const std::vector<int64_t>& boundaries) {
+    chunks_ = std::vector<Chunk>(boundaries.size() + 1);
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        chunks_[i].startPts = i == 0 ? INT64_MIN : boundaries[i - 1];
+        chunks_[i].endPts = i < boundaries.size() ? boundaries[i] : INT64_MAX;
+    }
+}
+
+bool ChunkedTranscoder::restoreCompletedChunks() {
+    int restored = 0;
+    for (const ChunkRecord& record : resume_.completed) {
+        if (record.index < 0 || record.index >= (int)chunks_.size()) continue;
+        Chunk& chunk = chunks_[record.index];
+
+        // The journal says it finished; make sure the file survived too.
+        Demuxer check;
+        if (!check.open(chunk.path) || check.getVideoStreamIndex() < 0) {
+            std::cout << "[ChunkedTranscoder] Chunk " << record.index << " is unreadable, re-encoding it" << std::endl;
+            continue;
+        }
+        chunk.tsOffset = record.tsOffset;
+        chunk.encTimeBase = record.encTimeBase;
+        chunk.progress = 1.0f;
+        chunk.done = true;
+        restored++;
+    }
+    std::cout << "[ChunkedTranscoder] Resuming with " << restored << " of " << chunks_.size()
+              << " chunk(s) already encoded" << std::endl;
+    return restored > 0;
+}
+
+bool ChunkedTranscoder::inputStamp(const std::string& inputPath, int64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    fs::path p = Utf8ToPath(inputPath);
+    uintmax_t fileSize = fs::file_size(p, ec);
+    if (ec) return false;
+    auto writeTime = fs::last_write_time(p, ec);
+    if (ec) return false;
+    size = (int64_t)fileSize;
+    mtime = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+std::string ChunkedTranscoder::chunkPath(const std::string& outputPath, int index) {
+    // NUT keeps the exact time base and timestamps it is given.
+    return outputPath + ".part" + std::to_string(index) + ".nut";
+}
+
+void ChunkedTranscoder::removeChunkFiles(const std::string& outputPath, int chunkCount) {
+    for (int i = 0; i < chunkCount; i++) {
+        std::error_code ec;
+        fs::remove(Utf8ToPath(chunkPath(outputPath, i)), ec);
+    }
+}
+
+void ChunkedTranscoder::syncFile(const std::string& path) {
+    // A resumable chunk is only recorded as done once its data is on disk.
+#ifdef _WIN32
+    HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE) {
+        FlushFileBuffers(file);
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+bool ChunkedTranscoder::encodeChunk(Chunk& chunk, const std::string& inputPath, const std::string& encoderName,
+                                    const VideoDecoder::Options& decoderOptions) {
+    Demuxer demuxer;
+    demuxer.setMemoryMapped(options_.mappedInput);
+    demuxer.setInterruptCallback(&TranscodeControl::interruptCallback, control_);
+    if (!demuxer.open(inputPath)) return false;
+
+    int videoIdx = demuxer.getVideoStreamIndex();
+    AVFormatContext* fmtCtx = demuxer.getFormatContext();
+    for (unsigned int i = 0; i < fmtCtx->nb_streams; i++) {
+        if ((int)i != videoIdx) fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    // Software decode by default: the cores are the resource being split, and hardware
+    // decoders have their own session limits.
+    VideoDecoder decoder;
+    if (!decoder.open(demuxer.getStreams()[videoIdx].codecParams, options_.allowHardwareDecode, decoderOptions)) {
+        return false;
+    }
+
+    VideoEncoder encoder;
+    encoder.setEncoderThreads(options_.threadsPerChunk);
+    encoder.setConversionThreads(1);
+    if (!encoder.open(decoder.width(), decoder.height(), decoder.pixFmt(), decoder.framerate(), encoderName)) {
+        return false;
+    }
+    // open() falls back to other encoders, and a chunk from another one can't be stitched in.
+    if (encoderName != encoder.getCodecContext()->codec->name) {
+        std::cerr << "[ChunkedTranscoder] " << encoderName << " unavailable for chunk, got "
+                  << encoder.getCodecContext()->codec->name << std::endl;
+        return false;
+    }
+
+    AVRational encTimeBase = encoder.getCodecContext()->time_base;
+    AVRational fileTimeBase = av_mul_q(encTimeBase, AVRational{1, kTimeBaseSubdivision});
+
+    Muxer muxer;
+    if (!muxer.open(chunk.path)) return false;
+    int outIndex = muxer.addStream(encoder.getCodecContext());
+    if (outIndex < 0) return false;
+    muxer.setStreamTimeBase(outIndex, fileTimeBase);
+    if (!muxer.writeHeader()) return false;
+
+    if (chunk.startPts != INT64_MIN && !demuxer.seek(videoIdx, chunk.startPts, AVSEEK_FLAG_BACKWARD)) {
+        std::cerr << "[ChunkedTranscoder] Seek failed for chunk at " << chunk.startPts << std::endl;
+        return false;
+    }
+
+    chunk.encTimeBase = encTimeBase;
+    bool haveOffset = false;
+    int64_t lastEncodedPts = AV_NOPTS_VALUE;
+    int64_t span = chunk.endPts != INT64_MAX && chunk.startPts != INT64_MIN ? chunk.endPts - chunk.startPts : 0;
+    int64_t totalPts = av_rescale_q(demuxer.getDuration(), AV_TIME_BASE_Q, videoTimeBase_);
+    bool reachedEnd = false;
+    bool ok = true;
+
+    AVPacket* packet = av_packet_alloc();
+    AVPacket* encPkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+
+    auto drainEncoder = [&]() {
+        while (!failed_ && !control_->isCancelled() && encoder.receivePacket(encPkt)) {
+            if (encPkt->pts != AV_NOPTS_VALUE) encPkt->pts -= chunk.tsOffset;
+            if (encPkt->dts != AV_NOPTS_VALUE) encPkt->dts -= chunk.tsOffset;
+            encPkt->stream_index = outIndex;
+            int size = encPkt->size;
+            if (muxer.writePacket(encPkt)) {
+                metrics_->addBytesWritten(size);
+            } else {
+                ok = false;
+            }
+            av_packet_unref(encPkt);
+        }
+    };
+
+    // Frames are kept in [startPts, endPts). Decoding continues past the next chunk's keyframe
+    // until a frame at or beyond endPts comes out, so open-GOP leading pictures land in this chunk.
+    auto handleFrames = [&]() {
+        while (ok && !reachedEnd && !failed_ && decoder.receiveFrame(frame)) {
+            metrics_->addFramesDecoded();
+            int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+            if (pts == AV_NOPTS_VALUE || pts < chunk.startPts) {
+                av_frame_unref(frame);
+                continue;
+            }
+            if (pts >= chunk.endPts) {
+                reachedEnd = true;
+                av_frame_unref(frame);
+                break;
+            }
+
+            frame->pts = av_rescale_q(pts, videoTimeBase_, encTimeBase);
+            if (lastEncodedPts != AV_NOPTS_VALUE && frame->pts <= lastEncodedPts) {
+                frame->pts = lastEncodedPts + 1;
+            }
+            lastEncodedPts = frame->pts;
+            frame->pict_type = AV_PICTURE_TYPE_NONE;
+            if (!haveOffset) {
+                chunk.tsOffset = frame->pts - kPrerollFrames;
+                haveOffset = true;
+            }
+
+            if (encoder.sendFrame(frame)) {
+                metrics_->addFramesEncoded();
+                drainEncoder();
+            } else if (encoder.conversionFailed()) {
+                ok = false;
+            }
+            av_frame_unref(frame);
+
+            if (span > 0) {
+                chunk.progress = std::min(1.0f, (float)(pts - chunk.startPts) / (float)span);
+            } else if (totalPts > 0) {
+                chunk.progress = std::min(1.0f, (float)pts / (float)totalPts);
+            }
+            reportEncodeProgress();
+        }
+    };
+
+    // A sibling chunk failing sinks the whole job, so stop as soon as it does.
+    while (ok && !reachedEnd && !failed_ && checkpoint()) {
+        if (!demuxer.readPacket(packet)) break;
+        metrics_->addBytesRead(packet->size);
+
+        if (packet->stream_index == videoIdx && decoder.sendPacket(packet)) {
+            handleFrames();
+        }
+        av_packet_unref(packet);
+    }
+
+    if (ok && !reachedEnd && !failed_ && decoder.sendPacket(nullptr)) {
+        handleFrames();
+    }
+    if (ok && !failed_ && encoder.sendFrame(nullptr)) {
+        drainEncoder();
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&encPkt);
+    av_packet_free(&packet);
+
+    if (!ok || failed_ || !muxer.writeTrailer()) return false;
+
+    chunk.progress = 1.0f;
+    reportEncodeProgress();
+    return true;
+}
+
+bool ChunkedTranscoder::stitch(const std::string& inputPath, const std::string& outputPath) {
+    Demuxer source;
+    source.setMemoryMapped(options_.mappedInput);
+    source.setInterruptCallback(&TranscodeControl::interruptCallback, control_);
+    if (!source.open(inputPath)) return false;
+
+    Demuxer firstChunk;
+    if (!firstChunk.open(chunks_[0].path) || firstChunk.getVideoStreamIndex() < 0) return false;
+    const Demuxer::StreamInfo& chunkVideo = firstChunk.getStreams()[firstChunk.getVideoStreamIndex()];
+    AVRational chunkTimeBase = chunkVideo.timeBase;
+
+    Muxer muxer;
+    if (!muxer.open(outputPath)) return false;
+    muxer.setLayout(options_.outputLayout);
+    muxer.setExpectedDuration(source.getDuration(), source.hasExactDuration());
+
+    int videoOut = muxer.addStream(chunkVideo.codecParams, chunkTimeBase);
+    if (videoOut < 0) return false;
+
+    // Audio (and optionally subtitles) are copied straight from the source, as Transcoder does.
+    const auto& streams = source.getStreams();
+    std::vector<int> mapping(streams.size(), -1);
+    AVFormatContext* srcCtx = source.getFormatContext();
+    for (const auto& stream : streams) {
+        bool wanted = stream.codecType == AVMEDIA_TYPE_AUDIO ||
+                      (copySubtitles_ && stream.codecType == AVMEDIA_TYPE_SUBTITLE);
+        if (wanted && muxer.supportsCodec(stream.codecParams->codec_id)) {
+            mapping[stream.streamIndex] = muxer.addStream(stream.codecParams, stream.timeBase);
+        } else {
+            srcCtx->streams[stream.streamIndex]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    if (!muxer.writeHeader()) return false;
+
+    AVPacket* videoPkt = av_packet_alloc();
+    AVPacket* otherPkt = av_packet_alloc();
+    size_t chunkIndex = 0;
+    Demuxer chunkDemuxer;
+    bool videoPending = false;
+    bool otherPending = false;
+    bool videoDone = false;
+    bool otherDone = false;
+    int64_t lastVideoDts = AV_NOPTS_VALUE;
+    bool ok = true;
+
+    auto nextVideo = [&]() {
+        while (!videoDone) {
+            if (!chunkDemuxer.getFormatContext()) {
+                if (chunkIndex >= chunks_.size()) {
+                    videoDone = true;
+                    return;
+                }
+                if (!chunkDemuxer.open(chunks_[chunkIndex].path)) {
+                    ok = false;
+                    videoDone = true;
+                    return;
+                }
+                const AVCodecParameters* params = chunkDemuxer.getStreams()[chunkDemuxer.getVideoStreamIndex()].codecParams;
+                if (params->extradata_size != chunkVideo.codecParams->extradata_size ||
+                    (params->extradata_size > 0 &&
+                     memcmp(params->extradata, chunkVideo.codecParams->extradata, params->extradata_size) != 0)) {
+                    // Its packets would be muxed under chunk 0's global header and might not
+                    // decode from this seam on; fail so the caller transcodes in one piece.
+                    std::cerr << "[ChunkedTranscoder] Chunk " << chunkIndex
+                              << " has different codec headers than chunk 0, can't stitch" << std::endl;
+                    ok = false;
+                    videoDone = true;
+                    return;
+                }
+            }
+
+            if (chunkDemuxer.readPacket(videoPkt)) {
+                const Chunk& chunk = chunks_[chunkIndex];
+                AVRational tb = chunkDemuxer.getStreams()[videoPkt->stream_index].timeBase;
+                av_packet_rescale_ts(videoPkt, tb, chunkTimeBase);
+                int64_t offset = av_rescale_q(chunk.tsOffset, chunk.encTimeBase, chunkTimeBase);
+                if (videoPkt->pts != AV_NOPTS_VALUE) videoPkt->pts += offset;
+                if (videoPkt->dts != AV_NOPTS_VALUE) videoPkt->dts += offset;
+                // Each chunk's encoder starts its dts a few frames before the first pts to make
+                // room for B-frame reordering, which overlaps the previous chunk's tail. The chunk
+                // time base has many ticks per frame, so those packets are squeezed in just after
+                // the previous dts while staying below their pts.
+                if (lastVideoDts != AV_NOPTS_VALUE && videoPkt->dts != AV_NOPTS_VALUE && videoPkt->dts <= lastVideoDts) {
+                    videoPkt->dts = lastVideoDts + 1;
+                }
+                if (videoPkt->dts != AV_NOPTS_VALUE) lastVideoDts = videoPkt->dts;
+                videoPkt->stream_index = videoOut;
+                videoPkt->pos = -1;
+                videoPending = true;
+                return;
+            }
+
+            chunkDemuxer.close();
+            chunkIndex++;
+        }
+    };
+
+    auto nextOther = [&]() {
+        while (!otherDone) {
+            if (!source.readPacket(otherPkt)) {
+                otherDone = true;
+                return;
+            }
+            int inIndex = otherPkt->stream_index;
+            if (inIndex >= 0 && inIndex < (int)mapping.size() && mapping[inIndex] >= 0) {
+                otherPkt->stream_index = mapping[inIndex];
+                otherPkt->pos = -1;
+                otherPending = true;
+                return;
+            }
+            av_packet_unref(otherPkt);
+        }
+    };
+
+    // Interleave by dts so the muxer's interleaving queue stays small.
+    nextVideo();
+    nextOther();
+    while (ok && (videoPending || otherPending)) {
+        if (!checkpoint()) {
+            ok = false;
+            break;
+        }
+
+        bool takeVideo = videoPending;
+        if (videoPending && otherPending) {
+            AVRational otherTb = streams[0].timeBase;
+            for (size_t i = 0; i < mapping.size(); i++) {
+                if (mapping[i] == otherPkt->stream_index) otherTb = streams[i].timeBase;
+            }
+            int64_t vts = videoPkt->dts != AV_NOPTS_VALUE ? videoPkt->dts : videoPkt->pts;
+            int64_t ots = otherPkt->dts != AV_NOPTS_VALUE ? otherPkt->dts : otherPkt->pts;
+            takeVideo = av_compare_ts(vts, chunkTimeBase, ots, otherTb) <= 0;
+        }
+
+        if (takeVideo) {
+            metrics_->addBytesWritten(videoPkt->size);
+            if (!muxer.writePacket(videoPkt)) ok = false;
+            av_packet_unref(videoPkt);
+            videoPending = false;
+            nextVideo();
+        } else {
+            metrics_->addBytesWritten(otherPkt->size);
+            if (!muxer.writePacket(otherPkt)) ok = false;
+            av_packet_unref(otherPkt);
+            otherPending = false;
+            nextOther();
+        }
+    }
+
+    av_packet_free(&otherPkt);
+    av_packet_free(&videoPkt);
+
+    return ok && muxer.writeTrailer();
+}
+
+void ChunkedTranscoder::removeChunkFiles() {
+    for (const auto& chunk : chunks_) {
+        std::error_code ec;
+        fs::remove(Utf8ToPath(chunk.path), ec);
+    }
+}
+
+bool ChunkedTranscoder::run(const std::string& inputPath, const std::string& outputPath, const std::string& encoderName,
+                            const VideoDecoder::Options& decoderOptions) {
+    chunks_.clear();
+    failed_ = false;
+    remuxed_ = false;
+    resumed_ = false;
+    cancelled_ = false;
+
+    int cores = CpuBudget::shared().total();
+    int workers = options_.workers > 0 ? options_.workers : std::max(1, cores / std::max(1, options_.threadsPerChunk));
+
+    MediaInfo info = MediaProbe::shared().get(inputPath);
+    if (!info.valid) return false;
+    double durationSeconds = info.durationSeconds;
+    durationMicros_ = (int64_t)(durationSeconds * AV_TIME_BASE);
+    bool sameCodec = info.codecId == VideoEncoder::targetCodecId(encoderName);
+    videoTimeBase_ = info.videoTimeBase;
+
+    int wanted = std::min(workers * std::max(1, options_.chunksPerWorker),
+                          (int)(durationSeconds / std::max(1.0, options_.minChunkSeconds)));
+
+    ResumePoint plan;
+    std::string chunkEncoder = encoderName;
+    if (!sameCodec && (wanted >= 2 || !resume_.boundaries.empty())) {
+        chunkEncoder = resolveEncoder(encoderName, info);
+        if (chunkEncoder.empty()) {
+            std::cerr << "[ChunkedTranscoder] No encoder available for " << encoderName << std::endl;
+            return false;
+        }
+        plan.encoder = chunkEncoder;
+        inputStamp(inputPath, plan.inputSize, plan.inputMtime);
+    }
+
+    bool resuming = !sameCodec && !resume_.boundaries.empty();
+    if (resuming && (resume_.inputSize < 0 || resume_.inputSize != plan.inputSize ||
+                     resume_.inputMtime != plan.inputMtime || resume_.encoder != plan.encoder)) {
+        // Chunks of a different input, or from another encoder, can't be stitched with new ones.
+        std::cout << "[ChunkedTranscoder] Input or encoder changed since the interrupted run, starting over" << std::endl;
+        removeChunkFiles(outputPath, (int)resume_.boundaries.size() + 1);
+        resume_ = ResumePoint();
+        resuming = false;
+    }
+    if (resuming) {
+        buildChunks(resume_.boundaries);
+    }
+
+    // Inputs that would be remuxed, or are too short to split, go through a single Transcoder.
+    if (!resuming && (sameCodec || wanted < 2 || !planChunks(inputPath, wanted) || chunks_.size() < 2)) {
+        std::cout << "[ChunkedTranscoder] Not splitting, using a single transcoder" << std::endl;
+        chunks_.clear();
+        Transcoder transcoder;
+        transcoder.setControl(control_);
+        transcoder.setProgressCallback(onProgress_);
+        transcoder.setCopySubtitles(copySubtitles_);
+        transcoder.setMetrics(metrics_);
+        transcoder.setOutputLayout(options_.outputLayout);
+        transcoder.setEncoderThreads(options_.encoderThreads);
+        transcoder.setConversionThreads(options_.conversionThreads);
+        transcoder.setMappedInput(options_.mappedInput);
+        // One pipeline, so hardware decode is fine here whatever the chunk workers use.
+        bool success = transcoder.run(inputPath, outputPath, encoderName, true, decoderOptions);
+        remuxed_ = transcoder.wasRemuxed();
+        cancelled_ = transcoder.wasCancelled();
+        return success;
+    }
+
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        chunks_[i].path = chunkPath(outputPath, (int)i);
+    }
+
+    if (resuming) {
+        resumed_ = restoreCompletedChunks();
+    } else if (onPlan_) {
+        for (size_t i = 1; i < chunks_.size(); i++) plan.boundaries.push_back(chunks_[i].startPts);
+        onPlan_(plan);
+    }
+
+    // Per-chunk decoders get a single thread; the parallelism comes from running chunks side by side.
+    VideoDecoder::Options chunkDecoderOptions = decoderOptions;
+    chunkDecoderOptions.threadCount = 1;
+
+    std::cout << "[ChunkedTranscoder] Encoding " << chunks_.size() << " chunks on " << workers
+              << " worker(s), " << options_.threadsPerChunk << " encoder thread(s) each" << std::endl;
+
+    metrics_->start(durationMicros_);
+    std::atomic<size_t> nextChunk{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < std::min<int>(workers, (int)chunks_.size()); w++) {
+        threads.emplace_back([&]() {
+            while (!failed_) {
+                size_t index = nextChunk++;
+                if (index >= chunks_.size()) break;
+                Chunk& chunk = chunks_[index];
+                if (chunk.done) continue;
+                if (!encodeChunk(chunk, inputPath, chunkEncoder, chunkDecoderOptions)) {
+                    if (!control_->isCancelled()) {
+                        std::cerr << "[ChunkedTranscoder] Chunk " << index << " failed" << std::endl;
+                    }
+                    failed_ = true;
+                } else if (onChunkDone_) {
+                    syncFile(chunk.path);
+                    onChunkDone_(ChunkRecord{(int)index, chunk.tsOffset, chunk.encTimeBase});
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    bool success = !failed_ && stitch(inputPath, outputPath);
+    cancelled_ = control_->isCancelled();
+    // Keep finished chunks of a cancelled resumable run; everything else is done with them.
+    if (success || !cancelled_ || !onChunkDone_) {
+        removeChunkFiles();
+    }
+
+    if (success) {
+        metrics_->setPosition(durationMicros_);
+        if (onProgress_) onProgress_(1.0f);
+    }
+    metrics_->finish();
+    std::cout << "[ChunkedTranscoder] " << metrics_->snapshot().summary() << std::endl;
+    return success;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+#include "demuxer.h"
+#include "muxer.h"
+#include "video_decoder.h"
+#include "video_encoder.h"
+#include "transcode_metrics.h"
+#include "transcode_control.h"
+
+// Encodes one long input as GOP-aligned chunks on independent decoder/encoder pairs, then
+// stitches the chunk files and the stream-copied audio into the final output.
+// Chunks start on source keyframes, so every chunk opens with an IDR and needs no state from its neighbour.
+class ChunkedTranscoder {
+public:
+    struct Options {
+        int workers = 0;            // Concurrent chunk encoders, 0 = cores / threadsPerChunk
+        int threadsPerChunk = 2;    // Encoder threads per chunk
+        int chunksPerWorker = 2;    // More chunks than workers evens out uneven GOP sizes
+        double minChunkSeconds = 60.0;
+        // Hardware decode for chunk decoders; only sensible with a single worker. The
+        // single-Transcoder fallback always may use it.
+        bool allowHardwareDecode = false;
+        // Encoder and conversion threads of the single-Transcoder fallback, normally the
+        // caller's CPU budget lease; 0 = the Transcoder's defaults.
+        int encoderThreads = 0;
+        int conversionThreads = 0;
+        // Read the input through a memory mapping (see Demuxer::setMemoryMapped) when
+        // planning, encoding chunks, stitching and in the fallback.
+        bool mappedInput = false;
+        // Index placement of the final output; chunk files are NUT and have none.
+        Muxer::Layout outputLayout = Muxer::Layout::Auto;
+    };
+
+    // A finished chunk file, as reported to the chunk callback and passed back for resume.
+    struct ChunkRecord {
+        int index = 0;
+        int64_t tsOffset = 0;
+        AVRational encTimeBase{0, 1};
+    };
+
+    // Enough state to continue an interrupted run: the chunk boundaries (start pts of
+    // chunks 1..n-1, source video time base) and the chunks whose files were completed.
+    // The input's size and modification time and the encoder the chunks came from are
+    // stamped with the plan; a resume against anything else starts over.
+    struct ResumePoint {
+        std::vector<int64_t> boundaries;
+        std::vector<ChunkRecord> completed;
+        int64_t inputSize = -1;
+        int64_t inputMtime = 0;
+        std::string encoder;    // Resolved encoder name, never "auto"
+    };
+
+    ChunkedTranscoder();
+    ~ChunkedTranscoder();
+
+    // Falls back to a plain Transcoder run (including its remux shortcut) when the input
+    // already has the target codec or is too short to split.
+    bool run(const std::string& inputPath, const std::string& outputPath, const std::string& encoderName,
+             const VideoDecoder::Options& decoderOptions = VideoDecoder::Options());
+
+    void setOptions(const Options& options) { options_ = options; }
+    // Same contract as Transcoder::setControl(); cancelling stops every chunk worker.
+    void setControl(TranscodeControl* control) { control_ = control ? control : &ownControl_; }
+    bool wasCancelled() const { return cancelled_; }
+    void setProgressCallback(std::function<void(float)> callback) { onProgress_ = callback; }
+    void setCopySubtitles(bool copy) { copySubtitles_ = copy; }
+    // Same contract as Transcoder::setMetrics(); all chunk workers report into one set of counters.
+    void setMetrics(TranscodeMetrics* metrics) { metrics_ = metrics ? metrics : &ownMetrics_; }
+    const TranscodeMetrics& metrics() const { return *metrics_; }
+
+    // Resumable runs: the plan callback fires once the boundaries are known, the chunk
+    // callback after each chunk file is complete and flushed to disk. A run given a matching
+    // resume point re-encodes only the missing chunks. Chunk files survive cancellation so
+    // the caller can resume later or delete them with removeChunkFiles().
+    void setResumePoint(const ResumePoint& resume) { resume_ = resume; }
+    // Called with a new plan (boundaries and stamp, no completed chunks) before encoding starts.
+    void setPlanCallback(std::function<void(const ResumePoint&)> cb) { onPlan_ = cb; }
+    void setChunkCallback(std::function<void(const ChunkRecord&)> cb) { onChunkDone_ = cb; }
+    static void removeChunkFiles(const std::string& outputPath, int chunkCount);
+    static std::string chunkPath(const std::string& outputPath, int index);
+
+    int chunkCount() const { return (int)chunks_.size(); }
+    bool wasRemuxed() const { return remuxed_; }
+    // Chunks of an interrupted run were reused (the resume point still matched).
+    bool wasResumed() const { return resumed_; }
+
+private:
+    struct Chunk {
+        int64_t startPts = 0;          // Source video time base, inclusive
+        int64_t endPts = INT64_MAX;    // Exclusive, INT64_MAX for the last chunk
+        std::string path;
+        // Chunk files store timestamps relative to this (encoder time base); stitch() adds it back.
+        int64_t tsOffset = 0;
+        AVRational encTimeBase{0, 1};
+        std::atomic<float> progress{0.0f};
+        bool done = false;             // Restored from a resume point
+    };
+
+    Options options_;
+    TranscodeControl ownControl_;
+    TranscodeControl* control_ = &ownControl_;
+    bool cancelled_ = false;
+    std::function<void(float)> onProgress_;
+    bool copySubtitles_ = false;
+    bool remuxed_ = false;
+    bool resumed_ = false;
+    TranscodeMetrics ownMetrics_;
+    TranscodeMetrics* metrics_ = &ownMetrics_;
+    int64_t durationMicros_ = 0;
+
+    ResumePoint resume_;
+    std::function<void(const ResumePoint&)> onPlan_;
+    std::function<void(const ChunkRecord&)> onChunkDone_;
+
+    std::vector<Chunk> chunks_;
+    std::atomic<bool> failed_{false};
+    AVRational videoTimeBase_{0, 1};
+
+    bool planChunks(const std::string& inputPath, int chunkCount);
+    void buildChunks(const std::vector<int64_t>& boundaries);
+    bool restoreCompletedChunks();
+    bool encodeChunk(Chunk& chunk, const std::string& inputPath, const std::string& encoderName,
+                     const VideoDecoder::Options& decoderOptions);
+    bool stitch(const std::string& inputPath, const std::string& outputPath);
+    void removeChunkFiles();
+    static void syncFile(const std::string& path);
+    static bool inputStamp(const std::string& inputPath, int64_t& size, int64_t& mtime);
+
+    // Blocks while paused; returns false once cancelled, which also stops the other workers.
+    bool checkpoint();
+    void reportEncodeProgress();
+};
@@ -0,0 +1,60 @@
+#include "cpu_budget.h"
+#include <algorithm>
+#include <thread>
+
+CpuBudget& CpuBudget::shared() {
+    static CpuBudget instance;
+    return instance;
+}
+
+CpuBudget::CpuBudget() {
+    total_ = std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+CpuBudget::Lease& CpuBudget::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        budget_ = other.budget_;
+        tokens_ = other.tokens_;
+        other.budget_ = nullptr;
+        other.tokens_ = 0;
+    }
+    return *this;
+}
+
+void CpuBudget::Lease::release() {
+    if (budget_ && tokens_ > 0) {
+        budget_->giveBack(tokens_);
+    }
+    budget_ = nullptr;
+    tokens_ = 0;
+}
+
+void CpuBudget::setTotal(int tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_ = std::max(1, tokens);
+}
+
+int CpuBudget::total() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+}
+
+int CpuBudget::inUse() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inUse_;
+}
+
+CpuBudget::Lease CpuBudget::tryAcquire(int wanted, int minimum) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    minimum = std::clamp(minimum, 1, total_);
+    if (total_ - inUse_ < minimum) return Lease();
+    int granted = std::clamp(wanted, minimum, total_ - inUse_);
+    inUse_ += granted;
+    return Lease(this, granted);
+}
+
+void CpuBudget::giveBack(int tokens) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    inUse_ -= tokens;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <mutex>
+
+// Process-wide pool of CPU tokens, one per core by default. Anything that sizes a thread
+// pool (codec threads, conversion slices, chunk workers) leases tokens first and sizes the
+// pool to what it got, so concurrent jobs together don't run more busy threads than there
+// are cores.
+class CpuBudget {
+public:
+    // Tokens held until destruction. Move-only.
+    class Lease {
+    public:
+        Lease() = default;
+        ~Lease() { release(); }
+        Lease(Lease&& other) noexcept : budget_(other.budget_), tokens_(other.tokens_) {
+            other.budget_ = nullptr;
+            other.tokens_ = 0;
+        }
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        int tokens() const { return tokens_; }
+        void release();
+
+    private:
+        friend class CpuBudget;
+        Lease(CpuBudget* budget, int tokens) : budget_(budget), tokens_(tokens) {}
+
+        CpuBudget* budget_ = nullptr;
+        int tokens_ = 0;
+    };
+
+    static CpuBudget& shared();
+
+    // Shrinking below what's leased takes effect as leases are returned.
+    void setTotal(int tokens);
+    int total() const;
+    int inUse() const;
+
+    // Grants up to `wanted` tokens if at least `minimum` are free, otherwise returns an empty
+    // lease. A minimum larger than the total is clamped so it can be met once nothing else
+    // is leased. Never blocks: callers wait on their own condition (and cancellation) and
+    // retry when leases are returned.
+    Lease tryAcquire(int wanted, int minimum = 1);
+
+private:
+    CpuBudget();
+
+    mutable std::mutex mutex_;
+    int total_ = 1;
+    int inUse_ = 0;
+
+    void giveBack(int tokens);
+};
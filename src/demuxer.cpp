@@ -1,8 +1,26 @@
 #include "demuxer.h"
+#include <filesystem>
 #include <iostream>
-#include <windows.h>
 
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/time.h>
+}
+
+#ifdef _WIN32
 #define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// How often a tailed input's size and writer are looked at while reads wait at its end.
+static const int64_t kTailCheckIntervalUs = 200000;
+
+#ifdef _WIN32
 
 static std::wstring Utf8ToWide(const std::string& str) {
     if (str.empty()) return std::wstring();
@@ -27,6 +45,19 @@ static std::string GetShortPath(const std::string& utf8Path) {
     return strTo;
 }
 
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+#else
+static std::string GetShortPath(const std::string& path) {
+    return path;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+#endif
+
 Demuxer::Demuxer() {}
 
 Demuxer::~Demuxer() {
@@ -38,16 +69,60 @@ bool Demuxer::open(const std::string& inputPath) {
 
     std::string pathForFFmpeg = GetShortPath(inputPath);
     std::cout << "[Demuxer] Opening input: " << pathForFFmpeg << std::endl;
+    int64_t openStart = av_gettime_relative();
 
-    if (avformat_open_input(&fmtCtx_, pathForFFmpeg.c_str(), nullptr, nullptr) < 0) {
+    inputPath_ = inputPath;
+    tailing_ = tailMode_ && isGrowing(inputPath, tailIdleTimeout_);
+    if (tailing_) {
+        tailSize_ = -1;
+        tailCheckTime_ = 0;
+        tailGrowTime_ = av_gettime_relative();
+#ifndef _WIN32
+        tailNotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (tailNotifyFd_ >= 0 && inotify_add_watch(tailNotifyFd_, inputPath.c_str(), IN_CLOSE_WRITE) < 0) {
+            ::close(tailNotifyFd_);
+            tailNotifyFd_ = -1;
+        }
+#endif
+    }
+
+    if (!openInput(inputPath, pathForFFmpeg)) {
         std::cerr << "[Demuxer] Could not open input file: " << inputPath << std::endl;
         return false;
     }
+    if (tailing_) {
+        std::cout << "[Demuxer] Following growing input until its writer stops" << std::endl;
+    }
 
-    if (avformat_find_stream_info(fmtCtx_, nullptr) < 0) {
+    // Tiered: the container header, then a bounded analysis, and the full one only for
+    // streams still missing parameters after that.
+    int ret = 0;
+    if (probe_ != Probe::Full && streamsComplete(true)) {
+        probeUsed_ = "header only";
+    } else if (probe_ != Probe::Full) {
+        fmtCtx_->probesize = kBoundedProbeSize;
+        fmtCtx_->max_analyze_duration = kBoundedAnalyzeDuration;
+        ret = avformat_find_stream_info(fmtCtx_, nullptr);
+        probeUsed_ = "bounded analysis";
+        if (ret < 0 || !streamsComplete(false)) {
+            // A stream info pass can't be resumed with new limits; start over on a fresh input.
+            closeInput();
+            if (!openInput(inputPath, pathForFFmpeg)) {
+                std::cerr << "[Demuxer] Could not reopen input file: " << inputPath << std::endl;
+                return false;
+            }
+            ret = avformat_find_stream_info(fmtCtx_, nullptr);
+            probeUsed_ = "full analysis";
+        }
+    } else {
+        ret = avformat_find_stream_info(fmtCtx_, nullptr);
+        probeUsed_ = "full analysis";
+    }
+    if (ret < 0) {
         std::cerr << "[Demuxer] Could not find stream info" << std::endl;
         return false;
     }
+    openSeconds_ = (av_gettime_relative() - openStart) / 1000000.0;
 
     streams_.reserve(fmtCtx_->nb_streams);
     for (unsigned int i = 0; i < fmtCtx_->nb_streams; i++) {
@@ -68,8 +143,97 @@ bool Demuxer::open(const std::string& inputPath) {
     }
 
     std::cout << "[Demuxer] Found " << streams_.size() << " streams (video: " << videoStreamIndex_
-              << ", audio: " << audioStreamIndex_ << ")" << std::endl;
+              << ", audio: " << audioStreamIndex_ << ") in " << (int)(openSeconds_ * 1000.0) << " ms ("
+              << probeUsed_ << ")" << std::endl;
+
+    return true;
+}
+
+bool Demuxer::openInput(const std::string& inputPath, const std::string& pathForFFmpeg) {
+    AVDictionary* options = nullptr;
+    if (tailing_) {
+        // The file protocol retries reads at EOF while "follow" is set; checkWriter() clears it.
+        av_dict_set(&options, "follow", "1", 0);
+    }
+
+    bool mapped = memoryMapped_ && !tailing_;
+    bool readAhead = readAheadBytes_ > 0 && !tailing_;
+    if (interruptCallback_.callback || tailing_ || readAhead || mapped) {
+        fmtCtx_ = avformat_alloc_context();
+        if (fmtCtx_) {
+            fmtCtx_->interrupt_callback = tailing_ ? AVIOInterruptCB{&Demuxer::tailInterrupt, this} : interruptCallback_;
+        }
+    }
+    if (mapped && fmtCtx_) {
+        mapped_ = std::make_unique<MappedReader>();
+        if (mapped_->open(inputPath)) {
+            fmtCtx_->pb = mapped_->ioContext();
+            fmtCtx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+            readAhead = false;
+        } else {
+            mapped_.reset();
+        }
+    }
+    if (readAhead && fmtCtx_) {
+        prefetch_ = std::make_unique<PrefetchReader>();
+        if (prefetch_->open(inputPath, readAheadBytes_, interruptCallback_)) {
+            fmtCtx_->pb = prefetch_->ioContext();
+            fmtCtx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        } else {
+            prefetch_.reset();   // Let the file protocol try, and report the error if it fails too
+        }
+    }
+
+    int ret = avformat_open_input(&fmtCtx_, pathForFFmpeg.c_str(), nullptr, &options);
+    if (tailing_ && av_dict_get(options, "follow", nullptr, 0)) {
+        // Not read through the file protocol, so there is nothing to follow.
+        tailing_ = false;
+    }
+    av_dict_free(&options);
+    return ret >= 0;
+}
+
+void Demuxer::closeInput() {
+    if (fmtCtx_) {
+        avformat_close_input(&fmtCtx_);
+        fmtCtx_ = nullptr;
+    }
+    prefetch_.reset();
+    mapped_.reset();
+}
+
+bool Demuxer::streamsComplete(bool headerOnly) {
+    if (fmtCtx_->nb_streams == 0) return false;
+
+    int64_t duration = fmtCtx_->duration;
+    for (unsigned int i = 0; i < fmtCtx_->nb_streams; i++) {
+        const AVStream* stream = fmtCtx_->streams[i];
+        const AVCodecParameters* par = stream->codecpar;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            // Cover art is not played or encoded.
+            if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) continue;
+            if (par->codec_id == AV_CODEC_ID_NONE || par->width <= 0 || par->height <= 0) return false;
+            if (probe_ == Probe::Formats) {
+                bool frameRate = stream->avg_frame_rate.num > 0 || stream->r_frame_rate.num > 0 || par->framerate.num > 0;
+                if (par->format < 0 || !frameRate) return false;
+            }
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO) {
+            if (par->codec_id == AV_CODEC_ID_NONE || par->sample_rate <= 0 || par->ch_layout.nb_channels <= 0) return false;
+            if (probe_ == Probe::Formats && par->format < 0) return false;
+        } else {
+            continue;
+        }
+        if (headerOnly && duration == AV_NOPTS_VALUE && stream->duration > 0 && stream->time_base.den > 0) {
+            duration = av_rescale_q(stream->duration, stream->time_base, AV_TIME_BASE_Q);
+        }
+    }
 
+    if (headerOnly) {
+        // Some headers (e.g. MP4's) only give per-stream durations; the stream info pass
+        // would have derived the overall one from them. A growing input has none yet.
+        if (duration == AV_NOPTS_VALUE && !tailing_) return false;
+        fmtCtx_->duration = duration;
+    }
     return true;
 }
 
@@ -78,6 +242,30 @@ void Demuxer::close() {
         avformat_close_input(&fmtCtx_);
         fmtCtx_ = nullptr;
     }
+    // After the format context, which reads through it until closed.
+    if (prefetch_) {
+        PrefetchReader::Stats stats = prefetch_->stats();
+        // The first read always waits for the initial fill.
+        if (stats.stalls > 1) {
+            std::cout << "[Demuxer] Read-ahead: " << stats.bytesRead / (1024 * 1024) << " MB, waited on storage "
+                      << stats.stalls << " time(s), " << (int)(stats.stallSeconds * 1000.0) << " ms" << std::endl;
+        }
+        prefetch_.reset();
+    }
+    if (mapped_) {
+        const MappedReader::Stats& stats = mapped_->stats();
+        std::cout << "[Demuxer] Mapped input: " << stats.bytesRead / (1024 * 1024) << " MB in " << stats.reads
+                  << " read(s), " << stats.seeks << " seek(s)" << std::endl;
+        mapped_.reset();
+    }
+    index_.reset();
+    tailing_ = false;
+#ifndef _WIN32
+    if (tailNotifyFd_ >= 0) {
+        ::close(tailNotifyFd_);
+        tailNotifyFd_ = -1;
+    }
+#endif
     streams_.clear();
     videoStreamIndex_ = -1;
     audioStreamIndex_ = -1;
@@ -91,4 +279,124 @@ bool Demuxer::readPacket(AVPacket* packet) {
 bool Demuxer::seek(int streamIndex, int64_t timestamp, int flags) {
     if (!fmtCtx_) return false;
     return av_seek_frame(fmtCtx_, streamIndex, timestamp, flags) >= 0;
-}
\ No newline at end of file
+}
+
+int64_t Demuxer::getStartTime() const {
+    if (!fmtCtx_) return 0;
+    if (fmtCtx_->start_time != AV_NOPTS_VALUE) return fmtCtx_->start_time;
+    // A header-only open skips the pass that fills in the container's start time.
+    if (videoStreamIndex_ >= 0) {
+        const AVStream* stream = fmtCtx_->streams[videoStreamIndex_];
+        if (stream->start_time != AV_NOPTS_VALUE) {
+            return av_rescale_q(stream->start_time, stream->time_base, AV_TIME_BASE_Q);
+        }
+    }
+    return 0;
+}
+
+bool Demuxer::hasExactDuration() const {
+    if (!fmtCtx_ || tailing_ || fmtCtx_->duration <= 0) return false;
+    if (fmtCtx_->duration_estimation_method == AVFMT_DURATION_FROM_BITRATE) return false;
+    if (videoStreamIndex_ < 0) return true;
+
+    // The average rate of a variable frame rate stream drifts from its base rate; a
+    // header-only open knows neither.
+    const AVStream* stream = fmtCtx_->streams[videoStreamIndex_];
+    if (stream->r_frame_rate.num <= 0 || stream->avg_frame_rate.num <= 0) return false;
+    double ratio = av_q2d(stream->avg_frame_rate) / av_q2d(stream->r_frame_rate);
+    return ratio > 0.99 && ratio < 1.01;
+}
+
+bool Demuxer::seekIndexed(int64_t timestamp) {
+    if (!fmtCtx_) return false;
+    // Stream timestamps, and av_seek_frame(), count from the container's start time.
+    timestamp += getStartTime();
+
+    int streamIndex = videoStreamIndex_ >= 0 ? videoStreamIndex_ : 0;
+    const SeekIndex::Entry* keyframe = nullptr;
+    if (index_ && streamIndex < (int)index_->streams().size() && streamIndex < (int)fmtCtx_->nb_streams) {
+        const SeekIndex::Stream& indexed = index_->streams()[streamIndex];
+        const AVStream* stream = fmtCtx_->streams[streamIndex];
+        // An index of a different layout (e.g. streams found in another order) can't be used.
+        if (indexed.type == stream->codecpar->codec_type && av_cmp_q(indexed.timeBase, stream->time_base) == 0) {
+            keyframe = index_->keyframeBefore(streamIndex, av_rescale_q(timestamp, AV_TIME_BASE_Q, stream->time_base));
+        }
+    }
+    if (!keyframe) {
+        return av_seek_frame(fmtCtx_, -1, timestamp, AVSEEK_FLAG_BACKWARD) >= 0;
+    }
+
+    // MPEG-TS/PS resync on the next packet header, so the keyframe's own offset is a valid
+    // place to continue. Other demuxers keep parser state (e.g. Matroska's clusters) that
+    // only their own seek restores.
+    int formatFlags = fmtCtx_->iformat->flags;
+    if (keyframe->pos >= 0 && (formatFlags & AVFMT_TS_DISCONT) && !(formatFlags & AVFMT_NO_BYTE_SEEK)) {
+        if (av_seek_frame(fmtCtx_, streamIndex, keyframe->pos, AVSEEK_FLAG_BYTE) >= 0) return true;
+    }
+    return av_seek_frame(fmtCtx_, streamIndex, SeekIndex::entryTime(*keyframe), AVSEEK_FLAG_BACKWARD) >= 0;
+}
+
+bool Demuxer::isGrowing(const std::string& inputPath, std::chrono::milliseconds idleTimeout) {
+    std::error_code ec;
+    auto writeTime = fs::last_write_time(Utf8ToPath(inputPath), ec);
+    if (ec) return false;
+    return fs::file_time_type::clock::now() - writeTime < idleTimeout;
+}
+
+int Demuxer::tailInterrupt(void* opaque) {
+    Demuxer* self = static_cast<Demuxer*>(opaque);
+    const AVIOInterruptCB& callback = self->interruptCallback_;
+    if (callback.callback && callback.callback(callback.opaque)) return 1;
+    if (self->tailing_) self->checkWriter();
+    return 0;
+}
+
+void Demuxer::checkWriter() {
+    int64_t now = av_gettime_relative();
+    // Still opening: the protocol context to switch off isn't there yet.
+    if (now - tailCheckTime_ < kTailCheckIntervalUs || !fmtCtx_ || !fmtCtx_->pb) return;
+    tailCheckTime_ = now;
+
+    std::error_code ec;
+    int64_t size = (int64_t)fs::file_size(Utf8ToPath(inputPath_), ec);
+    if (!ec && size != tailSize_) {
+        tailSize_ = size;
+        tailGrowTime_ = now;
+    }
+    bool idle = now - tailGrowTime_ >= (int64_t)tailIdleTimeout_.count() * 1000;
+    bool closed = writerClosed();
+    if (!idle && !closed) return;
+
+    // From here reads stop at the end of what's there and the demuxer sees a normal EOF,
+    // so parsers and the encoder are flushed as for any other file.
+    tailing_ = false;
+    if (av_opt_set_int(fmtCtx_->pb, "follow", 0, AV_OPT_SEARCH_CHILDREN) < 0) {
+        std::cerr << "[Demuxer] Could not stop following " << inputPath_ << std::endl;
+        return;
+    }
+    std::cout << "[Demuxer] Input " << (closed ? "closed by its writer" : "idle") << ", reading to its end" << std::endl;
+}
+
+bool Demuxer::writerClosed() {
+#ifdef _WIN32
+    // Sharing read access only fails while someone still holds the file open for writing.
+    HANDLE file = CreateFileW(Utf8ToWide(inputPath_).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    CloseHandle(file);
+    return true;
+#else
+    if (tailNotifyFd_ < 0) return false;
+    alignas(struct inotify_event) char buffer[4096];
+    bool closed = false;
+    ssize_t length;
+    while ((length = read(tailNotifyFd_, buffer, sizeof(buffer))) > 0) {
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)cursor;
+            if (event->mask & IN_CLOSE_WRITE) closed = true;
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return closed;
+#endif
+}
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <string>
+#include <chrono>
 #include <memory>
 #include <functional>
 #include <vector>
+#include "mapped_reader.h"
+#include "prefetch_reader.h"
+#include "seek_index.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -24,20 +28,117 @@ public:
     Demuxer();
     ~Demuxer();
 
+    // Applied on the next open(); lets blocking reads bail out, e.g. TranscodeControl::interruptCallback.
+    void setInterruptCallback(int (*callback)(void*), void* opaque) { interruptCallback_ = {callback, opaque}; }
+
+    // Tail mode, for inputs still being written (e.g. recordings): at the current end of the
+    // file reads wait for more data instead of returning EOF, until the writer closes the
+    // file or nothing has been appended for idleTimeout. Applied on the next open(); a file
+    // that hasn't changed for idleTimeout by then is read normally. Only streamable
+    // containers (MPEG-TS, Matroska, fragmented MP4) can be read while they grow.
+    void setTailMode(bool enabled, std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(10000)) {
+        tailMode_ = enabled;
+        tailIdleTimeout_ = idleTimeout;
+    }
+    // True when the last open() is following a growing file.
+    bool isTailing() const { return tailing_; }
+    // Whether the file was modified within the last `idleTimeout`, i.e. may still be growing.
+    static bool isGrowing(const std::string& inputPath, std::chrono::milliseconds idleTimeout);
+
+    // Reads go through a PrefetchReader with a ring buffer of this many bytes, so demuxing
+    // doesn't wait on storage latency during sequential reads. 0 leaves I/O to FFmpeg's
+    // synchronous file protocol, as do tailed inputs. Applied on the next open().
+    static const size_t kDefaultReadAhead = 8 * 1024 * 1024;
+    void setReadAhead(size_t bytes) { readAheadBytes_ = bytes; }
+
+    // Reads are served from a memory mapping of the file (see MappedReader) rather than
+    // read calls, which suits remuxing and splitting where demuxing is most of the work.
+    // Takes precedence over read-ahead; not used for tailed inputs, and files that can't be
+    // mapped fall back to read-ahead. Applied on the next open().
+    void setMemoryMapped(bool enabled) { memoryMapped_ = enabled; }
+
+    // How much open() must learn about the audio and video streams. Full runs FFmpeg's
+    // stream analysis with its default limits, decoding up to several seconds of every
+    // stream; encoding needs that. The lighter levels take the container header's word
+    // when it has everything, and otherwise analyse at most kBoundedProbeSize bytes /
+    // kBoundedAnalyzeDuration, falling back to the full analysis only if streams are still
+    // incomplete after that. Applied on the next open().
+    enum class Probe {
+        Full,
+        Formats,    // Codecs, dimensions, pixel/sample formats and frame rates
+        Header,     // Codecs, dimensions and duration; enough for playback and stream copy
+    };
+    static const int64_t kBoundedProbeSize = 1024 * 1024;
+    static const int64_t kBoundedAnalyzeDuration = AV_TIME_BASE / 2;
+    void setProbe(Probe probe) { probe_ = probe; }
+
     bool open(const std::string& inputPath);
     void close();
 
     bool readPacket(AVPacket* packet);
     bool seek(int streamIndex, int64_t timestamp, int flags = 0);
 
+    // A packet index of the open file (see SeekIndex), used by seekIndexed(). Cleared by
+    // close(), so set it after open().
+    void setIndex(std::shared_ptr<const SeekIndex> index) { index_ = std::move(index); }
+    const SeekIndex* index() const { return index_.get(); }
+    // Seeks to the keyframe at or before `timestamp` (AV_TIME_BASE units after
+    // getStartTime()) of the video stream, or the first stream without video. With an index
+    // it is looked up there and containers that can resume at any packet (MPEG-TS/PS) jump
+    // straight to its byte position; the rest are sought to that keyframe's exact
+    // timestamp. Without an index this is av_seek_frame() backwards from `timestamp`.
+    bool seekIndexed(int64_t timestamp);
+
     const std::vector<StreamInfo>& getStreams() const { return streams_; }
     int getVideoStreamIndex() const { return videoStreamIndex_; }
     int getAudioStreamIndex() const { return audioStreamIndex_; }
     AVFormatContext* getFormatContext() const { return fmtCtx_; }
     int64_t getDuration() const { return fmtCtx_ ? fmtCtx_->duration : 0; }
+    // Timestamp of the file's first frame in AV_TIME_BASE units, 0 if unknown. Rarely 0 for MPEG-TS.
+    int64_t getStartTime() const;
+    // Whether getDuration() times the frame rate predicts the frame count: the duration
+    // comes from the container or timestamps (not the bit rate), the video is constant
+    // frame rate and the file isn't growing.
+    bool hasExactDuration() const;
+    // Latency of the last successful open(), and which probe tier it ended at.
+    double openSeconds() const { return openSeconds_; }
+    const char* probeUsed() const { return probeUsed_; }
 
 private:
     AVFormatContext* fmtCtx_ = nullptr;
+    AVIOInterruptCB interruptCallback_ = {nullptr, nullptr};
+    Probe probe_ = Probe::Full;
+    double openSeconds_ = 0.0;
+    const char* probeUsed_ = "";
+
+    size_t readAheadBytes_ = kDefaultReadAhead;
+    std::unique_ptr<PrefetchReader> prefetch_;
+    bool memoryMapped_ = false;
+    std::unique_ptr<MappedReader> mapped_;
+    std::shared_ptr<const SeekIndex> index_;
+
+    bool tailMode_ = false;
+    std::chrono::milliseconds tailIdleTimeout_{10000};
+    bool tailing_ = false;
+    std::string inputPath_;
+    int64_t tailCheckTime_ = 0;     // av_gettime_relative() of the last writer check
+    int64_t tailSize_ = -1;         // File size at the last check
+    int64_t tailGrowTime_ = 0;      // When the size last changed
+#ifndef _WIN32
+    int tailNotifyFd_ = -1;         // inotify on the input, for the writer's close
+#endif
+
+    bool openInput(const std::string& inputPath, const std::string& pathForFFmpeg);
+    void closeInput();
+    // Whether the audio and video streams have what probe_ asks for, either straight from
+    // the header or after a stream info pass.
+    bool streamsComplete(bool headerOnly);
+
+    // Installed as the interrupt callback while tailing: forwards to the caller's callback
+    // and ends the follow once the writer is done.
+    static int tailInterrupt(void* opaque);
+    void checkWriter();
+    bool writerClosed();
     std::vector<StreamInfo> streams_;
     int videoStreamIndex_ = -1;
     int audioStreamIndex_ = -1;
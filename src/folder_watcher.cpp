@@ -0,0 +1,382 @@
+#include "folder_watcher.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// How often pending files are re-checked while any are waiting to settle.
+static const int kSettlePollMs = 500;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+
+static std::string WideToUtf8(const std::wstring& wstr) {
+    if (wstr.empty()) return std::string();
+    int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
+    std::string strTo(size_needed, 0);
+    WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
+    return strTo;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+
+static std::string PathToUtf8(const fs::path& path) {
+    return WideToUtf8(path.wstring());
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+
+static std::string PathToUtf8(const fs::path& path) {
+    return path.string();
+}
+#endif
+
+// Size and modification time, or false if the file is gone.
+static bool fileStamp(const std::string& path, int64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    fs::path p = Utf8ToPath(path);
+    if (!fs::is_regular_file(p, ec)) return false;
+    uintmax_t fileSize = fs::file_size(p, ec);
+    if (ec) return false;
+    auto writeTime = fs::last_write_time(p, ec);
+    if (ec) return false;
+    size = (int64_t)fileSize;
+    mtime = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+FolderWatcher::~FolderWatcher() {
+    stop();
+}
+
+bool FolderWatcher::start(const std::string& folder, const Options& options, Callback onReady) {
+    stop();
+
+    std::error_code ec;
+    if (!fs::is_directory(Utf8ToPath(folder), ec)) {
+        std::cerr << "[FolderWatcher] Not a folder: " << folder << std::endl;
+        return false;
+    }
+    folder_ = folder;
+    options_ = options;
+    onReady_ = std::move(onReady);
+    pending_.clear();
+    reported_.clear();
+
+#ifdef _WIN32
+    directory_ = CreateFileW(Utf8ToWide(folder).c_str(), FILE_LIST_DIRECTORY,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                             FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (directory_ == INVALID_HANDLE_VALUE) {
+        directory_ = nullptr;
+        std::cerr << "[FolderWatcher] Could not open " << folder << std::endl;
+        return false;
+    }
+    stopEvent_ = CreateEventW(NULL, TRUE, FALSE, NULL);
+#else
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0 || pipe(stopPipe_) != 0) {
+        std::cerr << "[FolderWatcher] inotify unavailable for " << folder << std::endl;
+        if (inotifyFd_ >= 0) close(inotifyFd_);
+        inotifyFd_ = -1;
+        return false;
+    }
+    // Watches go in before the initial listing so nothing lands in between unseen.
+    addWatches(folder);
+#endif
+
+    running_ = true;
+    thread_ = std::thread(&FolderWatcher::run, this);
+    std::cout << "[FolderWatcher] Watching " << folder << (options_.recursive ? " (recursive)" : "") << std::endl;
+    return true;
+}
+
+void FolderWatcher::stop() {
+    if (!thread_.joinable()) return;
+    running_ = false;
+#ifdef _WIN32
+    SetEvent(stopEvent_);
+    thread_.join();
+    CloseHandle(directory_);
+    CloseHandle(stopEvent_);
+    directory_ = nullptr;
+    stopEvent_ = nullptr;
+#else
+    char wake = 1;
+    if (write(stopPipe_[1], &wake, 1) < 0) {
+        // The loop also checks running_ between events.
+    }
+    thread_.join();
+    close(inotifyFd_);
+    close(stopPipe_[0]);
+    close(stopPipe_[1]);
+    inotifyFd_ = -1;
+    stopPipe_[0] = stopPipe_[1] = -1;
+    watches_.clear();
+#endif
+}
+
+bool FolderWatcher::wanted(const std::string& path) const {
+    fs::path p = Utf8ToPath(path);
+    std::string name = PathToUtf8(p.filename());
+    // Dot files are the usual temporaries of rsync and friends, renamed into place when done.
+    if (name.empty() || name[0] == '.' || name.back() == '~') return false;
+    return options_.extensions.empty() || hasExtension(path, options_.extensions);
+}
+
+bool FolderWatcher::hasExtension(const std::string& path, const std::vector<std::string>& extensions) {
+    std::string ext = PathToUtf8(Utf8ToPath(path).extension());
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
+void FolderWatcher::candidate(const std::string& path, bool closed) {
+    if (!wanted(path)) return;
+    if (closed) {
+        pending_.erase(path);
+        report(path);
+        return;
+    }
+    Pending& pending = pending_[path];
+    pending.size = -1;
+    pending.changed = std::chrono::steady_clock::now();
+}
+
+void FolderWatcher::checkSettled() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        int64_t size = 0, mtime = 0;
+        if (!fileStamp(it->first, size, mtime)) {
+            it = pending_.erase(it);   // Deleted or renamed away
+            continue;
+        }
+        if (size > 0 && hasExtension(it->first, options_.growingExtensions)) {
+            std::string path = it->first;
+            it = pending_.erase(it);
+            report(path);
+            continue;
+        }
+        if (size != it->second.size) {
+            it->second.size = size;
+            it->second.changed = now;
+        } else if (now - it->second.changed >= options_.settleTime) {
+#ifdef _WIN32
+            // A writer that merely paused still holds the file open.
+            HANDLE file = CreateFileW(Utf8ToWide(it->first).c_str(), GENERIC_READ, 0, NULL, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                it->second.changed = now;
+                ++it;
+                continue;
+            }
+            CloseHandle(file);
+#endif
+            std::string path = it->first;
+            it = pending_.erase(it);
+            report(path);
+            continue;
+        }
+        ++it;
+    }
+}
+
+void FolderWatcher::scanExisting(const std::string& dir) {
+    std::error_code ec;
+    auto settledBefore = fs::file_time_type::clock::now() -
+                         std::chrono::duration_cast<fs::file_time_type::duration>(options_.settleTime);
+    auto visit = [&](const fs::directory_entry& entry) {
+        std::error_code entryEc;
+        if (!entry.is_regular_file(entryEc)) return;
+        std::string path = PathToUtf8(entry.path());
+        if (!wanted(path)) return;
+        // Files untouched for the settle time are taken as complete; anything newer may
+        // still be copying in.
+        if (entry.last_write_time(entryEc) < settledBefore) {
+            report(path);
+        } else {
+            candidate(path, false);
+        }
+    };
+    fs::path root = Utf8ToPath(dir);
+    if (options_.recursive) {
+        for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            visit(*it);
+        }
+    } else {
+        for (auto it = fs::directory_iterator(root, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            visit(*it);
+        }
+    }
+}
+
+void FolderWatcher::report(const std::string& path) {
+    int64_t size = 0, mtime = 0;
+    if (!fileStamp(path, size, mtime) || size == 0) return;
+
+    auto stamp = std::make_pair(size, mtime);
+    auto it = reported_.find(path);
+    if (it != reported_.end() && it->second == stamp) return;
+    // A growing file is reported while it is still written, so its later close is expected.
+    bool replaces = it != reported_.end() && !hasExtension(path, options_.growingExtensions);
+    reported_[path] = stamp;
+
+    std::cout << "[FolderWatcher] " << (replaces ? "Rewritten: " : "Ready: ") << path << std::endl;
+    if (onReady_) onReady_(path, replaces);
+}
+
+#ifdef _WIN32
+void FolderWatcher::run() {
+    if (options_.includeExisting) scanExisting(folder_);
+
+    // DWORD-aligned, as ReadDirectoryChangesW requires. 64 KB is the limit for network shares.
+    std::vector<DWORD> buffer(64 * 1024 / sizeof(DWORD));
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    auto issue = [&]() {
+        ResetEvent(overlapped.hEvent);
+        return ReadDirectoryChangesW(directory_, buffer.data(), (DWORD)(buffer.size() * sizeof(DWORD)),
+                                     options_.recursive ? TRUE : FALSE, filter, NULL, &overlapped, NULL) != FALSE;
+    };
+    if (!issue()) {
+        std::cerr << "[FolderWatcher] ReadDirectoryChangesW failed for " << folder_ << std::endl;
+        CloseHandle(overlapped.hEvent);
+        return;
+    }
+
+    HANDLE handles[2] = {stopEvent_, overlapped.hEvent};
+    while (running_) {
+        DWORD timeout = pending_.empty() ? INFINITE : kSettlePollMs;
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeout);
+        if (wait == WAIT_OBJECT_0) break;
+
+        if (wait == WAIT_OBJECT_0 + 1) {
+            DWORD bytes = 0;
+            GetOverlappedResult(directory_, &overlapped, &bytes, FALSE);
+            if (bytes == 0) {
+                // The change buffer overflowed and events were lost: list the folder once.
+                std::cerr << "[FolderWatcher] Change buffer overflowed, relisting " << folder_ << std::endl;
+                scanExisting(folder_);
+            } else {
+                const char* cursor = (const char*)buffer.data();
+                while (true) {
+                    const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)cursor;
+                    if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+                        info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                        std::wstring name(info->FileName, info->FileNameLength / sizeof(wchar_t));
+                        candidate(PathToUtf8(Utf8ToPath(folder_) / fs::path(name)), false);
+                    }
+                    if (info->NextEntryOffset == 0) break;
+                    cursor += info->NextEntryOffset;
+                }
+            }
+            if (!issue()) break;
+        }
+        checkSettled();
+    }
+
+    CancelIo(directory_);
+    DWORD bytes = 0;
+    GetOverlappedResult(directory_, &overlapped, &bytes, TRUE);
+    CloseHandle(overlapped.hEvent);
+}
+#else
+void FolderWatcher::addWatches(const std::string& dir) {
+    const uint32_t mask = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+    int wd = inotify_add_watch(inotifyFd_, dir.c_str(), mask);
+    if (wd < 0) {
+        std::cerr << "[FolderWatcher] Could not watch " << dir << " (see fs.inotify.max_user_watches)" << std::endl;
+        return;
+    }
+    watches_[wd] = dir;
+    if (!options_.recursive) return;
+
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code entryEc;
+        if (!it->is_directory(entryEc)) continue;
+        std::string sub = it->path().string();
+        wd = inotify_add_watch(inotifyFd_, sub.c_str(), mask);
+        if (wd >= 0) watches_[wd] = sub;
+    }
+}
+
+void FolderWatcher::run() {
+    if (options_.includeExisting) scanExisting(folder_);
+
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopPipe_[0], POLLIN, 0}};
+
+    while (running_) {
+        int timeout = pending_.empty() ? -1 : kSettlePollMs;
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0 && errno != EINTR) break;
+        if (fds[1].revents) break;
+
+        if (ready > 0 && (fds[0].revents & POLLIN)) {
+            ssize_t length;
+            while ((length = read(inotifyFd_, buffer, sizeof(buffer))) > 0) {
+                for (char* cursor = buffer; cursor < buffer + length;) {
+                    const struct inotify_event* event = (const struct inotify_event*)cursor;
+                    cursor += sizeof(struct inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        // The kernel queue overflowed and events were lost: list the folder once.
+                        std::cerr << "[FolderWatcher] Event queue overflowed, relisting " << folder_ << std::endl;
+                        scanExisting(folder_);
+                        continue;
+                    }
+                    if (event->mask & IN_IGNORED) {
+                        watches_.erase(event->wd);
+                        continue;
+                    }
+                    auto dir = watches_.find(event->wd);
+                    if (dir == watches_.end() || event->len == 0) continue;
+                    std::string path = dir->second + "/" + event->name;
+
+                    if (event->mask & IN_ISDIR) {
+                        // A new subfolder: watch it, then pick up what was written before the watch.
+                        if (options_.recursive && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                            addWatches(path);
+                            scanExisting(path);
+                        }
+                    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                        candidate(path, true);
+                    } else if ((event->mask & IN_CREATE) && hasExtension(path, options_.growingExtensions)) {
+                        // Everything else waits for its close; a writer that stalls for a
+                        // while must not get its file queued half-written.
+                        candidate(path, false);
+                    }
+                }
+            }
+        }
+        checkSettled();
+    }
+}
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Watches a folder and reports each file once it has been completely written, without
+// rescanning the folder. On Linux this is inotify: a file is reported when it is closed
+// after writing (IN_CLOSE_WRITE) or renamed into the folder (IN_MOVED_TO), never because it
+// merely stopped growing for a while. Only files already in the folder at start() have to
+// be judged by their size having stopped changing for settleTime, since their writer may
+// have closed before the watch. Windows has no close notification, so there every file goes
+// through the size check and must also open exclusively. A file that changes after such a
+// guess is reported again with `replaces` set.
+class FolderWatcher {
+public:
+    struct Options {
+        bool recursive = false;
+        // Files already in the folder at start() are reported too (one listing, not a rescan).
+        bool includeExisting = true;
+        std::chrono::milliseconds settleTime{10000};
+        // Lowercase, with the dot; empty accepts every file. Hidden files are always skipped.
+        std::vector<std::string> extensions;
+        // Files with these extensions are reported as soon as they hold data rather than when
+        // complete, for a reader that follows them while they grow (Demuxer::setTailMode).
+        std::vector<std::string> growingExtensions;
+    };
+
+    // Called on the watcher thread with the UTF-8 path of a finished file. `replaces` is set
+    // when the file was reported before and has been written to since (so the earlier report
+    // was premature); files followed while growing are never reported as replacing.
+    using Callback = std::function<void(const std::string& path, bool replaces)>;
+
+    FolderWatcher() = default;
+    ~FolderWatcher();
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    bool start(const std::string& folder, const Options& options, Callback onReady);
+    void stop();
+    bool isRunning() const { return running_; }
+    const std::string& folder() const { return folder_; }
+
+private:
+    struct Pending {
+        int64_t size = -1;
+        std::chrono::steady_clock::time_point changed;
+    };
+
+    std::string folder_;
+    Options options_;
+    Callback onReady_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    // Watcher thread only.
+    std::map<std::string, Pending> pending_;
+    // Size and mtime when last reported, so a file closed twice is only queued once.
+    std::map<std::string, std::pair<int64_t, int64_t>> reported_;
+
+#ifdef _WIN32
+    void* directory_ = nullptr;     // HANDLE
+    void* stopEvent_ = nullptr;     // HANDLE
+#else
+    int inotifyFd_ = -1;
+    int stopPipe_[2] = {-1, -1};
+    std::map<int, std::string> watches_;    // watch descriptor -> directory
+    void addWatches(const std::string& dir);
+#endif
+
+    void run();
+    bool wanted(const std::string& path) const;
+    static bool hasExtension(const std::string& path, const std::vector<std::string>& extensions);
+    // `closed`: the writer is known to be done, so no settle time is needed.
+    void candidate(const std::string& path, bool closed);
+    void checkSettled();
+    void scanExisting(const std::string& dir);
+    void report(const std::string& path);
+};
@@ -0,0 +1,87 @@
+#include "frame_converter.h"
+#include <iostream>
+#include <chrono>
+#include <string>
+
+extern "C" {
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+FrameConverter::FrameConverter() {}
+
+FrameConverter::~FrameConverter() {
+    close();
+}
+
+bool FrameConverter::init(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt,
+                          int dstWidth, int dstHeight, AVPixelFormat dstPixFmt, int threads) {
+    close();
+    latency_.reset();
+
+    if (kernelsEnabled_ && srcWidth == dstWidth && srcHeight == dstHeight) {
+        kernel_ = PixelConvert::find(srcPixFmt, dstPixFmt, maxSimdLevel_);
+        if (kernel_.valid()) {
+            std::cout << "[FrameConverter] " << av_get_pix_fmt_name(srcPixFmt) << " -> " << av_get_pix_fmt_name(dstPixFmt)
+                      << ", kernel: " << PixelConvert::levelName(kernel_.level) << std::endl;
+            return true;
+        }
+    }
+
+    swsCtx_ = sws_alloc_context();
+    if (!swsCtx_) return false;
+
+    av_opt_set_int(swsCtx_, "srcw", srcWidth, 0);
+    av_opt_set_int(swsCtx_, "srch", srcHeight, 0);
+    av_opt_set_int(swsCtx_, "src_format", srcPixFmt, 0);
+    av_opt_set_int(swsCtx_, "dstw", dstWidth, 0);
+    av_opt_set_int(swsCtx_, "dsth", dstHeight, 0);
+    av_opt_set_int(swsCtx_, "dst_format", dstPixFmt, 0);
+    av_opt_set_int(swsCtx_, "sws_flags", SWS_BICUBIC, 0);
+    av_opt_set_int(swsCtx_, "threads", threads, 0);
+
+    if (sws_init_context(swsCtx_, nullptr, nullptr) < 0) {
+        std::cerr << "[FrameConverter] Failed to create SwsContext for conversion" << std::endl;
+        sws_freeContext(swsCtx_);
+        swsCtx_ = nullptr;
+        return false;
+    }
+
+    std::cout << "[FrameConverter] " << av_get_pix_fmt_name(srcPixFmt) << " -> " << av_get_pix_fmt_name(dstPixFmt)
+              << ", threads: " << (threads > 0 ? std::to_string(threads) : std::string("auto")) << std::endl;
+    return true;
+}
+
+void FrameConverter::close() {
+    if (swsCtx_) {
+        sws_freeContext(swsCtx_);
+        swsCtx_ = nullptr;
+    }
+    kernel_ = PixelKernel();
+}
+
+bool FrameConverter::convert(const AVFrame* src, AVFrame* dst) {
+    if (!isActive()) return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (kernel_.valid()) {
+        if (src->format != kernel_.srcFmt || dst->format != kernel_.dstFmt ||
+            src->width != dst->width || src->height != dst->height) {
+            std::cerr << "[FrameConverter] Frame does not match kernel formats" << std::endl;
+            return false;
+        }
+        kernel_.run(src, dst);
+    } else {
+        // sws_scale_frame() is the entry point that runs slices on swscale's worker threads.
+        int ret = sws_scale_frame(swsCtx_, dst, src);
+        if (ret < 0) {
+            std::cerr << "[FrameConverter] Conversion failed: " << ret << std::endl;
+            return false;
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    latency_.record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
+}
+
+#include "latency_histogram.h"
+#include "pixel_convert.h"
+
+// Pixel format / size conversion between decoder output and encoder input.
+// Same-size NV12 / P010 / yuv420p10 conversions use the SIMD kernels in pixel_convert;
+// everything else uses swscale with slice threading, so one large frame is converted by several workers.
+class FrameConverter {
+public:
+    FrameConverter();
+    ~FrameConverter();
+
+    FrameConverter(const FrameConverter&) = delete;
+    FrameConverter& operator=(const FrameConverter&) = delete;
+
+    // threads: 0 = one per core, 1 = convert on the calling thread. Only applies to the swscale
+    // path: kernels always run single-threaded on the calling thread, so the conversion thread
+    // count a caller sets (e.g. VideoEncoder::setConversionThreads()) is ignored for them.
+    bool init(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt,
+              int dstWidth, int dstHeight, AVPixelFormat dstPixFmt, int threads = 0);
+    void close();
+
+    bool isActive() const { return swsCtx_ != nullptr || kernel_.valid(); }
+    bool usesKernel() const { return kernel_.valid(); }
+    bool convert(const AVFrame* src, AVFrame* dst);
+
+    const LatencyHistogram& latency() const { return latency_; }
+
+    // Caps the kernel instruction set (Scalar still beats swscale); takes effect on the next init().
+    void setMaxSimdLevel(SimdLevel level) { maxSimdLevel_ = level; }
+    void setKernelsEnabled(bool enabled) { kernelsEnabled_ = enabled; }
+
+private:
+    SwsContext* swsCtx_ = nullptr;
+    PixelKernel kernel_;
+    SimdLevel maxSimdLevel_ = SimdLevel::AVX512;
+    bool kernelsEnabled_ = true;
+    LatencyHistogram latency_;
+};
@@ -0,0 +1,276 @@
+#include "job_journal.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+#endif
+
+static FILE* openFile(const std::string& path, const char* mode) {
+#ifdef _WIN32
+    std::wstring wideMode(mode, mode + strlen(mode));
+    return _wfopen(Utf8ToWide(path).c_str(), wideMode.c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+// fflush only reaches the OS; the journal is only worth anything once it's on the disk.
+static void syncFile(FILE* f) {
+    fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+static bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExW(Utf8ToWide(from).c_str(), Utf8ToWide(to).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static std::string escapeField(const std::string& field) {
+    std::string out;
+    out.reserve(field.size());
+    for (char c : field) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+static std::vector<std::string> splitLine(const std::string& line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (c == '\t') {
+            fields.emplace_back();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            char next = line[++i];
+            fields.back() += next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+        } else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+JobJournal::~JobJournal() {
+    close();
+}
+
+bool JobJournal::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+}
+
+void JobJournal::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void JobJournal::replay(FILE* f, std::map<int, Entry>& entries, std::vector<int>& order) {
+    std::string line;
+    int c;
+    while (true) {
+        line.clear();
+        while ((c = fgetc(f)) != EOF && c != '\n') line += (char)c;
+        // A line without its newline was cut off mid-write; nothing after it is trustworthy.
+        if (c == EOF) break;
+        if (line.empty()) continue;
+
+        std::vector<std::string> fields = splitLine(line);
+        if (fields.size() < 2) continue;
+        const std::string& event = fields[0];
+        int id = std::atoi(fields[1].c_str());
+
+        if (event == "add" && fields.size() >= 5) {
+            Entry& entry = entries[id];
+            entry = Entry();
+            entry.id = id;
+            entry.encoder = fields[2];
+            entry.inputPath = fields[3];
+            entry.outputPath = fields[4];
+            order.push_back(id);
+            continue;
+        }
+
+        auto it = entries.find(id);
+        if (it == entries.end()) continue;
+        Entry& entry = it->second;
+
+        if (event == "start" && fields.size() >= 3) {
+            entry.started = true;
+            entry.outputPath = fields[2];
+        } else if (event == "plan" && fields.size() >= 3) {
+            entry.resume = ChunkedTranscoder::ResumePoint();
+            const char* p = fields[2].c_str();
+            while (*p) {
+                char* end = nullptr;
+                long long pts = std::strtoll(p, &end, 10);
+                if (end == p) break;
+                entry.resume.boundaries.push_back(pts);
+                p = *end == ',' ? end + 1 : end;
+            }
+            // Plans written before the stamp existed keep inputSize -1 and are never resumed.
+            if (fields.size() >= 6) {
+                entry.resume.inputSize = std::strtoll(fields[3].c_str(), nullptr, 10);
+                entry.resume.inputMtime = std::strtoll(fields[4].c_str(), nullptr, 10);
+                entry.resume.encoder = fields[5];
+            }
+        } else if (event == "chunk" && fields.size() >= 5) {
+            ChunkedTranscoder::ChunkRecord chunk;
+            chunk.index = std::atoi(fields[2].c_str());
+            chunk.tsOffset = std::strtoll(fields[3].c_str(), nullptr, 10);
+            if (std::sscanf(fields[4].c_str(), "%d/%d", &chunk.encTimeBase.num, &chunk.encTimeBase.den) == 2 &&
+                chunk.encTimeBase.num > 0 && chunk.encTimeBase.den > 0) {
+                entry.resume.completed.push_back(chunk);
+            }
+        } else if (event == "done" || event == "failed" || event == "cancelled") {
+            entries.erase(it);
+        }
+    }
+}
+
+std::vector<std::vector<std::string>> JobJournal::entryLines(const Entry& entry) {
+    std::vector<std::vector<std::string>> lines;
+    std::string id = std::to_string(entry.id);
+    lines.push_back({"add", id, entry.encoder, entry.inputPath, entry.outputPath});
+    if (entry.started) {
+        lines.push_back({"start", id, entry.outputPath});
+    }
+    if (!entry.resume.boundaries.empty()) {
+        std::string list;
+        for (int64_t pts : entry.resume.boundaries) {
+            if (!list.empty()) list += ",";
+            list += std::to_string(pts);
+        }
+        lines.push_back({"plan", id, list, std::to_string(entry.resume.inputSize),
+                         std::to_string(entry.resume.inputMtime), entry.resume.encoder});
+        for (const auto& chunk : entry.resume.completed) {
+            lines.push_back({"chunk", id, std::to_string(chunk.index), std::to_string(chunk.tsOffset),
+                             std::to_string(chunk.encTimeBase.num) + "/" + std::to_string(chunk.encTimeBase.den)});
+        }
+    }
+    return lines;
+}
+
+bool JobJournal::writeLine(FILE* f, const std::vector<std::string>& fields) {
+    std::string line;
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (i > 0) line += '\t';
+        line += escapeField(fields[i]);
+    }
+    line += '\n';
+    return fwrite(line.data(), 1, line.size(), f) == line.size();
+}
+
+std::vector<JobJournal::Entry> JobJournal::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    path_ = path;
+
+    std::map<int, Entry> entries;
+    std::vector<int> order;
+    if (FILE* f = openFile(path, "rb")) {
+        replay(f, entries, order);
+        fclose(f);
+    }
+
+    std::vector<Entry> unfinished;
+    for (int id : order) {
+        auto it = entries.find(id);
+        if (it != entries.end() && it->second.id == id) {
+            unfinished.push_back(it->second);
+            entries.erase(it);   // An id is only added once, but don't return it twice
+        }
+    }
+
+    // Rewrite with only the unfinished jobs so the file doesn't grow forever. The rename
+    // is atomic, so a crash here leaves either the old journal or the new one.
+    std::string tempPath = path + ".tmp";
+    if (FILE* f = openFile(tempPath, "wb")) {
+        bool ok = true;
+        for (const Entry& entry : unfinished) {
+            for (const auto& fields : entryLines(entry)) ok = ok && writeLine(f, fields);
+        }
+        syncFile(f);
+        fclose(f);
+        if (!ok || !replaceFile(tempPath, path)) {
+            std::cerr << "[JobJournal] Could not compact " << path << std::endl;
+        }
+    }
+
+    file_ = openFile(path, "ab");
+    if (!file_) {
+        std::cerr << "[JobJournal] Could not open " << path << " for writing" << std::endl;
+    }
+    std::cout << "[JobJournal] " << unfinished.size() << " unfinished job(s) in " << path << std::endl;
+    return unfinished;
+}
+
+void JobJournal::append(const std::vector<std::string>& fields) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) return;
+    if (!writeLine(file_, fields)) {
+        std::cerr << "[JobJournal] Write to " << path_ << " failed" << std::endl;
+    }
+    syncFile(file_);
+}
+
+void JobJournal::jobAdded(int id, const std::string& inputPath, const std::string& outputPath, const std::string& encoder) {
+    append({"add", std::to_string(id), encoder, inputPath, outputPath});
+}
+
+void JobJournal::jobStarted(int id, const std::string& outputPath) {
+    append({"start", std::to_string(id), outputPath});
+}
+
+void JobJournal::planRecorded(int id, const ChunkedTranscoder::ResumePoint& plan) {
+    Entry entry;
+    entry.id = id;
+    entry.resume = plan;
+    entry.resume.completed.clear();
+    std::vector<std::vector<std::string>> lines = entryLines(entry);
+    append(lines.back());
+}
+
+void JobJournal::chunkCompleted(int id, const ChunkedTranscoder::ChunkRecord& chunk) {
+    append({"chunk", std::to_string(id), std::to_string(chunk.index), std::to_string(chunk.tsOffset),
+            std::to_string(chunk.encTimeBase.num) + "/" + std::to_string(chunk.encTimeBase.den)});
+}
+
+void JobJournal::jobFinished(int id, const char* outcome) {
+    append({outcome, std::to_string(id)});
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "chunked_transcoder.h"
+
+// Append-only log of job state that survives a crash or power loss. Each event is a single
+// line flushed to disk before the call returns; replaying the file yields the jobs that
+// never finished, along with the chunks of their output that are already complete.
+//
+//   add <id> <encoder> <input> <output>
+//   start <id> <output>               output path actually chosen for the job
+//   plan <id> <pts>,<pts>,... <size> <mtime> <encoder>
+//                                     chunk boundaries, the input's identity and the resolved
+//                                     encoder; drops chunks of an earlier plan
+//   chunk <id> <index> <tsOffset> <num>/<den>
+//   done|failed|cancelled <id>
+//
+// Fields are tab-separated with tabs, newlines and backslashes escaped.
+class JobJournal {
+public:
+    struct Entry {
+        int id = 0;
+        std::string inputPath;
+        std::string outputPath;
+        std::string encoder;
+        bool started = false;   // outputPath is the final name, not the requested one
+        ChunkedTranscoder::ResumePoint resume;
+    };
+
+    JobJournal() = default;
+    ~JobJournal();
+    JobJournal(const JobJournal&) = delete;
+    JobJournal& operator=(const JobJournal&) = delete;
+
+    // Replays the journal at path and keeps it open for appending. Finished jobs are
+    // compacted out of the file. Returns the unfinished jobs in the order they were added.
+    std::vector<Entry> open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    void jobAdded(int id, const std::string& inputPath, const std::string& outputPath, const std::string& encoder);
+    void jobStarted(int id, const std::string& outputPath);
+    void planRecorded(int id, const ChunkedTranscoder::ResumePoint& plan);
+    void chunkCompleted(int id, const ChunkedTranscoder::ChunkRecord& chunk);
+    // outcome is "done", "failed" or "cancelled"; the job won't be resumed either way.
+    void jobFinished(int id, const char* outcome);
+
+private:
+    mutable std::mutex mutex_;
+    FILE* file_ = nullptr;
+    std::string path_;
+
+    void append(const std::vector<std::string>& fields);
+    static bool writeLine(FILE* f, const std::vector<std::string>& fields);
+    static std::vector<std::vector<std::string>> entryLines(const Entry& entry);
+    static void replay(FILE* f, std::map<int, Entry>& entries, std::vector<int>& order);
+};
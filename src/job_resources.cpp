@@ -0,0 +1,135 @@
+#include "job_resources.h"
+#include "media_probe.h"
+#include "demuxer.h"
+#include "video_encoder.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Transcoder::PipelineOptions::frameQueueSize, for the decoded and converted queues.
+static const int kQueuedFrames = 2 * 4;
+// Reference frames a decoder holds on top of one frame per thread (H.264/HEVC DPB).
+static const int kDecoderRefFrames = 16;
+// x265 defaults: rc-lookahead 20, 4 B-frames, 3 refs, plus frame threads in flight. Its
+// internal copies add padding and a quarter-size lowres plane, hence the 1.5x.
+static const int kSoftwareEncoderFrames = 30;
+static const double kSoftwareEncoderOverhead = 1.5;
+static const int kHardwareEncoderFrames = 8;
+// Demuxed packets, the demuxer's read-ahead buffer, muxer interleaving, codec contexts and the like.
+static const int64_t kBaseMemory = 64ll * 1024 * 1024 + Demuxer::kDefaultReadAhead;
+
+bool JobCost::softwareEncoder() const {
+    const AVCodec* encoder = avcodec_find_encoder_by_name(encoderName.c_str());
+    return encoder && !(encoder->capabilities & AV_CODEC_CAP_HARDWARE);
+}
+
+JobCost JobCostEstimator::estimate(const std::string& inputPath, const std::string& encoderName) {
+    JobCost cost;
+    cost.encoderName = encoderName;
+
+    MediaInfo info = MediaProbe::shared().get(inputPath);
+    if (!info.valid) {
+        return cost;
+    }
+
+    int width = std::max(info.width, 16);
+    int height = std::max(info.height, 16);
+    double fps = info.frameRate;
+    if (!(fps > 0.0 && fps < 1000.0)) fps = 30.0;
+
+    cost.probed = true;
+    cost.codecName = info.codecName;
+    cost.width = width;
+    cost.height = height;
+    cost.frameRate = fps;
+    cost.durationSeconds = info.durationSeconds;
+
+    if (info.codecId == VideoEncoder::targetCodecId(encoderName)) {
+        cost.remux = true;
+        cost.cores = 0.25;
+        cost.memoryBytes = kBaseMemory;
+        cost.decoderThreads = 1;
+        return cost;
+    }
+
+    int bytesPerSample = info.bitDepth > 8 ? 2 : 1;
+    int64_t frameBytes = (int64_t)width * height * 3 / 2 * bytesPerSample;
+
+    // Frame threading pays off roughly per 360 lines; an encoder's wavefront rows scale
+    // similarly, so give it about one thread per 135 lines.
+    cost.decoderThreads = std::clamp(height / 360, 1, 8);
+    std::string resolved = VideoEncoder::resolveEncoderName(encoderName, width, height,
+                                                            av_get_pix_fmt(info.pixelFormat.c_str()));
+    if (!resolved.empty()) cost.encoderName = resolved;
+    bool softwareEncoder = cost.softwareEncoder();
+    if (softwareEncoder) {
+        cost.encoderThreads = std::clamp(height / 135, 2, 16);
+    }
+    // Same-size NV12/P010 conversions run single-threaded SIMD kernels; swscale at 4K
+    // and above gets a second slice.
+    cost.conversionThreads = height > 1440 ? 2 : 1;
+
+    // Decode work relative to 1080p30, which one core keeps up with for 8-bit HEVC/H.264.
+    double decodeLoad = (double)width * height * fps / (1920.0 * 1080.0 * 30.0);
+    double decodeCores = std::min((double)cost.decoderThreads, std::max(0.25, decodeLoad));
+    // Encoders aren't real-time: a software encoder keeps every thread it has busy.
+    double encodeCores = softwareEncoder ? cost.encoderThreads : 0.25;
+    cost.cores = decodeCores + encodeCores + 0.5;   // + demux, conversion and mux
+
+    int encoderFrames = softwareEncoder ? kSoftwareEncoderFrames : kHardwareEncoderFrames;
+    double encoderOverhead = softwareEncoder ? kSoftwareEncoderOverhead : 1.0;
+    cost.memoryBytes = kBaseMemory +
+                       frameBytes * (cost.decoderThreads + kDecoderRefFrames + kQueuedFrames) +
+                       (int64_t)(frameBytes * encoderFrames * encoderOverhead);
+
+    std::cout << "[JobCostEstimator] " << width << "x" << height << " @ " << fps << " fps: "
+              << cost.encoderName << ", " << cost.cores << " cores, " << cost.memoryBytes / (1024 * 1024) << " MB" << std::endl;
+    return cost;
+}
+
+void JobCostEstimator::fitToThreads(JobCost& cost, int threads) {
+    int wanted = cost.threadTokens();
+    if (threads >= wanted) return;
+
+    double scale = std::max(threads, 1) / (double)wanted;
+    cost.decoderThreads = std::max(1, (int)(cost.decoderThreads * scale));
+    if (cost.encoderThreads > 0) {
+        cost.encoderThreads = std::max(1, (int)(cost.encoderThreads * scale));
+    }
+    cost.conversionThreads = 1;
+}
+
+int64_t JobCostEstimator::physicalMemoryBytes() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        return (int64_t)status.ullTotalPhys;
+    }
+    return 0;
+#else
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && pageSize > 0 ? (int64_t)pages * pageSize : 0;
+#endif
+}
+
+ResourceBudget JobCostEstimator::defaultBudget() {
+    ResourceBudget budget;
+    budget.cores = std::max(1u, std::thread::hardware_concurrency());
+    int64_t memory = physicalMemoryBytes();
+    budget.memoryBytes = memory > 0 ? memory / 4 * 3 : 8ll * 1024 * 1024 * 1024;
+    return budget;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Estimated steady-state footprint of one transcode job, used by JobManager for admission.
+struct JobCost {
+    double cores = 1.0;         // Cores the job keeps busy; admission charges threadTokens() instead
+    int64_t memoryBytes = 256ll * 1024 * 1024;
+    int decoderThreads = 1;
+    int encoderThreads = 0;     // 0 = leave the encoder's default (hardware encoders)
+    int conversionThreads = 1;  // swscale slices for pixel conversion
+    bool probed = false;        // false when the input couldn't be opened; defaults above apply
+
+    // What the probe found, also used to predict how long the job will take.
+    std::string codecName;
+    int width = 0;
+    int height = 0;
+    double frameRate = 0.0;
+    double durationSeconds = 0.0;
+    bool remux = false;
+    // The encoder that will actually open ("auto" resolved); the requested name when the
+    // input couldn't be probed or nothing opens.
+    std::string encoderName;
+
+    // Software encoders keep every thread they're given busy; hardware ones barely use the
+    // CPU, and have per-GPU session limits that make chunked encoding pointless.
+    bool softwareEncoder() const;
+
+    // CPU budget tokens the thread counts above add up to.
+    int threadTokens() const { return decoderThreads + encoderThreads + conversionThreads; }
+};
+
+// Limits the scheduler fills up to. Zero fields are replaced by defaults from the machine.
+struct ResourceBudget {
+    double cores = 0.0;
+    int64_t memoryBytes = 0;
+};
+
+struct ResourceUsage {
+    double cores = 0.0;         // CPU budget tokens leased by the running jobs
+    int64_t memoryBytes = 0;
+    int runningJobs = 0;
+};
+
+class JobCostEstimator {
+public:
+    // Looks up the input's resolution, frame rate and bit depth in MediaProbe (usually
+    // without opening the file) and models decoder threads, pipeline queues and encoder
+    // lookahead. Remuxes (source already in the target codec) cost almost nothing. The
+    // encoder is costed as the one VideoEncoder::open() would pick for this input.
+    static JobCost estimate(const std::string& inputPath, const std::string& encoderName);
+
+    // Scales the thread counts down proportionally (at least one each) so that they fit in
+    // `threads` CPU budget tokens.
+    static void fitToThreads(JobCost& cost, int threads);
+
+    // All cores and 75% of physical memory, leaving room for the OS and the UI.
+    static ResourceBudget defaultBudget();
+    static int64_t physicalMemoryBytes();
+};
@@ -1,10 +1,19 @@
 #include "job_system.h"
+#include "cpu_budget.h"
 #include <iostream>
 #include <filesystem>
-#include <windows.h> // For MultiByteToWideChar
+#include <algorithm>
+#include <cmath>
 
 namespace fs = std::filesystem;
 
+// A followed input that hasn't grown for this long is taken as finished.
+static const std::chrono::milliseconds kGrowingIdleTimeout(10000);
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h> // For MultiByteToWideChar
+
 // Helper to convert UTF-8 to Wide String (Duplicated from main.cpp, ideally should be in a common header)
 static std::wstring Utf8ToWide(const std::string& str) {
     if (str.empty()) return std::wstring();
@@ -26,6 +35,19 @@ static fs::path Utf8ToPath(const std::string& str) {
     return fs::path(Utf8ToWide(str));
 }
 
+static std::string PathToUtf8(const fs::path& path) {
+    return WideToUtf8(path.wstring());
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+
+static std::string PathToUtf8(const fs::path& path) {
+    return path.string();
+}
+#endif
+
 static std::string findAvailablePath(const std::string& basePath) {
     fs::path p = Utf8ToPath(basePath);
     if (!fs::exists(p)) {
@@ -33,20 +55,36 @@ static std::string findAvailablePath(const std::string& basePath) {
     }
 
     fs::path dir = p.parent_path();
-    std::string stem = WideToUtf8(p.stem().wstring());
-    std::string ext = WideToUtf8(p.extension().wstring());
+    std::string stem = PathToUtf8(p.stem());
+    std::string ext = PathToUtf8(p.extension());
 
     for (int counter = 1; counter <= 999; counter++) {
         fs::path newPath = dir / Utf8ToPath(stem + "_" + std::to_string(counter) + ext);
         if (!fs::exists(newPath)) {
-            return WideToUtf8(newPath.wstring());
+            return PathToUtf8(newPath);
         }
     }
 
     return basePath;
 }
 
+static void removeOutput(const std::string& outputPath) {
+    try {
+        fs::path outPath = Utf8ToPath(outputPath);
+        if (fs::exists(outPath)) {
+            fs::remove(outPath);
+            std::cout << "Cleaned up output file: " << outputPath << std::endl;
+        }
+    } catch (const fs::filesystem_error& e) {
+        std::cerr << "Warning: Could not delete output file: " << e.what() << std::endl;
+    }
+}
+
 JobManager::JobManager(int maxConcurrent) : maxConcurrentJobs(maxConcurrent) {
+    budget = JobCostEstimator::defaultBudget();
+    if (maxConcurrentJobs <= 0) {
+        maxConcurrentJobs = std::max(1, (int)budget.cores);
+    }
     start();
 }
 
@@ -61,12 +99,24 @@ void JobManager::start() {
     for (int i = 0; i < maxConcurrentJobs; ++i) {
         workers.emplace_back(&JobManager::workerLoop, this);
     }
+    probeThread = std::thread(&JobManager::probeLoop, this);
 }
 
 void JobManager::stop() {
+    stopWatching();
     if (!running) return;
+    shuttingDown = true;
     running = false;
     cv.notify_all();
+    probeCv.notify_all();
+
+    // Running transcodes notice the cancel within a frame, so the joins below are bounded.
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (const auto& job : jobs) {
+            if (job->status == JobStatus::Running) job->control.cancel();
+        }
+    }
     
     for (auto& worker : workers) {
         if (worker.joinable()) {
@@ -74,35 +124,377 @@ void JobManager::stop() {
         }
     }
     workers.clear();
+    if (probeThread.joinable()) {
+        probeThread.join();
+    }
+    shuttingDown = false;
 }
 
 void JobManager::addJob(const std::string& inputPath, const std::string& outputPath, const std::string& encoder) {
-    auto job = std::make_shared<TranscodeJob>(nextJobId++, inputPath, outputPath, encoder);
+    std::shared_ptr<TranscodeJob> job;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        job = std::make_shared<TranscodeJob>(nextJobId++, inputPath, outputPath, encoder);
+    }
+    journal.jobAdded(job->id, inputPath, outputPath, encoder);
     
     {
         std::lock_guard<std::mutex> lock(queueMutex);
         jobs.push_back(job);
-        pendingQueue.push(job);
+        pendingQueue.push_back(job);
     }
     
-    cv.notify_one();
+    probeCv.notify_one();
+}
+
+std::vector<std::shared_ptr<TranscodeJob>> JobManager::getJobs() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return jobs;
+}
+
+bool JobManager::watchFolder(const std::string& folder, const std::string& outputFolder,
+                             const std::string& encoder, bool recursive) {
+    stopWatching();
+    watchOutputFolder = outputFolder;
+    watchEncoder = encoder;
+
+    FolderWatcher::Options options;
+    options.recursive = recursive;
+    options.extensions = {".mp4", ".mkv", ".mov", ".avi", ".ts", ".m2ts", ".mts", ".webm", ".wmv", ".flv"};
+    if (followGrowingInputs) {
+        options.growingExtensions = {".ts", ".m2ts", ".mts", ".mkv", ".flv"};
+    }
+    return watcher.start(folder, options, [this](const std::string& path, bool replaces) {
+        addWatchedFile(path, replaces);
+    });
+}
+
+void JobManager::stopWatching() {
+    watcher.stop();
+}
+
+void JobManager::addWatchedFile(const std::string& inputPath, bool replaces) {
+    fs::path p = Utf8ToPath(inputPath);
+    std::string stem = PathToUtf8(p.stem());
+    // An output left from an earlier session, found again when the watch restarts.
+    if (stem.size() >= 5 && stem.compare(stem.size() - 5, 5, "_h265") == 0) return;
+
+    fs::path outDir = watchOutputFolder.empty() ? p.parent_path() : Utf8ToPath(watchOutputFolder);
+    std::string outputPath = PathToUtf8(outDir / Utf8ToPath(stem + "_h265" + PathToUtf8(p.extension())));
+
+    int stale = 0;
+    std::string staleOutput;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (const auto& job : jobs) {
+            if (job->outputPath == inputPath) return;   // One of ours, just written
+            if (job->inputPath != inputPath) continue;
+            if (job->status == JobStatus::Pending || job->status == JobStatus::Running) {
+                if (!replaces) return;
+                stale = job->id;
+            } else if (replaces && job->status == JobStatus::Completed) {
+                staleOutput = job->outputPath;
+            }
+        }
+    }
+    if (stale != 0 || !staleOutput.empty()) {
+        // Queued before its writer was done, so the job read (or is reading) a truncated input.
+        std::cout << "Input changed after it was queued, redoing: " << inputPath << std::endl;
+        if (stale != 0) cancelJob(stale);
+        if (!staleOutput.empty()) removeOutput(staleOutput);
+    } else {
+        std::error_code ec;
+        if (fs::exists(Utf8ToPath(outputPath), ec)) return;
+    }
+
+    addJob(inputPath, outputPath, watchEncoder);
+}
+
+void JobManager::setJournalPath(const std::string& path) {
+    std::vector<JobJournal::Entry> unfinished = journal.open(path);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (const auto& entry : unfinished) {
+            auto job = std::make_shared<TranscodeJob>(entry.id, entry.inputPath, entry.outputPath, entry.encoder);
+            job->resumed = entry.started;
+            job->resume = entry.resume;
+            job->statusMessage = entry.resume.completed.empty() ? "Pending (Restored)" : "Pending (Resume)";
+            nextJobId = std::max(nextJobId, entry.id + 1);
+            jobs.push_back(job);
+            pendingQueue.push_back(job);
+        }
+    }
+    if (!unfinished.empty()) {
+        std::cout << "Restored " << unfinished.size() << " unfinished job(s) from " << path << std::endl;
+        probeCv.notify_one();
+    }
+}
+
+void JobManager::setDecoderOptions(const VideoDecoder::Options& options) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    decoderOptions = options;
+}
+
+VideoDecoder::Options JobManager::getDecoderOptions() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return decoderOptions;
+}
+
+TranscodeMetrics::Snapshot JobManager::aggregateMetrics() {
+    TranscodeMetrics::Snapshot total;
+    bool first = true;
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (const auto& job : jobs) {
+        if (job->status != JobStatus::Running) continue;
+        TranscodeMetrics::Snapshot snap = job->metrics.snapshot();
+        if (first) {
+            total = snap;
+            first = false;
+        } else {
+            total.add(snap);
+        }
+    }
+    return total;
 }
 
 void JobManager::setPaused(bool p) {
-    paused = p;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        paused = p;
+        for (const auto& job : jobs) {
+            if (job->status != JobStatus::Running) continue;
+            if (p) {
+                job->control.pause();
+            } else {
+                job->control.resume();
+            }
+        }
+    }
     if (!paused) {
         cv.notify_all();
     }
 }
 
+void JobManager::cancelJob(int jobId) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (const auto& job : jobs) {
+        if (job->id != jobId) continue;
+        if (job->status == JobStatus::Pending) {
+            // Still queued: the worker skips it when it comes up.
+            job->status = JobStatus::Cancelled;
+            job->statusMessage = "Cancelled";
+            journal.jobFinished(job->id, "cancelled");
+            if (job->resumed) {
+                // Leftovers of the interrupted session this job was restored from.
+                ChunkedTranscoder::removeChunkFiles(job->outputPath, (int)job->resume.boundaries.size() + 1);
+                removeOutput(job->outputPath);
+            }
+        } else if (job->status == JobStatus::Running) {
+            job->control.cancel();
+            job->statusMessage = "Cancelling...";
+        }
+    }
+}
+
+void JobManager::setJobTimeLimit(std::chrono::seconds limit) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    jobTimeLimit = limit;
+}
+
+void JobManager::setResourceBudget(const ResourceBudget& newBudget) {
+    ResourceBudget defaults = JobCostEstimator::defaultBudget();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        budget.cores = newBudget.cores > 0.0 ? newBudget.cores : defaults.cores;
+        budget.memoryBytes = newBudget.memoryBytes > 0 ? newBudget.memoryBytes : defaults.memoryBytes;
+        // Codec thread pools are sized from the same number of cores.
+        CpuBudget::shared().setTotal((int)std::ceil(budget.cores));
+    }
+    cv.notify_all();
+}
+
+ResourceBudget JobManager::getResourceBudget() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return budget;
+}
+
+ResourceUsage JobManager::getResourceUsage() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return usage;
+}
+
+bool JobManager::tryAdmit(const TranscodeJob& job, CpuBudget::Lease& lease) {
+    // A job bigger than the whole budget still runs, just on its own.
+    if (usage.runningJobs > 0 && usage.memoryBytes + job.admittedMemoryBytes > budget.memoryBytes) {
+        return false;
+    }
+    // CPU is admitted in the unit the codec thread pools are sized in: the job gets all the
+    // tokens its threads want (or the whole budget, if it wants more) or waits.
+    int tokens = job.cost.threadTokens();
+    lease = CpuBudget::shared().tryAcquire(tokens, tokens);
+    return lease.tokens() > 0;
+}
+
+bool JobManager::splitsIntoChunks(const JobCost& cost, bool resumePlan) const {
+    // Hardware encoders and remuxes run a single chunk worker, and inputs too short to
+    // split (with no plan to resume) a single Transcoder.
+    bool chunked = journal.isOpen() || chunkedEncoding;
+    bool splits = cost.durationSeconds >= 2 * ChunkedTranscoder::Options().minChunkSeconds || resumePlan;
+    return chunked && splits && !cost.remux && cost.softwareEncoder();
+}
+
+std::string JobManager::historyEncoder(const JobCost& cost, bool chunked) {
+    if (cost.remux) return "copy";
+    return chunked ? cost.encoderName + "/chunked" : cost.encoderName;
+}
+
+int64_t JobManager::admissionMemory(const TranscodeJob& job) const {
+    if (!splitsIntoChunks(job.cost, !job.resume.boundaries.empty())) {
+        return job.cost.memoryBytes;
+    }
+    // The lease the job gets later never exceeds its estimated thread tokens, so this is the most
+    // workers it can start.
+    int workers = std::max(1, job.cost.threadTokens() / (ChunkedTranscoder::Options().threadsPerChunk + 1));
+    return job.cost.memoryBytes * workers;
+}
+
+int JobManager::chunkWorkers(const TranscodeJob& job, const JobCost& threads) {
+    // Each chunk worker decodes on its own thread and encodes on threadsPerChunk more.
+    int workers = std::max(1, threads.threadTokens() / (ChunkedTranscoder::Options().threadsPerChunk + 1));
+    if (job.cost.memoryBytes > 0) {
+        workers = std::min<int64_t>(workers, std::max<int64_t>(1, job.admittedMemoryBytes / job.cost.memoryBytes));
+    }
+    return workers;
+}
+
+std::string JobManager::folderOf(const std::string& path) {
+    return PathToUtf8(Utf8ToPath(path).parent_path());
+}
+
+void JobManager::setQueuePolicy(QueuePolicy policy) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queuePolicy = policy;
+    }
+    cv.notify_all();
+}
+
+JobManager::QueuePolicy JobManager::getQueuePolicy() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return queuePolicy;
+}
+
+void JobManager::setJobPriority(int jobId, int priority) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (const auto& job : jobs) {
+        if (job->id == jobId) job->priority = priority;
+    }
+}
+
+void JobManager::setHistoryPath(const std::string& path) {
+    history.load(path);
+}
+
+int JobManager::selectNextJob() const {
+    int best = -1;
+    for (int i = 0; i < (int)pendingQueue.size(); i++) {
+        const auto& job = pendingQueue[i];
+        if (!job->costReady && job->status != JobStatus::Cancelled) continue;
+        // Cancelled entries are picked first so the worker can discard them.
+        if (job->status == JobStatus::Cancelled) return i;
+        if (best < 0) {
+            best = i;
+            if (queuePolicy == QueuePolicy::Fifo) break;
+            continue;
+        }
+
+        const auto& current = pendingQueue[best];
+        bool better = false;
+        switch (queuePolicy) {
+        case QueuePolicy::Fifo:
+            break;
+        case QueuePolicy::Priority:
+            better = job->priority > current->priority;
+            break;
+        case QueuePolicy::ShortestFirst:
+            // Unknown durations go last.
+            if (job->expectedSeconds >= 0.0) {
+                better = current->expectedSeconds < 0.0 || job->expectedSeconds < current->expectedSeconds;
+            }
+            break;
+        case QueuePolicy::FairShare: {
+            // Fewest running jobs from the same folder first, then fewest started overall.
+            auto load = [this](const std::string& folder) {
+                auto running = runningPerFolder.find(folder);
+                auto started = startedPerFolder.find(folder);
+                return std::make_pair(running != runningPerFolder.end() ? running->second : 0,
+                                      started != startedPerFolder.end() ? started->second : 0);
+            };
+            better = load(folderOf(job->inputPath)) < load(folderOf(current->inputPath));
+            break;
+        }
+        }
+        if (better) best = i;
+    }
+    return best;
+}
+
+void JobManager::probeLoop() {
+    while (running) {
+        std::shared_ptr<TranscodeJob> job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            auto findUnprobed = [this]() -> std::shared_ptr<TranscodeJob> {
+                for (const auto& pending : pendingQueue) {
+                    if (!pending->costReady && pending->status == JobStatus::Pending) return pending;
+                }
+                return nullptr;
+            };
+            probeCv.wait(lock, [&] { return !running || findUnprobed(); });
+            if (!running) break;
+            job = findUnprobed();
+        }
+
+        // Opening the file can take a while on network drives; do it without the lock.
+        JobCost cost = JobCostEstimator::estimate(job->inputPath, job->encoder);
+        double expected = -1.0;
+        if (cost.probed && cost.durationSeconds > 0.0) {
+            bool chunked = splitsIntoChunks(cost, !job->resume.boundaries.empty());
+            double fps = history.expectedFps(cost.codecName, cost.width, cost.height, historyEncoder(cost, chunked));
+            expected = cost.durationSeconds * cost.frameRate / fps;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            job->cost = cost;
+            job->expectedSeconds = expected;
+            job->costReady = true;
+        }
+        cv.notify_all();
+    }
+}
+
+void JobManager::recordThroughput(const TranscodeJob& job, bool chunked) {
+    const JobCost& cost = job.cost;
+    TranscodeMetrics::Snapshot snap = job.metrics.snapshot();
+    // Very short runs are dominated by open/close overhead.
+    if (!cost.probed || cost.durationSeconds <= 0.0 || snap.elapsedSeconds < 1.0) return;
+
+    double fps = cost.durationSeconds * cost.frameRate / snap.elapsedSeconds;
+    history.record(cost.codecName, cost.height, historyEncoder(cost, chunked), fps);
+}
+
 void JobManager::workerLoop() {
     while (running) {
         std::shared_ptr<TranscodeJob> job;
+        std::string folder;
+        // Held for the whole job; the codec thread pools are sized to it.
+        CpuBudget::Lease lease;
         
         {
             std::unique_lock<std::mutex> lock(queueMutex);
             cv.wait(lock, [this] { 
-                return (!pendingQueue.empty() && !paused) || !running; 
+                return (!paused && !admissionPending && selectNextJob() >= 0) || !running; 
             });
             
             if (!running) break;
@@ -110,86 +502,247 @@ void JobManager::workerLoop() {
             // If paused, continue waiting (unless stopped)
             if (paused) continue;
             
-            if (!pendingQueue.empty()) {
-                job = pendingQueue.front();
-                pendingQueue.pop();
+            int index = selectNextJob();
+            job = pendingQueue[index];
+            pendingQueue.erase(pendingQueue.begin() + index);
+            if (job->status == JobStatus::Cancelled) continue;
+            admissionPending = true;
+
+            job->admittedMemoryBytes = admissionMemory(*job);
+            cv.wait(lock, [&] { return !running || tryAdmit(*job, lease); });
+            admissionPending = false;
+            if (!running) {
+                lease.release();
+                pendingQueue.push_front(job);
+                break;
             }
+            usage.cores += lease.tokens();
+            usage.memoryBytes += job->admittedMemoryBytes;
+            usage.runningJobs++;
+            folder = folderOf(job->inputPath);
+            runningPerFolder[folder]++;
+            startedPerFolder[folder]++;
         }
-        
-        if (job) {
-            activeJobs++;
-            processJob(job);
-            activeJobs--;
+        // Let the next worker pick the following job.
+        cv.notify_all();
+
+        activeJobs++;
+        processJob(job, lease.tokens());
+        activeJobs--;
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            usage.cores -= lease.tokens();
+            lease.release();
+            usage.memoryBytes -= job->admittedMemoryBytes;
+            usage.runningJobs--;
+            if (--runningPerFolder[folder] == 0) runningPerFolder.erase(folder);
         }
+        // Freed budget may admit the waiting job.
+        cv.notify_all();
     }
 }
 
-void JobManager::processJob(std::shared_ptr<TranscodeJob> job) {
-    if (Transcoder::isHevc(job->inputPath)) {
-        job->status = JobStatus::Skipped;
-        job->statusMessage = "Skipped (Already H.265)";
-        job->progress = 1.0f;
-        return;
+bool JobManager::runResumable(TranscodeJob& job, const JobCost& threads, const VideoDecoder::Options& decoderOptions,
+                              int& chunkCount) {
+    ChunkedTranscoder::Options chunkOptions;
+    if (job.cost.softwareEncoder()) {
+        chunkOptions.workers = chunkWorkers(job, threads);
+    } else {
+        // A hardware encoder gains nothing from parallel chunks; one worker keeps the
+        // session count down and lets the chunk decoder use the hardware too.
+        chunkOptions.workers = 1;
+        chunkOptions.threadsPerChunk = std::max(1, threads.encoderThreads);
+        chunkOptions.allowHardwareDecode = true;
     }
+    // Chunks of about minChunkSeconds bound the work an interruption can cost.
+    double workerSeconds = chunkOptions.workers * chunkOptions.minChunkSeconds;
+    chunkOptions.chunksPerWorker = std::max(chunkOptions.chunksPerWorker,
+                                            (int)std::ceil(job.cost.durationSeconds / workerSeconds));
+
+    chunkOptions.encoderThreads = threads.encoderThreads;
+    chunkOptions.conversionThreads = threads.conversionThreads;
+    chunkOptions.mappedInput = mappedInput;
+    chunkOptions.outputLayout = outputLayout;
 
-    job->outputPath = findAvailablePath(job->outputPath);
+    ChunkedTranscoder chunkedTranscoder;
+    chunkedTranscoder.setOptions(chunkOptions);
+    chunkedTranscoder.setMetrics(&job.metrics);
+    chunkedTranscoder.setControl(&job.control);
+    chunkedTranscoder.setResumePoint(job.resume);
+    int jobId = job.id;
+    chunkedTranscoder.setPlanCallback([this, jobId](const ChunkedTranscoder::ResumePoint& plan) {
+        journal.planRecorded(jobId, plan);
+    });
+    chunkedTranscoder.setChunkCallback([this, jobId](const ChunkedTranscoder::ChunkRecord& chunk) {
+        journal.chunkCompleted(jobId, chunk);
+    });
 
-    job->status = JobStatus::Running;
-    job->statusMessage = "Transcoding...";
+    bool success = chunkedTranscoder.run(job.inputPath, job.outputPath, job.encoder, decoderOptions);
+    chunkCount = chunkedTranscoder.chunkCount();
+    if (success) {
+        job.statusMessage = chunkedTranscoder.wasRemuxed() ? "Completed (Remux)"
+                          : chunkedTranscoder.wasResumed() ? "Completed (Resumed)"
+                          : chunkCount > 1 ? "Completed (Chunked)" : "Completed";
+        // A resumed run only encoded part of the file in the time it took.
+        if (!chunkedTranscoder.wasResumed()) recordThroughput(job, chunkCount > 1);
+    }
+    return success;
+}
+
+void JobManager::processJob(std::shared_ptr<TranscodeJob> job, int threadTokens) {
+    // A restored job keeps the output name it had; its finished chunks are named after it.
+    if (!job->resumed) {
+        job->outputPath = findAvailablePath(job->outputPath);
+    }
+
+    // A recording still being written can't be split or resumed by chunks: it is followed
+    // by a single transcode that ends when the writer does.
+    bool growing = followGrowingInputs && Demuxer::isGrowing(job->inputPath, kGrowingIdleTimeout);
+
+    {
+        // Under the lock so a concurrent setPaused() either sees this job or we see its flag.
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (job->status == JobStatus::Cancelled) return;
+        job->status = JobStatus::Running;
+        job->statusMessage = growing ? "Transcoding (live)..." : "Transcoding...";
+        if (paused) job->control.pause();
+        // stop() only cancels jobs already Running; one that got here after it looked must
+        // cancel itself or stop() would wait for a whole transcode.
+        if (shuttingDown || !running) job->control.cancel();
+        if (jobTimeLimit.count() > 0) {
+            job->control.setDeadline(TranscodeControl::Clock::now() + jobTimeLimit);
+        }
+    }
+    journal.jobStarted(job->id, job->outputPath);
+
+    // Codec and conversion thread pools are sized from the job's lease on the process-wide
+    // CPU budget, so concurrent jobs don't oversubscribe the cores.
+    JobCost threads = job->cost;
+    JobCostEstimator::fitToThreads(threads, threadTokens);
 
     bool success = false;
+    bool remuxed = false;
+    bool decoderFallback = false;
+    VideoDecoder::Options jobDecoderOptions = getDecoderOptions();
+    if (jobDecoderOptions.threadCount == 0) {
+        jobDecoderOptions.threadCount = threads.decoderThreads;
+    }
+
+    int chunkCount = 0;
+    auto finishCancelled = [&]() {
+        job->status = JobStatus::Cancelled;
+        if (shuttingDown && journal.isOpen()) {
+            // Stopped by shutdown rather than the user: the next session picks it up again.
+            job->statusMessage = "Interrupted";
+            return;
+        }
+        job->statusMessage = "Cancelled";
+        journal.jobFinished(job->id, "cancelled");
+        ChunkedTranscoder::removeChunkFiles(job->outputPath, chunkCount);
+        removeOutput(job->outputPath);
+    };
+
+    if (journal.isOpen() && !growing) {
+        if (runResumable(*job, threads, jobDecoderOptions, chunkCount)) {
+            job->status = JobStatus::Completed;
+            job->progress = 1.0f;
+            journal.jobFinished(job->id, "done");
+            return;
+        }
+        if (job->control.isCancelled()) {
+            finishCancelled();
+            return;
+        }
+        std::cout << "Resumable encoding failed for " << job->inputPath << ", retrying as a single transcode..." << std::endl;
+        job->progress = 0.0f;
+    } else if (chunkedEncoding && !growing && job->cost.softwareEncoder()) {
+        ChunkedTranscoder::Options chunkOptions;
+        chunkOptions.workers = chunkWorkers(*job, threads);
+
+        chunkOptions.encoderThreads = threads.encoderThreads;
+        chunkOptions.conversionThreads = threads.conversionThreads;
+        chunkOptions.mappedInput = mappedInput;
+        chunkOptions.outputLayout = outputLayout;
+
+        ChunkedTranscoder chunkedTranscoder;
+        chunkedTranscoder.setOptions(chunkOptions);
+        chunkedTranscoder.setMetrics(&job->metrics);
+        chunkedTranscoder.setControl(&job->control);
+
+        if (chunkedTranscoder.run(job->inputPath, job->outputPath, job->encoder, jobDecoderOptions)) {
+            job->status = JobStatus::Completed;
+            job->statusMessage = chunkedTranscoder.wasRemuxed() ? "Completed (Remux)"
+                               : chunkedTranscoder.chunkCount() > 1 ? "Completed (Chunked)" : "Completed";
+            job->progress = 1.0f;
+            recordThroughput(*job, chunkedTranscoder.chunkCount() > 1);
+            return;
+        }
+        if (job->control.isCancelled()) {
+            finishCancelled();
+            return;
+        }
+        std::cout << "Chunked encoding failed for " << job->inputPath << ", retrying as a single transcode..." << std::endl;
+        job->progress = 0.0f;
+    }
 
     {
         Transcoder transcoder;
-        transcoder.setProgressCallback([job](float progress) {
-            job->progress = progress;
-        });
-
-        transcoder.setPauseCallback([this]() {
-            return paused.load();
-        });
+        transcoder.setMetrics(&job->metrics);
+        transcoder.setControl(&job->control);
+        transcoder.setEncoderThreads(threads.encoderThreads);
+        transcoder.setConversionThreads(threads.conversionThreads);
+        transcoder.setTailInput(growing, kGrowingIdleTimeout);
+        transcoder.setMappedInput(mappedInput);
+        transcoder.setOutputLayout(outputLayout);
 
-        success = transcoder.run(job->inputPath, job->outputPath, job->encoder, true);
+        success = transcoder.run(job->inputPath, job->outputPath, job->encoder, true, jobDecoderOptions);
+        remuxed = transcoder.wasRemuxed();
+        decoderFallback = transcoder.usedDecoderFallback();
     }
 
     if (success) {
         job->status = JobStatus::Completed;
-        job->statusMessage = "Completed";
+        job->statusMessage = remuxed ? "Completed (Remux)" : decoderFallback ? "Completed (Software fallback)" : "Completed";
         job->progress = 1.0f;
+        // A followed recording's probed duration is only what existed when it was queued.
+        if (!growing) recordThroughput(*job, false);
+        journal.jobFinished(job->id, "done");
+    } else if (job->control.isCancelled()) {
+        finishCancelled();
     } else {
-        std::cout << "Hardware decoding failed for " << job->inputPath << ", retrying with software decoder..." << std::endl;
+        // Decoder failures are normally recovered in place; this is for the rest (e.g. a
+        // failure inside a GOP too long to replay).
+        std::cout << "Transcode failed for " << job->inputPath << ", retrying with software decoder..." << std::endl;
         job->statusMessage = "Retrying (Software)...";
         job->progress = 0.0f;
 
         {
             Transcoder softwareTranscoder;
-            softwareTranscoder.setProgressCallback([job](float progress) {
-                job->progress = progress;
-            });
-
-            softwareTranscoder.setPauseCallback([this]() {
-                return paused.load();
-            });
+            softwareTranscoder.setMetrics(&job->metrics);
+            softwareTranscoder.setControl(&job->control);
+            softwareTranscoder.setEncoderThreads(threads.encoderThreads);
+            softwareTranscoder.setConversionThreads(threads.conversionThreads);
+            softwareTranscoder.setTailInput(growing, kGrowingIdleTimeout);
+            softwareTranscoder.setMappedInput(mappedInput);
+            softwareTranscoder.setOutputLayout(outputLayout);
 
-            success = softwareTranscoder.run(job->inputPath, job->outputPath, job->encoder, false);
+            success = softwareTranscoder.run(job->inputPath, job->outputPath, job->encoder, false, jobDecoderOptions);
         }
 
         if (success) {
             job->status = JobStatus::Completed;
             job->statusMessage = "Completed (Software)";
             job->progress = 1.0f;
+            // Not recorded: the time includes the failed first attempt and a slower software decode.
+            journal.jobFinished(job->id, "done");
+        } else if (job->control.isCancelled()) {
+            finishCancelled();
         } else {
             job->status = JobStatus::Failed;
             job->statusMessage = "Failed";
-            try {
-                fs::path outPath = Utf8ToPath(job->outputPath);
-                if (fs::exists(outPath)) {
-                    fs::remove(outPath);
-                    std::cout << "Cleaned up failed output file: " << job->outputPath << std::endl;
-                }
-            } catch (const fs::filesystem_error& e) {
-                std::cerr << "Warning: Could not delete failed output file: " << e.what() << std::endl;
-            }
+            journal.jobFinished(job->id, "failed");
+            removeOutput(job->outputPath);
         }
     }
 }
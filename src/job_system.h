@@ -2,21 +2,30 @@
 
 #include <string>
 #include <vector>
-#include <queue>
+#include <deque>
+#include <map>
 #include <memory>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <chrono>
 #include "transcoder.h"
+#include "chunked_transcoder.h"
+#include "job_resources.h"
+#include "cpu_budget.h"
+#include "throughput_history.h"
+#include "job_journal.h"
+#include "folder_watcher.h"
 
 enum class JobStatus {
     Pending,
     Running,
     Completed,
     Failed,
-    Skipped
+    Skipped,
+    Cancelled
 };
 
 struct TranscodeJob {
@@ -27,6 +36,21 @@ struct TranscodeJob {
     std::atomic<float> progress{0.0f};
     std::atomic<JobStatus> status{JobStatus::Pending};
     std::string statusMessage = "Pending";
+    // Filled in by whichever transcoder is running the job; sample with metrics.snapshot().
+    TranscodeMetrics metrics;
+    // Pause/cancel token for this job, driven by JobManager.
+    TranscodeControl control;
+    // Filled in by the probe thread shortly after the job is added; the job isn't
+    // scheduled until then. Both are guarded by JobManager's queue mutex.
+    JobCost cost;
+    bool costReady = false;
+    double expectedSeconds = -1.0;   // From the throughput history, -1 if unknown
+    int priority = 0;                // Higher runs first under QueuePolicy::Priority
+    // Restored from the journal: the output path is already decided and finished chunks are reused.
+    bool resumed = false;
+    ChunkedTranscoder::ResumePoint resume;
+    // Memory charged against the budget while the job runs; see JobManager::admissionMemory().
+    int64_t admittedMemoryBytes = 0;
     
     TranscodeJob(int id, std::string in, std::string out, std::string enc) 
         : id(id), inputPath(in), outputPath(out), encoder(enc) {}
@@ -34,31 +58,148 @@ struct TranscodeJob {
 
 class JobManager {
 public:
-    JobManager(int maxConcurrent = 3);
+    // Order in which pending jobs are started. ShortestFirst minimizes mean time to
+    // completion over a batch; FairShare alternates between input folders.
+    enum class QueuePolicy { Fifo, Priority, ShortestFirst, FairShare };
+
+    // Jobs are admitted while their estimated cost fits the resource budget. maxConcurrent
+    // is only an upper bound on the number of simultaneous jobs (0 = one per core).
+    JobManager(int maxConcurrent = 0);
     ~JobManager();
 
     void addJob(const std::string& inputPath, const std::string& outputPath, const std::string& encoder = "auto");
     void start();
     void stop();
     
+    // Pausing also suspends running jobs within a frame, not just the queue.
     void setPaused(bool paused);
     bool isPaused() const { return paused; }
 
-    const std::vector<std::shared_ptr<TranscodeJob>>& getJobs() const { return jobs; }
+    // Pending jobs are dropped; running ones stop within a frame and their output is removed.
+    void cancelJob(int jobId);
+    // Running jobs are cancelled once they exceed this; zero disables the limit.
+    void setJobTimeLimit(std::chrono::seconds limit);
+
+    // Decoder threading applied to jobs started after the call. With threadCount = 0 (the
+    // default) each job gets the decoder thread count from its cost estimate.
+    void setDecoderOptions(const VideoDecoder::Options& options);
+    VideoDecoder::Options getDecoderOptions();
+
+    // Long files with a software encoder are split into GOP-aligned chunks and encoded in parallel.
+    void setChunkedEncoding(bool enabled) { chunkedEncoding = enabled; }
+    bool isChunkedEncoding() const { return chunkedEncoding; }
+
+    // Inputs modified within the last few seconds are taken as recordings still being
+    // written and followed to their end (Demuxer::setTailMode) by a single transcode, never
+    // chunked or journaled. Watched folders then also queue streamable files (TS, MKV, FLV)
+    // as soon as they appear instead of when complete. Set before watchFolder().
+    void setFollowGrowingInputs(bool enabled) { followGrowingInputs = enabled; }
+    bool isFollowingGrowingInputs() const { return followGrowingInputs; }
+
+    // Transcodes, chunked or not, and remuxes read their input through a memory mapping
+    // (Demuxer::setMemoryMapped). Inputs followed while growing keep normal reads.
+    void setMappedInput(bool enabled) { mappedInput = enabled; }
+    bool isMappedInput() const { return mappedInput; }
+
+    // Index placement of MP4/Matroska outputs (see Muxer::Layout); the default writes each
+    // output once, with a reserved or fragmented index.
+    void setOutputLayout(Muxer::Layout layout) { outputLayout = layout; }
+    Muxer::Layout getOutputLayout() const { return outputLayout; }
+
+    void setQueuePolicy(QueuePolicy policy);
+    QueuePolicy getQueuePolicy();
+    void setJobPriority(int jobId, int priority);
+
+    // Measured throughput of finished jobs is stored here and used for expected durations.
+    void setHistoryPath(const std::string& path);
+
+    // Records jobs and their completed chunks in a crash-safe journal, and re-queues the
+    // jobs an earlier session didn't finish. Call before adding jobs. While a journal is
+    // open, transcodes are written as keyframe-aligned chunks so an interrupted job
+    // continues from its last complete chunk instead of starting over.
+    void setJournalPath(const std::string& path);
+
+    // Changes apply to the next admission; running jobs keep what they were given.
+    void setResourceBudget(const ResourceBudget& budget);
+    ResourceBudget getResourceBudget();
+    ResourceUsage getResourceUsage();
+
+    // Queues each file as soon as it has finished arriving in `folder` (see FolderWatcher),
+    // named like "Add Files": <stem>_h265<ext> in outputFolder, or next to the input when
+    // it's empty. Inputs whose output already exists are taken as done, and the outputs of
+    // queued jobs are never picked up, so the output folder may be the watched one.
+    bool watchFolder(const std::string& folder, const std::string& outputFolder,
+                     const std::string& encoder = "auto", bool recursive = false);
+    void stopWatching();
+    bool isWatching() const { return watcher.isRunning(); }
+    const std::string& watchedFolder() const { return watcher.folder(); }
+
+    // A copy, since the folder watcher may add jobs from its own thread.
+    std::vector<std::shared_ptr<TranscodeJob>> getJobs();
+
+    // Combined metrics of the jobs currently running.
+    TranscodeMetrics::Snapshot aggregateMetrics();
 
 private:
     void workerLoop();
-    void processJob(std::shared_ptr<TranscodeJob> job);
+    void probeLoop();
+    // threadTokens: the CPU budget lease the job was admitted with.
+    void processJob(std::shared_ptr<TranscodeJob> job, int threadTokens);
+    // Leases the job's thread tokens from CpuBudget if they and its memory fit. Needs queueMutex.
+    bool tryAdmit(const TranscodeJob& job, CpuBudget::Lease& lease);
+    // A chunked run keeps a decoder and an encoder per worker, so it is charged the job's
+    // memory once per worker it may start; inputs it won't split and other jobs pay the
+    // single pipeline's estimate.
+    int64_t admissionMemory(const TranscodeJob& job) const;
+    // Chunk workers for `threads`, capped so their memory stays within what the job was admitted with.
+    static int chunkWorkers(const TranscodeJob& job, const JobCost& threads);
+    // Index into pendingQueue of the job the policy picks, -1 if none is ready. Needs queueMutex.
+    int selectNextJob() const;
+    // Whether a job with this cost runs as a chunked transcode that actually splits.
+    bool splitsIntoChunks(const JobCost& cost, bool resumePlan) const;
+    // Throughput history key for the job's encoder: the resolved encoder, with chunked runs
+    // (several encoders at once) kept apart from single-pipeline ones, or "copy" for remuxes.
+    static std::string historyEncoder(const JobCost& cost, bool chunked);
+    // `chunked`: the run was encoded as several chunks.
+    void recordThroughput(const TranscodeJob& job, bool chunked);
+    // Runs the job as a chunked transcode that records each finished chunk in the journal.
+    bool runResumable(TranscodeJob& job, const JobCost& threads, const VideoDecoder::Options& decoderOptions,
+                      int& chunkCount);
+    static std::string folderOf(const std::string& path);
 
     int maxConcurrentJobs;
+    VideoDecoder::Options decoderOptions;
     std::vector<std::shared_ptr<TranscodeJob>> jobs;
-    std::queue<std::shared_ptr<TranscodeJob>> pendingQueue;
+    std::deque<std::shared_ptr<TranscodeJob>> pendingQueue;
+    ResourceBudget budget;
+    ResourceUsage usage;
+    // Set while a worker holds the head job waiting for room, so later jobs can't overtake it.
+    bool admissionPending = false;
+    QueuePolicy queuePolicy = QueuePolicy::Fifo;
+    std::map<std::string, int> runningPerFolder;
+    std::map<std::string, int> startedPerFolder;
+    ThroughputHistory history;
+    std::thread probeThread;
+    std::condition_variable probeCv;
     
     std::vector<std::thread> workers;
     std::mutex queueMutex;
     std::condition_variable cv;
     std::atomic<bool> running{false};
     std::atomic<bool> paused{true}; // Default to paused
+    std::atomic<bool> chunkedEncoding{false};
+    std::atomic<bool> followGrowingInputs{false};
+    std::atomic<bool> mappedInput{false};
+    std::atomic<Muxer::Layout> outputLayout{Muxer::Layout::Auto};
+    std::atomic<bool> shuttingDown{false};   // Running jobs are being cancelled by stop()
+    JobJournal journal;
+    std::chrono::seconds jobTimeLimit{0};
     std::atomic<int> activeJobs{0};
     int nextJobId = 1;
+    FolderWatcher watcher;
+    std::string watchOutputFolder;
+    std::string watchEncoder;
+
+    // `replaces`: the file changed after it was reported, so a queued or running job for it is redone.
+    void addWatchedFile(const std::string& inputPath, bool replaces);
 };
@@ -0,0 +1,63 @@
+#include "latency_histogram.h"
+#include <sstream>
+#include <iomanip>
+
+static int bucketFor(int64_t micros) {
+    int bucket = 0;
+    while (micros > 0 && bucket < LatencyHistogram::kBuckets - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void LatencyHistogram::record(int64_t micros) {
+    if (micros < 0) micros = 0;
+    buckets_[bucketFor(micros)]++;
+    count_++;
+    totalMicros_ += (uint64_t)micros;
+
+    int64_t prevMax = max_.load();
+    while (micros > prevMax && !max_.compare_exchange_weak(prevMax, micros)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) bucket = 0;
+    count_ = 0;
+    totalMicros_ = 0;
+    max_ = 0;
+}
+
+double LatencyHistogram::meanMicros() const {
+    uint64_t n = count_;
+    return n ? (double)totalMicros_ / (double)n : 0.0;
+}
+
+int64_t LatencyHistogram::percentileMicros(double percentile) const {
+    uint64_t n = count_;
+    if (n == 0) return 0;
+
+    uint64_t target = (uint64_t)(n * percentile / 100.0);
+    if (target >= n) target = n - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += buckets_[i];
+        if (seen > target) {
+            return i == 0 ? 0 : (int64_t)1 << i;
+        }
+    }
+    return max_;
+}
+
+std::string LatencyHistogram::summary() const {
+    std::ostringstream oss;
+    oss << "n=" << count() << std::fixed << std::setprecision(0)
+        << " mean=" << meanMicros() << "us"
+        << " p50<=" << percentileMicros(50) << "us"
+        << " p90<=" << percentileMicros(90) << "us"
+        << " p99<=" << percentileMicros(99) << "us"
+        << " max=" << maxMicros() << "us";
+    return oss.str();
+}
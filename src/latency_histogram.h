@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Lock-free latency histogram with power-of-two microsecond buckets
+// (bucket i counts samples in [2^(i-1), 2^i) us). Safe to record from any thread.
+class LatencyHistogram {
+public:
+    static const int kBuckets = 32;
+
+    void record(int64_t micros);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    double meanMicros() const;
+    int64_t maxMicros() const { return max_; }
+    // Upper bound of the bucket containing the given percentile (0-100).
+    int64_t percentileMicros(double percentile) const;
+
+    std::string summary() const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> totalMicros_{0};
+    std::atomic<int64_t> max_{0};
+};
@@ -2,6 +2,8 @@
 #include "transcoder.h"
 #include "video_player.h"
 #include "video_splitter.h"
+#include "media_probe.h"
+#include "cpu_budget.h"
 #include <iostream>
 #include <fstream>
 #include <stdio.h>
@@ -242,15 +244,21 @@ void ShowTranscodeUI(JobManager& jobManager, std::string& outputFolder, int& cur
     ImGui::SameLine();
     ImGui::Combo("##encoder", &currentEncoder, encoders, 5);
 
+    bool chunked = jobManager.isChunkedEncoding();
+    if (ImGui::Checkbox("Split long CPU encodes across cores", &chunked)) {
+        jobManager.setChunkedEncoding(chunked);
+    }
+
+    bool follow = jobManager.isFollowingGrowingInputs();
+    if (ImGui::Checkbox("Transcode recordings while they are written", &follow)) {
+        jobManager.setFollowGrowingInputs(follow);
+    }
+
     ImGui::Separator();
 
     if (ImGui::Button("Add Files")) {
         std::vector<std::string> files = OpenFileDialog(window);
         for (const auto& file : files) {
-            if (Transcoder::isHevc(file)) {
-                std::cout << "Skipping " << file << " as it is already HEVC." << std::endl;
-                continue;
-            }
             fs::path p = Utf8ToPath(file);
             std::string filename = WideToUtf8(p.filename().wstring());
             std::string stem = WideToUtf8(p.stem().wstring());
@@ -269,7 +277,20 @@ void ShowTranscodeUI(JobManager& jobManager, std::string& outputFolder, int& cur
             jobManager.addJob(file, uniqueOutPath, encoderIds[currentEncoder]);
         }
     }
-    
+
+    ImGui::SameLine();
+    if (jobManager.isWatching()) {
+        if (ImGui::Button("Stop Watching")) {
+            jobManager.stopWatching();
+        }
+    } else if (ImGui::Button("Watch Folder")) {
+        // New files are queued as soon as they finish copying in.
+        std::string folder = OpenFolderDialog(window);
+        if (!folder.empty()) {
+            jobManager.watchFolder(folder, outputFolder, encoderIds[currentEncoder]);
+        }
+    }
+
     ImGui::SameLine();
     
     // Start/Stop Buttons
@@ -286,18 +307,54 @@ void ShowTranscodeUI(JobManager& jobManager, std::string& outputFolder, int& cur
     
     ImGui::SameLine();
     ImGui::Text("Status: %s", isPaused ? "Paused" : "Running");
+    if (jobManager.isWatching()) {
+        ImGui::Text("Watching: %s", jobManager.watchedFolder().c_str());
+    }
+
+    ResourceBudget budget = jobManager.getResourceBudget();
+    ResourceUsage usage = jobManager.getResourceUsage();
+    ImGui::Text("Load: %d job(s), %.1f / %.0f cores, %.1f / %.1f GB, %d / %d codec threads", usage.runningJobs,
+                usage.cores, budget.cores,
+                usage.memoryBytes / (1024.0 * 1024.0 * 1024.0), budget.memoryBytes / (1024.0 * 1024.0 * 1024.0),
+                CpuBudget::shared().inUse(), CpuBudget::shared().total());
+
+    static const char* queuePolicies[] = {"First in, first out", "Priority", "Shortest first", "Fair share per folder"};
+    int queuePolicy = (int)jobManager.getQueuePolicy();
+    ImGui::SetNextItemWidth(200.0f);
+    if (ImGui::Combo("Queue order", &queuePolicy, queuePolicies, 4)) {
+        jobManager.setQueuePolicy((JobManager::QueuePolicy)queuePolicy);
+    }
 
     ImGui::Separator();
     ImGui::Text("Jobs:");
 
+    TranscodeMetrics::Snapshot total = jobManager.aggregateMetrics();
+    if (total.running) {
+        ImGui::SameLine();
+        if (total.etaSeconds >= 0.0) {
+            ImGui::Text("%.1f fps, %.1f MB written, ETA %d:%02d", total.currentFps,
+                        total.bytesWritten / (1024.0 * 1024.0),
+                        (int)total.etaSeconds / 60, (int)total.etaSeconds % 60);
+        } else {
+            ImGui::Text("%.1f fps, %.1f MB written", total.currentFps, total.bytesWritten / (1024.0 * 1024.0));
+        }
+    }
+
     const auto& jobs = jobManager.getJobs();
     for (const auto& job : jobs) {
         ImGui::PushID(job->id);
         
         fs::path p = Utf8ToPath(job->inputPath);
         ImGui::Text("%s", WideToUtf8(p.filename().wstring()).c_str());
+        if (job->costReady && job->cost.probed) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s %dx%d", job->cost.codecName.c_str(), job->cost.width, job->cost.height);
+        }
         
-        float progress = job->progress;
+        bool running = job->status == JobStatus::Running;
+        TranscodeMetrics::Snapshot snap;
+        if (running) snap = job->metrics.snapshot();
+        float progress = running ? snap.progress() : job->progress.load();
         char buf[32];
         sprintf(buf, "%.0f%%", progress * 100.0f);
         
@@ -312,7 +369,31 @@ void ShowTranscodeUI(JobManager& jobManager, std::string& outputFolder, int& cur
         }
 
         ImGui::SameLine();
-        ImGui::Text("%s", job->statusMessage.c_str());
+        if (running && snap.etaSeconds >= 0.0) {
+            ImGui::Text("%s %.1f fps, ETA %d:%02d", job->statusMessage.c_str(), snap.currentFps,
+                        (int)snap.etaSeconds / 60, (int)snap.etaSeconds % 60);
+        } else {
+            ImGui::Text("%s", job->statusMessage.c_str());
+        }
+
+        if (job->status == JobStatus::Pending && job->expectedSeconds >= 0.0) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("~%d:%02d", (int)job->expectedSeconds / 60, (int)job->expectedSeconds % 60);
+        }
+
+        if (job->status == JobStatus::Pending) {
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Prioritize")) {
+                jobManager.setJobPriority(job->id, job->priority + 1);
+            }
+        }
+
+        if (job->status == JobStatus::Pending || running) {
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Cancel")) {
+                jobManager.cancelJob(job->id);
+            }
+        }
         
         ImGui::PopID();
     }
@@ -658,7 +739,10 @@ int main() {
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
     // Job Manager
-    JobManager jobManager(3); // Limit to 3 concurrent jobs
+    JobManager jobManager; // Admits jobs by estimated CPU/memory cost
+    MediaProbe::shared().load("probe_cache.txt");
+    jobManager.setHistoryPath("throughput_history.txt");
+    jobManager.setJournalPath("jobs.journal"); // Re-queues jobs left unfinished by a crash
     std::string outputFolder = "";
     loadConfig(outputFolder);
     
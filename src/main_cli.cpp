@@ -1,37 +1,591 @@
-#include "transcoder.h"
+#include "job_system.h"
+#include "media_probe.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
-int main() {
-    std::string inputPath = "d:\\workspace\\MediaForge\\test_data\\泰罗奥特曼01_test.mkv";
-    std::string outputPath = "d:\\workspace\\MediaForge\\output\\output_hevc.mkv";
+namespace fs = std::filesystem;
 
-    std::cout << "=== MediaForge CLI Test ===" << std::endl;
-    std::cout << "Input:  " << inputPath << std::endl;
-    std::cout << "Output: " << outputPath << std::endl;
-    std::cout << std::endl;
+// Process exit codes, stable so a farm agent can act on them.
+enum ExitCode {
+    kExitOk = 0,            // Every job completed (or was skipped)
+    kExitJobsFailed = 1,    // At least one job failed or hit the time limit, or an input wasn't found
+    kExitUsage = 2,         // Bad command line
+    kExitNoInput = 3,       // Nothing to transcode
+    kExitInterrupted = 4,   // SIGINT/SIGTERM; with --journal the next run resumes
+};
 
-    Transcoder transcoder;
-    transcoder.setProgressCallback([](float progress) {
-        std::cout << "\rProgress: " << (int)(progress * 100) << "%" << std::flush;
-    });
+struct CliOptions {
+    std::vector<std::string> inputs;
+    std::vector<std::string> listFiles;
+    std::string outputDir;
+    std::string suffix = "_h265";
+    std::string container;          // Output extension; empty = same as the input
+    std::string encoder = "auto";
+    std::string policy = "fifo";
+    std::string layout = "auto";
+    std::string journalPath;
+    std::string historyPath;
+    std::string probeCachePath;
+    std::string reportPath;
+    std::string watchFolder;
+    std::set<std::string> extensions = {".mkv", ".mp4", ".mov", ".avi", ".ts", ".m2ts", ".mts", ".webm", ".wmv", ".flv"};
+    int jobs = 0;
+    double cores = 0.0;
+    double memoryGb = 0.0;
+    int decoderThreads = 0;
+    int timeLimitSeconds = 0;
+    double intervalSeconds = 5.0;
+    bool recursive = false;
+    bool chunked = false;
+    bool skipExisting = false;
+    bool follow = false;
+    bool mmap = false;
+};
 
-    bool isHevc = Transcoder::isHevc(inputPath);
-    std::cout << "Input is HEVC: " << (isHevc ? "yes" : "no") << std::endl;
+static std::atomic<bool> g_interrupted{false};
 
-    std::string encoder = isHevc ? "hevc" : "libx265";
-    std::cout << "Using encoder: " << encoder << std::endl;
-    std::cout << std::endl;
+static void onSignal(int) {
+    g_interrupted = true;
+}
 
-    std::cout << "Starting transcoding..." << std::endl;
-    bool success = transcoder.run(inputPath, outputPath, encoder, false);
+static void printUsage() {
+    std::cerr <<
+        "Usage: MediaForgeCLI [options] <file|directory|pattern>...\n"
+        "\n"
+        "Inputs:\n"
+        "  -l, --list FILE        read inputs from FILE, one per line ('-' = stdin)\n"
+        "  -r, --recursive        descend into subdirectories\n"
+        "      --ext LIST         extensions picked from directories (default mkv,mp4,mov,avi,ts,...)\n"
+        "  Patterns may use * and ? in the file name part, e.g. '/media/in/*.mkv'.\n"
+        "  -w, --watch DIR        also queue files as they finish arriving in DIR, until\n"
+        "                         interrupted (named <stem>_h265<ext>; -r watches subfolders)\n"
+        "\n"
+        "Output:\n"
+        "  -o, --output-dir DIR   write outputs here (default: next to each input)\n"
+        "      --suffix S         appended to the output file name (default _h265)\n"
+        "      --container EXT    output extension, e.g. mkv or mp4 (default: input's)\n"
+        "      --skip-existing    skip inputs whose output already exists\n"
+        "\n"
+        "Encoding and scheduling:\n"
+        "  -e, --encoder NAME     auto, libx265, hevc_nvenc, hevc_qsv, hevc_amf, hevc_vaapi, ... (default auto)\n"
+        "  -j, --jobs N           at most N jobs at once (default: as many as the budget admits)\n"
+        "      --cores N          CPU budget in cores (default: all)\n"
+        "      --memory-gb N      memory budget (default: 75% of RAM)\n"
+        "      --decoder-threads N  fixed decoder thread count (default: per job estimate)\n"
+        "      --chunked          split long software encodes into parallel chunks\n"
+        "      --follow           transcode recordings while they are still being written,\n"
+        "                         ending when the writer closes them or goes idle\n"
+        "      --mmap             read local inputs through a memory mapping\n"
+        "      --layout L         MP4/MKV index placement: auto, fragmented, reserved, end or\n"
+        "                         faststart (rewrites the file once finished; default auto)\n"
+        "      --policy P         fifo, priority, shortest or fair (default fifo)\n"
+        "      --time-limit SEC   cancel jobs running longer than SEC\n"
+        "\n"
+        "State:\n"
+        "      --journal FILE     crash-safe job journal; unfinished jobs resume on the next run\n"
+        "      --history FILE     throughput history used for duration estimates\n"
+        "      --probe-cache FILE cache of probe results\n"
+        "\n"
+        "Reporting:\n"
+        "  stdout carries JSON lines only: 'progress' every interval, 'job' as each job ends,\n"
+        "  and a final 'summary'. Logs go to stderr.\n"
+        "      --interval SEC     progress interval (default 5, 0 = off)\n"
+        "      --report FILE      also write the summary object to FILE\n"
+        "\n"
+        "Exit codes: 0 all completed, 1 some failed, 2 usage, 3 no input, 4 interrupted\n"
+        "(with --watch an interrupt is the normal way to stop, so it exits 0 or 1).\n";
+}
 
-    std::cout << std::endl;
-    if (success) {
-        std::cout << "Transcoding completed successfully!" << std::endl;
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    return out;
+}
+
+static std::string jsonString(const std::string& s) {
+    return "\"" + jsonEscape(s) + "\"";
+}
+
+static std::string number(double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    return buf;
+}
+
+static const char* statusName(JobStatus status) {
+    switch (status) {
+    case JobStatus::Pending: return "pending";
+    case JobStatus::Running: return "running";
+    case JobStatus::Completed: return "completed";
+    case JobStatus::Failed: return "failed";
+    case JobStatus::Skipped: return "skipped";
+    case JobStatus::Cancelled: return "cancelled";
+    }
+    return "unknown";
+}
+
+static bool isFinished(JobStatus status) {
+    return status != JobStatus::Pending && status != JobStatus::Running;
+}
+
+static std::string lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return s;
+}
+
+static bool wildcardMatch(const char* pattern, const char* name) {
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*') {
+        return wildcardMatch(pattern + 1, name) || (*name && wildcardMatch(pattern, name + 1));
+    }
+    if (*name && (*pattern == '?' || *pattern == *name)) {
+        return wildcardMatch(pattern + 1, name + 1);
+    }
+    return false;
+}
+
+static bool hasVideoExtension(const fs::path& path, const CliOptions& options) {
+    return options.extensions.count(lowercase(path.extension().string())) > 0;
+}
+
+static void collectDirectory(const fs::path& dir, const CliOptions& options, std::vector<std::string>& out) {
+    std::error_code ec;
+    std::vector<std::string> found;
+    auto add = [&](const fs::directory_entry& entry) {
+        if (entry.is_regular_file(ec) && hasVideoExtension(entry.path(), options)) {
+            found.push_back(entry.path().string());
+        }
+    };
+    if (options.recursive) {
+        for (auto it = fs::recursive_directory_iterator(dir, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            add(*it);
+        }
     } else {
-        std::cout << "Transcoding failed!" << std::endl;
+        for (auto it = fs::directory_iterator(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            add(*it);
+        }
+    }
+    // Directory order is arbitrary; sort so reruns queue the same way.
+    std::sort(found.begin(), found.end());
+    out.insert(out.end(), found.begin(), found.end());
+}
+
+static bool collectInput(const std::string& input, const CliOptions& options, std::vector<std::string>& out) {
+    fs::path path(input);
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        collectDirectory(path, options, out);
+        return true;
+    }
+    if (fs::is_regular_file(path, ec)) {
+        out.push_back(input);
+        return true;
+    }
+
+    std::string name = path.filename().string();
+    if (name.find_first_of("*?") == std::string::npos) {
+        std::cerr << "Input not found: " << input << std::endl;
+        return false;
+    }
+    fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    std::vector<std::string> matches;
+    for (auto it = fs::directory_iterator(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec) && wildcardMatch(name.c_str(), it->path().filename().string().c_str())) {
+            matches.push_back(it->path().string());
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    if (matches.empty()) {
+        std::cerr << "No files match: " << input << std::endl;
+        return false;
+    }
+    out.insert(out.end(), matches.begin(), matches.end());
+    return true;
+}
+
+static bool readListFile(const std::string& listPath, std::vector<std::string>& out) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (listPath != "-") {
+        file.open(listPath);
+        if (!file) {
+            std::cerr << "Could not read list file: " << listPath << std::endl;
+            return false;
+        }
+        in = &file;
+    }
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        out.push_back(line);
+    }
+    return true;
+}
+
+static std::string outputPathFor(const std::string& input, const CliOptions& options) {
+    fs::path in(input);
+    fs::path dir = options.outputDir.empty() ? in.parent_path() : fs::path(options.outputDir);
+    std::string ext = options.container.empty() ? in.extension().string() : "." + options.container;
+    return (dir / (in.stem().string() + options.suffix + ext)).string();
+}
+
+// Parses argv into options; returns false (after printing why) on a bad command line.
+static bool parseArgs(int argc, char** argv, CliOptions& options, bool& helpOnly) {
+    helpOnly = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+        auto numberValue = [&](double& out) {
+            std::string text;
+            if (!value(text)) return false;
+            char* end = nullptr;
+            out = std::strtod(text.c_str(), &end);
+            if (end == text.c_str() || *end != '\0' || out < 0.0) {
+                std::cerr << "Invalid number for " << arg << ": " << text << std::endl;
+                return false;
+            }
+            return true;
+        };
+        double n = 0.0;
+        std::string text;
+
+        if (arg == "-h" || arg == "--help") {
+            helpOnly = true;
+            return true;
+        } else if (arg == "-l" || arg == "--list") {
+            if (!value(text)) return false;
+            options.listFiles.push_back(text);
+        } else if (arg == "-r" || arg == "--recursive") {
+            options.recursive = true;
+        } else if (arg == "--ext") {
+            if (!value(text)) return false;
+            options.extensions.clear();
+            std::stringstream list(text);
+            std::string ext;
+            while (std::getline(list, ext, ',')) {
+                if (ext.empty()) continue;
+                options.extensions.insert(lowercase(ext[0] == '.' ? ext : "." + ext));
+            }
+        } else if (arg == "-o" || arg == "--output-dir") {
+            if (!value(options.outputDir)) return false;
+        } else if (arg == "--suffix") {
+            if (!value(options.suffix)) return false;
+        } else if (arg == "--container") {
+            if (!value(text)) return false;
+            options.container = text[0] == '.' ? text.substr(1) : text;
+        } else if (arg == "--skip-existing") {
+            options.skipExisting = true;
+        } else if (arg == "-e" || arg == "--encoder") {
+            if (!value(options.encoder)) return false;
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (!numberValue(n)) return false;
+            options.jobs = (int)n;
+        } else if (arg == "--cores") {
+            if (!numberValue(options.cores)) return false;
+        } else if (arg == "--memory-gb") {
+            if (!numberValue(options.memoryGb)) return false;
+        } else if (arg == "--decoder-threads") {
+            if (!numberValue(n)) return false;
+            options.decoderThreads = (int)n;
+        } else if (arg == "--chunked") {
+            options.chunked = true;
+        } else if (arg == "--follow") {
+            options.follow = true;
+        } else if (arg == "--mmap") {
+            options.mmap = true;
+        } else if (arg == "--layout") {
+            if (!value(options.layout)) return false;
+            if (options.layout != "auto" && options.layout != "fragmented" && options.layout != "reserved" &&
+                options.layout != "end" && options.layout != "faststart") {
+                std::cerr << "Unknown output layout: " << options.layout << std::endl;
+                return false;
+            }
+        } else if (arg == "--policy") {
+            if (!value(options.policy)) return false;
+            if (options.policy != "fifo" && options.policy != "priority" &&
+                options.policy != "shortest" && options.policy != "fair") {
+                std::cerr << "Unknown queue policy: " << options.policy << std::endl;
+                return false;
+            }
+        } else if (arg == "--time-limit") {
+            if (!numberValue(n)) return false;
+            options.timeLimitSeconds = (int)n;
+        } else if (arg == "--journal") {
+            if (!value(options.journalPath)) return false;
+        } else if (arg == "--history") {
+            if (!value(options.historyPath)) return false;
+        } else if (arg == "--probe-cache") {
+            if (!value(options.probeCachePath)) return false;
+        } else if (arg == "--interval") {
+            if (!numberValue(options.intervalSeconds)) return false;
+        } else if (arg == "-w" || arg == "--watch") {
+            if (!value(options.watchFolder)) return false;
+        } else if (arg == "--report") {
+            if (!value(options.reportPath)) return false;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            options.inputs.push_back(arg);
+        }
+    }
+    return true;
+}
+
+static std::string jobJson(const TranscodeJob& job, bool withMessage) {
+    TranscodeMetrics::Snapshot snap = job.metrics.snapshot();
+    double speed = snap.elapsedSeconds > 0.0 ? snap.positionSeconds / snap.elapsedSeconds : 0.0;
+    std::ostringstream out;
+    out << "{\"id\":" << job.id
+        << ",\"input\":" << jsonString(job.inputPath)
+        << ",\"output\":" << jsonString(job.outputPath)
+        << ",\"status\":" << jsonString(statusName(job.status));
+    if (withMessage) out << ",\"message\":" << jsonString(job.statusMessage);
+    out << ",\"durationSeconds\":" << number(snap.durationSeconds)
+        << ",\"elapsedSeconds\":" << number(snap.elapsedSeconds)
+        << ",\"framesEncoded\":" << snap.framesEncoded
+        << ",\"fps\":" << number(snap.averageFps)
+        << ",\"speed\":" << number(speed)
+        << ",\"bytesRead\":" << snap.bytesRead
+        << ",\"bytesWritten\":" << snap.bytesWritten
+        << "}";
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    bool helpOnly = false;
+    if (!parseArgs(argc, argv, options, helpOnly)) {
+        printUsage();
+        return kExitUsage;
+    }
+    if (helpOnly) {
+        printUsage();
+        return kExitOk;
+    }
+
+    // stdout is reserved for JSON; the pipeline's log lines go to stderr with FFmpeg's.
+    std::streambuf* jsonOut = std::cout.rdbuf(std::cerr.rdbuf());
+    std::ostream json(jsonOut);
+    auto emit = [&](const std::string& line) {
+        json << line << "\n";
+        json.flush();
+    };
+
+    std::vector<std::string> requested = options.inputs;
+    for (const auto& listFile : options.listFiles) {
+        if (!readListFile(listFile, requested)) {
+            std::cout.rdbuf(jsonOut);
+            return kExitUsage;
+        }
+    }
+    // A mistyped path or an empty wildcard is reported, counted and fails the run, but the
+    // inputs that were found are still transcoded.
+    std::vector<std::string> inputs;
+    int missing = 0;
+    for (const auto& input : requested) {
+        if (!collectInput(input, options, inputs)) {
+            emit("{\"event\":\"missing\",\"input\":" + jsonString(input) + "}");
+            missing++;
+        }
+    }
+
+    if (!options.probeCachePath.empty()) MediaProbe::shared().load(options.probeCachePath);
+
+    JobManager jobManager(options.jobs);
+    if (options.cores > 0.0 || options.memoryGb > 0.0) {
+        ResourceBudget budget;
+        budget.cores = options.cores;
+        budget.memoryBytes = (int64_t)(options.memoryGb * 1024.0 * 1024.0 * 1024.0);
+        jobManager.setResourceBudget(budget);
+    }
+    if (options.decoderThreads > 0) {
+        VideoDecoder::Options decoderOptions;
+        decoderOptions.threadCount = options.decoderThreads;
+        jobManager.setDecoderOptions(decoderOptions);
+    }
+    jobManager.setChunkedEncoding(options.chunked);
+    jobManager.setFollowGrowingInputs(options.follow);
+    jobManager.setMappedInput(options.mmap);
+    jobManager.setOutputLayout(options.layout == "fragmented" ? Muxer::Layout::Fragmented
+                             : options.layout == "reserved" ? Muxer::Layout::ReservedIndex
+                             : options.layout == "end" ? Muxer::Layout::IndexAtEnd
+                             : options.layout == "faststart" ? Muxer::Layout::Faststart
+                             : Muxer::Layout::Auto);
+    jobManager.setQueuePolicy(options.policy == "priority" ? JobManager::QueuePolicy::Priority
+                            : options.policy == "shortest" ? JobManager::QueuePolicy::ShortestFirst
+                            : options.policy == "fair" ? JobManager::QueuePolicy::FairShare
+                            : JobManager::QueuePolicy::Fifo);
+    if (options.timeLimitSeconds > 0) jobManager.setJobTimeLimit(std::chrono::seconds(options.timeLimitSeconds));
+    if (!options.historyPath.empty()) jobManager.setHistoryPath(options.historyPath);
+    // Before adding jobs, so restored ones keep their ids and new ones don't collide.
+    if (!options.journalPath.empty()) jobManager.setJournalPath(options.journalPath);
+
+    std::set<std::string> queued;
+    for (const auto& job : jobManager.getJobs()) queued.insert(job->inputPath);
+    int skipped = 0;
+    for (const auto& input : inputs) {
+        if (!queued.insert(input).second) continue;   // Duplicate, or restored from the journal
+        std::string output = outputPathFor(input, options);
+        std::error_code ec;
+        if (options.skipExisting && fs::exists(output, ec)) {
+            emit("{\"event\":\"skipped\",\"input\":" + jsonString(input) + ",\"output\":" + jsonString(output) + "}");
+            skipped++;
+            continue;
+        }
+        jobManager.addJob(input, output, options.encoder);
+    }
+
+    if (jobManager.getJobs().empty() && options.watchFolder.empty()) {
+        std::cerr << (skipped > 0 ? "All outputs already exist" : "No input files") << std::endl;
+        emit("{\"event\":\"summary\",\"jobs\":[],\"total\":0,\"completed\":0,\"failed\":0,\"cancelled\":0,\"skipped\":" +
+             std::to_string(skipped) + ",\"missing\":" + std::to_string(missing) + "}");
+        std::cout.rdbuf(jsonOut);
+        return skipped > 0 && missing == 0 ? kExitOk : kExitNoInput;
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto elapsedSince = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    };
+    auto nextProgress = startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                        std::chrono::duration<double>(options.intervalSeconds));
+    std::set<int> reported;
+
+    jobManager.setPaused(false);
+    bool watching = false;
+    if (!options.watchFolder.empty()) {
+        watching = jobManager.watchFolder(options.watchFolder, options.outputDir, options.encoder, options.recursive);
+        if (!watching) {
+            jobManager.stop();
+            std::cout.rdbuf(jsonOut);
+            return kExitUsage;
+        }
+    }
+    while (!g_interrupted) {
+        // Re-read each time: the folder watcher adds jobs from its own thread.
+        auto jobs = jobManager.getJobs();
+        int finished = 0;
+        int running = 0;
+        for (const auto& job : jobs) {
+            JobStatus status = job->status;
+            if (status == JobStatus::Running) running++;
+            if (!isFinished(status)) continue;
+            finished++;
+            if (reported.insert(job->id).second) {
+                emit("{\"event\":\"job\",\"job\":" + jobJson(*job, false) + "}");
+            }
+        }
+        if (!watching && finished == (int)jobs.size()) break;
+
+        if (options.intervalSeconds > 0.0 && std::chrono::steady_clock::now() >= nextProgress) {
+            TranscodeMetrics::Snapshot total = jobManager.aggregateMetrics();
+            ResourceUsage usage = jobManager.getResourceUsage();
+            emit("{\"event\":\"progress\",\"elapsedSeconds\":" + number(elapsedSince()) +
+                 ",\"finished\":" + std::to_string(finished) + ",\"running\":" + std::to_string(running) +
+                 ",\"total\":" + std::to_string(jobs.size()) + ",\"fps\":" + number(total.currentFps) +
+                 ",\"cores\":" + number(usage.cores) + ",\"bytesWritten\":" + std::to_string(total.bytesWritten) +
+                 ",\"etaSeconds\":" + number(total.etaSeconds) + "}");
+            nextProgress += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(options.intervalSeconds));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    bool interrupted = g_interrupted;
+    if (interrupted) {
+        std::cerr << "Interrupted, stopping running jobs..." << std::endl;
+    }
+    // Stops the watcher and joins the workers; with a journal, interrupted jobs keep
+    // their finished chunks.
+    jobManager.stop();
+    auto jobs = jobManager.getJobs();
+
+    int completed = 0, failed = 0, cancelled = 0;
+    uint64_t frames = 0, bytesWritten = 0;
+    double mediaSeconds = 0.0;
+    std::string jobList;
+    for (const auto& job : jobs) {
+        switch (job->status.load()) {
+        case JobStatus::Completed: completed++; break;
+        case JobStatus::Failed: failed++; break;
+        case JobStatus::Cancelled: cancelled++; break;
+        case JobStatus::Skipped: skipped++; break;
+        default: break;
+        }
+        TranscodeMetrics::Snapshot snap = job->metrics.snapshot();
+        frames += snap.framesEncoded;
+        bytesWritten += snap.bytesWritten;
+        if (job->status == JobStatus::Completed) mediaSeconds += snap.durationSeconds;
+        if (!jobList.empty()) jobList += ",";
+        jobList += jobJson(*job, true);
+    }
+
+    double wallSeconds = elapsedSince();
+    std::string summary = "{\"jobs\":[" + jobList + "]" +
+        ",\"total\":" + std::to_string(jobs.size()) +
+        ",\"completed\":" + std::to_string(completed) +
+        ",\"failed\":" + std::to_string(failed) +
+        ",\"cancelled\":" + std::to_string(cancelled) +
+        ",\"skipped\":" + std::to_string(skipped) +
+        ",\"missing\":" + std::to_string(missing) +
+        ",\"interrupted\":" + (interrupted ? "true" : "false") +
+        ",\"elapsedSeconds\":" + number(wallSeconds) +
+        ",\"framesEncoded\":" + std::to_string(frames) +
+        ",\"fps\":" + number(wallSeconds > 0.0 ? frames / wallSeconds : 0.0) +
+        ",\"speed\":" + number(wallSeconds > 0.0 ? mediaSeconds / wallSeconds : 0.0) +
+        ",\"bytesWritten\":" + std::to_string(bytesWritten) + "}";
+    emit("{\"event\":\"summary\"," + summary.substr(1));
+
+    if (!options.reportPath.empty()) {
+        std::ofstream report(options.reportPath);
+        report << summary << "\n";
+        if (!report) std::cerr << "Could not write report: " << options.reportPath << std::endl;
     }
 
-    return success ? 0 : 1;
-}
\ No newline at end of file
+    std::cout.rdbuf(jsonOut);
+    if (interrupted && !watching) return kExitInterrupted;
+    return failed > 0 || cancelled > 0 || missing > 0 ? kExitJobsFailed : kExitOk;
+}
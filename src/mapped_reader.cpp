@@ -0,0 +1,178 @@
+#include "mapped_reader.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+// Only avio_r8() and friends go through the AVIO buffer in direct mode, so it can be small.
+static const int kIoBufferSize = 4096;
+// Pages requested ahead of the read position; renewed once half of it has been read.
+static const int64_t kAdviseWindow = 32ll * 1024 * 1024;
+static const int64_t kPageSize = 4096;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+#endif
+
+MappedReader::~MappedReader() {
+    close();
+}
+
+bool MappedReader::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(Utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = (const uint8_t*)view;
+    size_ = size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file referenced on its own.
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+    data_ = (const uint8_t*)view;
+    size_ = st.st_size;
+#endif
+
+    position_ = 0;
+    advisedEnd_ = 0;
+    stats_ = Stats();
+    adviseAhead();
+
+    unsigned char* ioBuffer = (unsigned char*)av_malloc(kIoBufferSize);
+    ioContext_ = avio_alloc_context(ioBuffer, kIoBufferSize, 0, this, &MappedReader::readPacket, nullptr,
+                                    &MappedReader::seekPacket);
+    if (!ioContext_) {
+        av_free(ioBuffer);
+        close();
+        return false;
+    }
+    // Large reads (packet payloads) are copied straight from the mapping into the packet.
+    ioContext_->direct = 1;
+    return true;
+}
+
+void MappedReader::close() {
+    if (ioContext_) {
+        av_freep(&ioContext_->buffer);
+        avio_context_free(&ioContext_);
+    }
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_) CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_) munmap((void*)data_, (size_t)size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+void MappedReader::adviseAhead() {
+    if (position_ + kAdviseWindow / 2 < advisedEnd_ || advisedEnd_ >= size_) return;
+
+    int64_t start = std::max(advisedEnd_, position_) / kPageSize * kPageSize;
+    int64_t end = std::min(size_, position_ + kAdviseWindow);
+    if (end <= start) return;
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (void*)(data_ + start);
+    range.NumberOfBytes = (size_t)(end - start);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise((void*)(data_ + start), (size_t)(end - start), MADV_WILLNEED);
+#endif
+    advisedEnd_ = end;
+}
+
+int MappedReader::read(uint8_t* buf, int size) {
+    if (position_ >= size_) return AVERROR_EOF;
+    int count = (int)std::min<int64_t>(size, size_ - position_);
+    memcpy(buf, data_ + position_, count);
+    position_ += count;
+    stats_.bytesRead += count;
+    stats_.reads++;
+    adviseAhead();
+    return count;
+}
+
+int64_t MappedReader::seek(int64_t offset, int whence) {
+    if (whence & AVSEEK_SIZE) return size_;
+    whence &= ~AVSEEK_FORCE;
+
+    int64_t target;
+    if (whence == SEEK_SET) {
+        target = offset;
+    } else if (whence == SEEK_CUR) {
+        target = position_ + offset;
+    } else if (whence == SEEK_END) {
+        target = size_ + offset;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    if (target < 0) return AVERROR(EINVAL);
+
+    stats_.seeks++;
+    // A jump outside the window requested so far starts a new one at the target.
+    if (target < advisedEnd_ - kAdviseWindow || target >= advisedEnd_) advisedEnd_ = target;
+    position_ = target;
+    adviseAhead();
+    return target;
+}
+
+int MappedReader::readPacket(void* opaque, uint8_t* buf, int size) {
+    return static_cast<MappedReader*>(opaque)->read(buf, size);
+}
+
+int64_t MappedReader::seekPacket(void* opaque, int64_t offset, int whence) {
+    return static_cast<MappedReader*>(opaque)->seek(offset, whence);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+// Serves a local file to FFmpeg from a read-only memory mapping through a custom
+// AVIOContext in direct mode: reads are a single copy out of the mapping, with no read
+// syscalls and no intermediate AVIO buffer. The kernel is told the access is sequential
+// and asked to page in a window ahead of the read position. The file must not be
+// truncated while open (reads past the new end would fault), so this is for local files
+// that nothing else is rewriting.
+class MappedReader {
+public:
+    struct Stats {
+        uint64_t bytesRead = 0;
+        uint64_t reads = 0;         // Read callbacks, each one memcpy
+        uint64_t seeks = 0;
+    };
+
+    MappedReader() = default;
+    ~MappedReader();
+    MappedReader(const MappedReader&) = delete;
+    MappedReader& operator=(const MappedReader&) = delete;
+
+    // Fails for empty files and anything that can't be mapped; the caller falls back to
+    // normal reads.
+    bool open(const std::string& path);
+    void close();
+
+    // Owned by the reader and freed by close(); install it as AVFormatContext::pb together
+    // with AVFMT_FLAG_CUSTOM_IO.
+    AVIOContext* ioContext() const { return ioContext_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    int64_t size_ = 0;
+    int64_t position_ = 0;
+    int64_t advisedEnd_ = 0;        // Readahead has been requested up to here
+    AVIOContext* ioContext_ = nullptr;
+    Stats stats_;
+#ifdef _WIN32
+    void* file_ = nullptr;          // HANDLE
+    void* mapping_ = nullptr;       // HANDLE
+#endif
+
+    void adviseAhead();
+    int read(uint8_t* buf, int size);
+    int64_t seek(int64_t offset, int whence);
+
+    static int readPacket(void* opaque, uint8_t* buf, int size);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+};
@@ -0,0 +1,119 @@
+#include "media_pool.h"
+#include <iostream>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+static const int kFrameAlign = 32;
+
+PacketPool::PacketPool(size_t maxCached) : maxCached_(maxCached) {}
+
+PacketPool::~PacketPool() {
+    for (AVPacket* packet : free_) {
+        av_packet_free(&packet);
+    }
+}
+
+AVPacket* PacketPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            AVPacket* packet = free_.back();
+            free_.pop_back();
+            return packet;
+        }
+    }
+    allocations_++;
+    return av_packet_alloc();
+}
+
+void PacketPool::release(AVPacket* packet) {
+    if (!packet) return;
+    av_packet_unref(packet);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < maxCached_) {
+        free_.push_back(packet);
+    } else {
+        av_packet_free(&packet);
+    }
+}
+
+FramePool::FramePool(size_t maxCached) : maxCached_(maxCached) {}
+
+FramePool::~FramePool() {
+    for (AVFrame* frame : free_) {
+        av_frame_free(&frame);
+    }
+    // Buffers still referenced elsewhere keep their pool alive until they are released.
+    for (auto& entry : bufferPools_) {
+        av_buffer_pool_uninit(&entry.second.pool);
+    }
+}
+
+AVBufferRef* FramePool::allocBuffer(void* opaque, size_t size) {
+    FramePool* self = static_cast<FramePool*>(opaque);
+    self->bufferAllocations_++;
+    return av_buffer_alloc(size);
+}
+
+AVFrame* FramePool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            AVFrame* frame = free_.back();
+            free_.pop_back();
+            return frame;
+        }
+    }
+    allocations_++;
+    return av_frame_alloc();
+}
+
+AVFrame* FramePool::acquireVideo(int width, int height, AVPixelFormat format) {
+    AVBufferPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        BufferPool& entry = bufferPools_[Geometry(width, height, format)];
+        if (!entry.pool) {
+            int size = av_image_get_buffer_size(format, width, height, kFrameAlign);
+            if (size < 0) {
+                bufferPools_.erase(Geometry(width, height, format));
+                std::cerr << "[FramePool] Invalid frame geometry " << width << "x" << height << std::endl;
+                return nullptr;
+            }
+            entry.size = (size_t)size;
+            entry.pool = av_buffer_pool_init2(entry.size, this, &FramePool::allocBuffer, nullptr);
+        }
+        pool = entry.pool;
+    }
+
+    AVFrame* frame = acquire();
+    if (!frame) return nullptr;
+
+    frame->buf[0] = av_buffer_pool_get(pool);
+    if (!frame->buf[0]) {
+        release(frame);
+        return nullptr;
+    }
+
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    av_image_fill_arrays(frame->data, frame->linesize, frame->buf[0]->data,
+                         format, width, height, kFrameAlign);
+    return frame;
+}
+
+void FramePool::release(AVFrame* frame) {
+    if (!frame) return;
+    av_frame_unref(frame);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < maxCached_) {
+        free_.push_back(frame);
+    } else {
+        av_frame_free(&frame);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+// Recycles AVPacket shells so hot loops don't go through av_packet_alloc/av_packet_free per packet.
+// Thread-safe; pipeline stages on different threads can acquire and release from the same pool.
+class PacketPool {
+public:
+    explicit PacketPool(size_t maxCached = 512);
+    ~PacketPool();
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    AVPacket* acquire();
+    void release(AVPacket* packet);
+
+    // Shells created because the free list was empty. Stops growing once the loop reaches steady state.
+    uint64_t allocations() const { return allocations_; }
+
+private:
+    std::mutex mutex_;
+    std::vector<AVPacket*> free_;
+    size_t maxCached_;
+    std::atomic<uint64_t> allocations_{0};
+};
+
+// Recycles AVFrame shells, and hands out video frames whose data comes from an AVBufferPool
+// per geometry, so conversion targets are reused instead of allocated per frame.
+class FramePool {
+public:
+    explicit FramePool(size_t maxCached = 64);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    AVFrame* acquire();
+    AVFrame* acquireVideo(int width, int height, AVPixelFormat format);
+    void release(AVFrame* frame);
+
+    // Frame shells plus data buffers created on a pool miss.
+    uint64_t allocations() const { return allocations_ + bufferAllocations_; }
+
+private:
+    static AVBufferRef* allocBuffer(void* opaque, size_t size);
+
+    using Geometry = std::tuple<int, int, int>;
+    struct BufferPool {
+        AVBufferPool* pool = nullptr;
+        size_t size = 0;
+    };
+
+    std::mutex mutex_;
+    std::vector<AVFrame*> free_;
+    std::map<Geometry, BufferPool> bufferPools_;
+    size_t maxCached_;
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> bufferAllocations_{0};
+};
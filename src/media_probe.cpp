@@ -0,0 +1,237 @@
+#include "media_probe.h"
+#include "demuxer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace fs = std::filesystem;
+
+// Video packets read after the stream info to measure the keyframe interval. Enough for
+// a couple of GOPs at typical settings without pulling much data off a slow share.
+static const int kMaxGopPackets = 300;
+static const int kGopKeyframes = 3;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+
+static FILE* openFile(const std::string& path, const char* mode) {
+    std::wstring wideMode(mode, mode + strlen(mode));
+    return _wfopen(Utf8ToWide(path).c_str(), wideMode.c_str());
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+
+static FILE* openFile(const std::string& path, const char* mode) {
+    return fopen(path.c_str(), mode);
+}
+#endif
+
+MediaProbe& MediaProbe::shared() {
+    static MediaProbe instance;
+    return instance;
+}
+
+bool MediaProbe::fileStamp(const std::string& inputPath, int64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    fs::path p = Utf8ToPath(inputPath);
+    uintmax_t fileSize = fs::file_size(p, ec);
+    if (ec) return false;
+    auto writeTime = fs::last_write_time(p, ec);
+    if (ec) return false;
+    size = (int64_t)fileSize;
+    mtime = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+MediaInfo MediaProbe::probe(const std::string& inputPath) {
+    MediaInfo info;
+
+    Demuxer demuxer;
+    // A probe reads a few hundred KB at most; read-ahead would only pull in more.
+    demuxer.setReadAhead(0);
+    demuxer.setProbe(Demuxer::Probe::Formats);
+    if (!demuxer.open(inputPath) || demuxer.getVideoStreamIndex() < 0) {
+        return info;
+    }
+
+    AVFormatContext* fmtCtx = demuxer.getFormatContext();
+    int videoIdx = demuxer.getVideoStreamIndex();
+    AVStream* stream = fmtCtx->streams[videoIdx];
+    const AVCodecParameters* params = stream->codecpar;
+
+    info.valid = true;
+    info.codecId = params->codec_id;
+    info.codecName = avcodec_get_name(params->codec_id);
+    info.width = params->width;
+    info.height = params->height;
+    info.frameRate = av_q2d(stream->avg_frame_rate);
+    if (!(info.frameRate > 0.0 && info.frameRate < 1000.0)) info.frameRate = av_q2d(stream->r_frame_rate);
+    info.durationSeconds = demuxer.getDuration() > 0 ? demuxer.getDuration() / (double)AV_TIME_BASE : 0.0;
+    info.bitRate = fmtCtx->bit_rate;
+    info.videoTimeBase = stream->time_base;
+    info.hasAudio = demuxer.getAudioStreamIndex() >= 0;
+    if (const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)params->format)) {
+        info.pixelFormat = desc->name;
+        info.bitDepth = desc->comp[0].depth;
+    }
+
+    // Keyframe spacing from the first few GOPs; containers rarely record it.
+    AVPacket* packet = av_packet_alloc();
+    std::vector<int64_t> keyframes;
+    int videoPackets = 0;
+    while (videoPackets < kMaxGopPackets && (int)keyframes.size() < kGopKeyframes && demuxer.readPacket(packet)) {
+        if (packet->stream_index == videoIdx) {
+            videoPackets++;
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if ((packet->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE) keyframes.push_back(pts);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    if (keyframes.size() >= 2) {
+        info.keyframeInterval = (keyframes.back() - keyframes.front()) * av_q2d(stream->time_base) /
+                                (double)(keyframes.size() - 1);
+    }
+
+    return info;
+}
+
+bool MediaProbe::load(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = path;
+
+    FILE* f = openFile(path, "rb");
+    if (!f) return false;
+
+    // One entry per line, tab-separated, the path last (Windows paths can't contain tabs):
+    // <size> <mtime> <codec> <pixfmt> <depth> <w> <h> <fps> <duration> <bitrate> <gop> <tb num> <tb den> <audio> <path>
+    // Later lines replace earlier ones for the same path.
+    size_t lines = 0;
+    std::string line;
+    int c;
+    while (true) {
+        line.clear();
+        while ((c = fgetc(f)) != EOF && c != '\n') line += (char)c;
+        if (c == EOF) break;   // Unterminated last line: an interrupted append
+
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (int i = 0; i < 14; i++) {
+            size_t tab = line.find('\t', start);
+            if (tab == std::string::npos) break;
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        if (fields.size() != 14 || start >= line.size()) continue;
+        lines++;
+
+        Entry entry;
+        entry.size = std::strtoll(fields[0].c_str(), nullptr, 10);
+        entry.mtime = std::strtoll(fields[1].c_str(), nullptr, 10);
+        MediaInfo& info = entry.info;
+        info.codecName = fields[2];
+        const AVCodecDescriptor* codec = avcodec_descriptor_get_by_name(info.codecName.c_str());
+        info.codecId = codec ? codec->id : AV_CODEC_ID_NONE;
+        info.valid = info.codecId != AV_CODEC_ID_NONE;
+        info.pixelFormat = fields[3] == "-" ? "" : fields[3];
+        info.bitDepth = std::atoi(fields[4].c_str());
+        info.width = std::atoi(fields[5].c_str());
+        info.height = std::atoi(fields[6].c_str());
+        info.frameRate = std::atof(fields[7].c_str());
+        info.durationSeconds = std::atof(fields[8].c_str());
+        info.bitRate = std::strtoll(fields[9].c_str(), nullptr, 10);
+        info.keyframeInterval = std::atof(fields[10].c_str());
+        info.videoTimeBase = AVRational{std::atoi(fields[11].c_str()), std::atoi(fields[12].c_str())};
+        info.hasAudio = fields[13] == "1";
+        if (info.valid) entries_[line.substr(start)] = entry;
+    }
+    fclose(f);
+
+    // Drop superseded lines once they make up most of the file.
+    if (lines > 2 * entries_.size() + 64) {
+        std::string tempPath = path + ".tmp";
+        if (FILE* out = openFile(tempPath, "wb")) {
+            for (const auto& [inputPath, entry] : entries_) writeEntry(out, inputPath, entry);
+            fclose(out);
+            std::error_code ec;
+            fs::rename(Utf8ToPath(tempPath), Utf8ToPath(path), ec);
+        }
+    }
+
+    std::cout << "[MediaProbe] Loaded " << entries_.size() << " cached probe(s) from " << path << std::endl;
+    return true;
+}
+
+void MediaProbe::writeEntry(FILE* f, const std::string& inputPath, const Entry& entry) {
+    if (inputPath.find_first_of("\t\n") != std::string::npos) return;
+    const MediaInfo& info = entry.info;
+    fprintf(f, "%lld\t%lld\t%s\t%s\t%d\t%d\t%d\t%.6f\t%.3f\t%lld\t%.3f\t%d\t%d\t%d\t%s\n",
+            (long long)entry.size, (long long)entry.mtime, info.codecName.c_str(),
+            info.pixelFormat.empty() ? "-" : info.pixelFormat.c_str(), info.bitDepth, info.width, info.height,
+            info.frameRate, info.durationSeconds, (long long)info.bitRate, info.keyframeInterval,
+            info.videoTimeBase.num, info.videoTimeBase.den, info.hasAudio ? 1 : 0, inputPath.c_str());
+}
+
+void MediaProbe::append(const std::string& inputPath, const Entry& entry) {
+    if (path_.empty()) return;
+
+    FILE* f = openFile(path_, "ab");
+    if (!f) {
+        std::cerr << "[MediaProbe] Could not write " << path_ << std::endl;
+        return;
+    }
+    writeEntry(f, inputPath, entry);
+    fclose(f);
+}
+
+MediaInfo MediaProbe::get(const std::string& inputPath) {
+    int64_t size = 0, mtime = 0;
+    bool stamped = fileStamp(inputPath, size, mtime);
+
+    if (stamped) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(inputPath);
+        if (it != entries_.end() && it->second.size == size && it->second.mtime == mtime) {
+            hits_++;
+            return it->second.info;
+        }
+        misses_++;
+    }
+
+    Entry entry;
+    entry.size = size;
+    entry.mtime = mtime;
+    entry.info = probe(inputPath);
+
+    // Failed probes aren't cached: the file may still be copying in.
+    if (stamped && entry.info.valid) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[inputPath] = entry;
+        append(inputPath, entry);
+    }
+    return entry.info;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// What a probe learns about an input's main video stream, enough for scheduling, encoder
+// choice and chunk planning without opening the file again.
+struct MediaInfo {
+    bool valid = false;             // false when the file couldn't be opened or has no video
+    std::string codecName;
+    AVCodecID codecId = AV_CODEC_ID_NONE;
+    std::string pixelFormat;
+    int bitDepth = 8;
+    int width = 0;
+    int height = 0;
+    double frameRate = 0.0;
+    double durationSeconds = 0.0;
+    int64_t bitRate = 0;            // Container bit rate, bits/s; 0 if unknown
+    double keyframeInterval = 0.0;  // Seconds between the first keyframes; 0 if unknown
+    AVRational videoTimeBase{0, 1};
+    bool hasAudio = false;
+};
+
+// Process-wide cache of MediaInfo keyed by path, file size and modification time, kept in
+// memory and in a small text file so re-queueing a library doesn't probe it again. A file
+// that changed on disk is probed afresh.
+class MediaProbe {
+public:
+    static MediaProbe& shared();
+
+    // Loads earlier results; new probes are appended to the same file.
+    bool load(const std::string& path);
+
+    // Cached info if the file is unchanged, otherwise probes it (outside the lock, so
+    // concurrent callers probing different files don't wait on each other).
+    MediaInfo get(const std::string& inputPath);
+
+    // Opens the file and reads its stream info plus the first few GOPs.
+    static MediaInfo probe(const std::string& inputPath);
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    struct Entry {
+        int64_t size = 0;
+        int64_t mtime = 0;
+        MediaInfo info;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::string path_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+
+    static bool fileStamp(const std::string& inputPath, int64_t& size, int64_t& mtime);
+    void append(const std::string& inputPath, const Entry& entry);
+    static void writeEntry(FILE* f, const std::string& inputPath, const Entry& entry);
+};
@@ -1,14 +1,21 @@
 #include "muxer.h"
+#include <algorithm>
 #include <iostream>
 #include <cstring>
-#include <windows.h>
-
-#define NOMINMAX
+#include <cstdio>
 
 extern "C" {
 #include <libavutil/opt.h>
 }
 
+// Outputs that would need a larger reserved index (many hours of high frame rate video)
+// are written fragmented instead.
+static const int64_t kMaxReservedIndex = 128ll * 1024 * 1024;
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+
 static std::wstring Utf8ToWide(const std::string& str) {
     if (str.empty()) return std::wstring();
     int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
@@ -50,6 +57,24 @@ static std::string GetShortPath(const std::string& utf8Path) {
     return strTo;
 }
 
+static FILE* createFile(const std::string& path) {
+    return _wfopen(Utf8ToWide(path).c_str(), L"wb");
+}
+#else
+// POSIX paths are UTF-8 already and FFmpeg opens them as they are.
+static std::string GetAbsolutePath(const std::string& path) {
+    return path;
+}
+
+static std::string GetShortPath(const std::string& path) {
+    return path;
+}
+
+static FILE* createFile(const std::string& path) {
+    return fopen(path.c_str(), "wb");
+}
+#endif
+
 Muxer::Muxer() {}
 
 Muxer::~Muxer() {
@@ -63,8 +88,7 @@ bool Muxer::open(const std::string& outputPath) {
     std::string absPath = GetAbsolutePath(outputPath);
 
     {
-        std::wstring widePath = Utf8ToWide(absPath);
-        FILE* f = _wfopen(widePath.c_str(), L"wb");
+        FILE* f = createFile(absPath);
         if (f) {
             fclose(f);
         } else {
@@ -79,6 +103,8 @@ bool Muxer::open(const std::string& outputPath) {
     const AVOutputFormat* oformat = nullptr;
     if (absPath.find(".mkv") != std::string::npos || absPath.find(".webm") != std::string::npos) {
         oformat = av_guess_format("matroska", nullptr, nullptr);
+    } else if (absPath.size() >= 4 && absPath.compare(absPath.size() - 4, 4, ".nut") == 0) {
+        oformat = av_guess_format("nut", nullptr, nullptr);
     } else {
         oformat = av_guess_format("mp4", nullptr, nullptr);
     }
@@ -114,21 +140,26 @@ void Muxer::close() {
         fmtCtx_ = nullptr;
     }
     headerWritten_ = false;
+    expectedDuration_ = 0;
+    expectedDurationExact_ = false;
     lastDts_.clear();
     lastPts_.clear();
     codecTimeBases_.clear();
 }
 
-int Muxer::addStream(AVCodecParameters* codecParams) {
+int Muxer::addStream(AVCodecParameters* codecParams, AVRational timeBase) {
     if (!fmtCtx_) return -1;
 
     AVStream* stream = avformat_new_stream(fmtCtx_, nullptr);
     if (!stream) return -1;
 
     avcodec_parameters_copy(stream->codecpar, codecParams);
+    // The source container's codec tag may be invalid here; let the muxer pick one.
+    stream->codecpar->codec_tag = 0;
+    stream->time_base = timeBase;
     lastDts_.push_back(AV_NOPTS_VALUE);
     lastPts_.push_back(AV_NOPTS_VALUE);
-    codecTimeBases_.push_back(stream->time_base);
+    codecTimeBases_.push_back(timeBase);
 
     std::cout << "[Muxer] addStream (params): index=" << stream->index
               << ", codec_type=" << codecParams->codec_type
@@ -159,6 +190,11 @@ int Muxer::addStream(AVCodecContext* codecCtx) {
     return stream->index;
 }
 
+bool Muxer::supportsCodec(AVCodecID codecId) const {
+    if (!fmtCtx_ || !fmtCtx_->oformat) return false;
+    return avformat_query_codec(fmtCtx_->oformat, codecId, FF_COMPLIANCE_NORMAL) == 1;
+}
+
 void Muxer::setStreamTimeBase(int streamIndex, AVRational timeBase) {
     if (fmtCtx_ && streamIndex >= 0 && streamIndex < (int)fmtCtx_->nb_streams) {
         fmtCtx_->streams[streamIndex]->time_base = timeBase;
@@ -178,10 +214,37 @@ bool Muxer::writeHeader() {
     }
 
     AVDictionary* opts = nullptr;
-    if (fmtCtx_->oformat && fmtCtx_->oformat->name &&
-        (strcmp(fmtCtx_->oformat->name, "mp4") == 0 || strcmp(fmtCtx_->oformat->name, "m4a") == 0)) {
-        av_dict_set(&opts, "movflags", "+faststart", 0);
-        std::cout << "[Muxer] Setting movflags +faststart for MP4" << std::endl;
+    const char* formatName = fmtCtx_->oformat && fmtCtx_->oformat->name ? fmtCtx_->oformat->name : "";
+    bool mp4 = strcmp(formatName, "mp4") == 0 || strcmp(formatName, "m4a") == 0 || strcmp(formatName, "mov") == 0;
+    bool matroska = strcmp(formatName, "matroska") == 0 || strcmp(formatName, "webm") == 0;
+    if (mp4 || matroska) {
+        Layout layout = layout_;
+        int64_t indexSize = 0;
+        if (layout == Layout::Auto || layout == Layout::ReservedIndex) {
+            bool sizeable = expectedDuration_ > 0 && (expectedDurationExact_ || layout == Layout::ReservedIndex);
+            indexSize = sizeable ? estimateIndexSize(mp4) : 0;
+            if (indexSize > 0 && indexSize <= kMaxReservedIndex) {
+                layout = Layout::ReservedIndex;
+            } else {
+                if (layout == Layout::ReservedIndex) {
+                    std::cout << "[Muxer] Can't size a reserved index without a known duration" << std::endl;
+                }
+                layout = mp4 ? Layout::Fragmented : Layout::IndexAtEnd;
+            }
+        }
+
+        if (layout == Layout::ReservedIndex) {
+            av_dict_set_int(&opts, mp4 ? "moov_size" : "reserve_index_space", indexSize, 0);
+            std::cout << "[Muxer] Reserving " << indexSize / 1024 << " KB for the " << (mp4 ? "moov" : "cues") << std::endl;
+        } else if (layout == Layout::Fragmented && mp4) {
+            // Fragments start at keyframes and carry their own offsets, so the file is
+            // readable at every fragment boundary; the trailer only appends the mfra index.
+            av_dict_set(&opts, "movflags", "+frag_keyframe+empty_moov+default_base_moof", 0);
+            std::cout << "[Muxer] Writing fragmented MP4" << std::endl;
+        } else if (layout == Layout::Faststart && mp4) {
+            av_dict_set(&opts, "movflags", "+faststart", 0);
+            std::cout << "[Muxer] Setting movflags +faststart for MP4" << std::endl;
+        }
     }
 
     int ret = avformat_write_header(fmtCtx_, &opts);
@@ -199,6 +262,34 @@ bool Muxer::writeHeader() {
     return true;
 }
 
+int64_t Muxer::estimateIndexSize(bool mp4) const {
+    double seconds = expectedDuration_ / (double)AV_TIME_BASE;
+    double bytes = 64 * 1024;
+    for (unsigned int i = 0; i < fmtCtx_->nb_streams; i++) {
+        const AVStream* stream = fmtCtx_->streams[i];
+        const AVCodecParameters* par = stream->codecpar;
+        double packetsPerSecond = 10.0;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO) {
+            AVRational rate = par->framerate.num > 0 ? par->framerate : stream->avg_frame_rate;
+            // High-rate sources cost more moov than an unknown rate would; assume 60 fps.
+            packetsPerSecond = rate.num > 0 && rate.den > 0 ? av_q2d(rate) : 60.0;
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && par->sample_rate > 0) {
+            packetsPerSecond = par->sample_rate / (double)(par->frame_size > 0 ? par->frame_size : 1024);
+        }
+
+        if (mp4) {
+            // Per sample at most: stsz 4, stts 8, ctts 8, stss 4, plus chunk offsets.
+            bytes += 4096 + packetsPerSecond * seconds * 32.0;
+        } else if (par->codec_type == AVMEDIA_TYPE_VIDEO || fmtCtx_->nb_streams == 1) {
+            // A cue point per keyframe (or per cluster for audio-only), at most two a second.
+            bytes += 1024 + std::min(packetsPerSecond, 2.0) * seconds * 40.0;
+        }
+    }
+    // Even an exact duration leaves B-frame reordering and audio priming uncounted, and an
+    // MP4 whose moov outgrows its reservation can't be finished, so leave a wide margin.
+    return (int64_t)(bytes * 1.5);
+}
+
 bool Muxer::writePacket(AVPacket* packet) {
     if (!fmtCtx_ || !headerWritten_) return false;
 
@@ -218,10 +309,9 @@ bool Muxer::writePacket(AVPacket* packet) {
             }
             lastDts_[idx] = packet->dts;
         }
+        // pts is only monotonic in presentation order; with B-frames it legitimately goes
+        // backwards in decode order, so it is tracked but not clamped.
         if (packet->pts != AV_NOPTS_VALUE) {
-            if (lastPts_[idx] != AV_NOPTS_VALUE && packet->pts <= lastPts_[idx]) {
-                packet->pts = lastPts_[idx] + 1;
-            }
             lastPts_[idx] = packet->pts;
         }
     }
@@ -14,6 +14,28 @@ public:
     Muxer();
     ~Muxer();
 
+    // Where the container's index goes. All layouts but Faststart write every byte once;
+    // Faststart has FFmpeg read the finished MP4 back and rewrite it to move the moov atom
+    // to the front.
+    enum class Layout {
+        Auto,           // ReservedIndex when the expected duration is exact, else Fragmented
+                        // MP4 / IndexAtEnd Matroska
+        Fragmented,     // MP4 as a fragment per keyframe; playable while still being written
+        ReservedIndex,  // Space for the moov (MP4) or cues (Matroska) is reserved after the
+                        // header, sized from the expected duration, and filled by the trailer
+        IndexAtEnd,     // moov / cues after the media
+        Faststart,
+    };
+    // Applied by writeHeader(); NUT and other containers ignore it.
+    void setLayout(Layout layout) { layout_ = layout; }
+    // Expected duration of the output in AV_TIME_BASE units (0 = unknown), to size a
+    // reserved index. Auto only reserves for an exact one (see Demuxer::hasExactDuration()):
+    // an MP4 whose moov outgrows its reservation can't be finished. Cleared by close().
+    void setExpectedDuration(int64_t duration, bool exact) {
+        expectedDuration_ = duration;
+        expectedDurationExact_ = exact;
+    }
+
     bool open(const std::string& outputPath);
     void close();
 
@@ -21,16 +43,24 @@ public:
     bool writePacket(AVPacket* packet);
     bool writeTrailer();
 
-    int addStream(AVCodecParameters* codecParams);
+    int addStream(AVCodecParameters* codecParams, AVRational timeBase);
     int addStream(AVCodecContext* codecCtx);
     void setStreamTimeBase(int streamIndex, AVRational timeBase);
 
+    bool supportsCodec(AVCodecID codecId) const;
+
     AVFormatContext* getFormatContext() const { return fmtCtx_; }
 
 private:
     AVFormatContext* fmtCtx_ = nullptr;
     bool headerWritten_ = false;
+    Layout layout_ = Layout::Auto;
+    int64_t expectedDuration_ = 0;
+    bool expectedDurationExact_ = false;
     std::vector<int64_t> lastDts_;
     std::vector<int64_t> lastPts_;
     std::vector<AVRational> codecTimeBases_;
+
+    // Bytes to reserve for the index of `expectedDuration_` worth of the current streams.
+    int64_t estimateIndexSize(bool mp4) const;
 };
\ No newline at end of file
@@ -0,0 +1,641 @@
+#include "pixel_convert.h"
+#include <cstdint>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MF_PIXCONV_X86 1
+#include <immintrin.h>
+#endif
+
+// MSVC accepts any intrinsic in any function; GCC/Clang need the ISA enabled per function
+// so the rest of the binary keeps the baseline instruction set.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MF_TARGET(isa)
+#else
+#define MF_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// Row primitives. Counts are in output samples (or UV pairs for split/merge).
+// Narrowing rounds to nearest and saturates to 8 bits.
+struct RowKernels {
+    void (*narrow)(const uint16_t* src, uint8_t* dst, int count, int shift);
+    void (*narrowSplit)(const uint16_t* src, uint8_t* u, uint8_t* v, int pairs, int shift);
+    void (*narrowMerge)(const uint16_t* u, const uint16_t* v, uint8_t* dst, int pairs, int shift);
+    void (*split8)(const uint8_t* src, uint8_t* u, uint8_t* v, int pairs);
+    void (*merge8)(const uint8_t* u, const uint8_t* v, uint8_t* dst, int pairs);
+    void (*shift16)(const uint16_t* src, uint16_t* dst, int count, int right, int left);
+    void (*split16)(const uint16_t* src, uint16_t* u, uint16_t* v, int pairs, int right);
+    void (*merge16)(const uint16_t* u, const uint16_t* v, uint16_t* dst, int pairs, int left);
+};
+
+// ---------------------------------------------------------------------------
+// Scalar (also handles the tails of the SIMD versions)
+
+static inline uint8_t narrowSample(uint16_t value, int shift) {
+    int v = (value + (1 << (shift - 1))) >> shift;
+    return (uint8_t)(v > 255 ? 255 : v);
+}
+
+static void narrowScalar(const uint16_t* src, uint8_t* dst, int count, int shift) {
+    for (int i = 0; i < count; i++) dst[i] = narrowSample(src[i], shift);
+}
+
+static void narrowSplitScalar(const uint16_t* src, uint8_t* u, uint8_t* v, int pairs, int shift) {
+    for (int i = 0; i < pairs; i++) {
+        u[i] = narrowSample(src[2 * i], shift);
+        v[i] = narrowSample(src[2 * i + 1], shift);
+    }
+}
+
+static void narrowMergeScalar(const uint16_t* u, const uint16_t* v, uint8_t* dst, int pairs, int shift) {
+    for (int i = 0; i < pairs; i++) {
+        dst[2 * i] = narrowSample(u[i], shift);
+        dst[2 * i + 1] = narrowSample(v[i], shift);
+    }
+}
+
+static void split8Scalar(const uint8_t* src, uint8_t* u, uint8_t* v, int pairs) {
+    for (int i = 0; i < pairs; i++) {
+        u[i] = src[2 * i];
+        v[i] = src[2 * i + 1];
+    }
+}
+
+static void merge8Scalar(const uint8_t* u, const uint8_t* v, uint8_t* dst, int pairs) {
+    for (int i = 0; i < pairs; i++) {
+        dst[2 * i] = u[i];
+        dst[2 * i + 1] = v[i];
+    }
+}
+
+static void shift16Scalar(const uint16_t* src, uint16_t* dst, int count, int right, int left) {
+    for (int i = 0; i < count; i++) dst[i] = (uint16_t)((src[i] >> right) << left);
+}
+
+static void split16Scalar(const uint16_t* src, uint16_t* u, uint16_t* v, int pairs, int right) {
+    for (int i = 0; i < pairs; i++) {
+        u[i] = src[2 * i] >> right;
+        v[i] = src[2 * i + 1] >> right;
+    }
+}
+
+static void merge16Scalar(const uint16_t* u, const uint16_t* v, uint16_t* dst, int pairs, int left) {
+    for (int i = 0; i < pairs; i++) {
+        dst[2 * i] = (uint16_t)(u[i] << left);
+        dst[2 * i + 1] = (uint16_t)(v[i] << left);
+    }
+}
+
+static const RowKernels kScalarRows = {
+    narrowScalar, narrowSplitScalar, narrowMergeScalar, split8Scalar,
+    merge8Scalar, shift16Scalar, split16Scalar, merge16Scalar,
+};
+
+#ifdef MF_PIXCONV_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.1: 128-bit, packus_epi32 / cvtepu* / min_epu16
+
+MF_TARGET("sse4.1")
+static inline __m128i narrowSse41(__m128i x, __m128i round, __m128i shift) {
+    return _mm_srl_epi16(_mm_adds_epu16(x, round), shift);
+}
+
+MF_TARGET("sse4.1")
+static void narrowSse41Row(const uint16_t* src, uint8_t* dst, int count, int shift) {
+    const __m128i round = _mm_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = narrowSse41(_mm_loadu_si128((const __m128i*)(src + i)), round, sh);
+        __m128i b = narrowSse41(_mm_loadu_si128((const __m128i*)(src + i + 8)), round, sh);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+    narrowScalar(src + i, dst + i, count - i, shift);
+}
+
+MF_TARGET("sse4.1")
+static void narrowSplitSse41Row(const uint16_t* src, uint8_t* u, uint8_t* v, int pairs, int shift) {
+    const __m128i round = _mm_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m128i lo = _mm_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(src + 2 * i + 8));
+        __m128i uu = _mm_packus_epi32(_mm_and_si128(x0, lo), _mm_and_si128(x1, lo));
+        __m128i vv = _mm_packus_epi32(_mm_srli_epi32(x0, 16), _mm_srli_epi32(x1, 16));
+        __m128i packed = _mm_packus_epi16(narrowSse41(uu, round, sh), narrowSse41(vv, round, sh));
+        _mm_storel_epi64((__m128i*)(u + i), packed);
+        _mm_storel_epi64((__m128i*)(v + i), _mm_srli_si128(packed, 8));
+    }
+    narrowSplitScalar(src + 2 * i, u + i, v + i, pairs - i, shift);
+}
+
+MF_TARGET("sse4.1")
+static void narrowMergeSse41Row(const uint16_t* u, const uint16_t* v, uint8_t* dst, int pairs, int shift) {
+    const __m128i round = _mm_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m128i max8 = _mm_set1_epi16(255);
+    int i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i uu = _mm_min_epu16(narrowSse41(_mm_loadu_si128((const __m128i*)(u + i)), round, sh), max8);
+        __m128i vv = _mm_min_epu16(narrowSse41(_mm_loadu_si128((const __m128i*)(v + i)), round, sh), max8);
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_or_si128(uu, _mm_slli_epi16(vv, 8)));
+    }
+    narrowMergeScalar(u + i, v + i, dst + 2 * i, pairs - i, shift);
+}
+
+MF_TARGET("sse4.1")
+static void split8Sse41Row(const uint8_t* src, uint8_t* u, uint8_t* v, int pairs) {
+    const __m128i lo = _mm_set1_epi16(0xFF);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(src + 2 * i + 16));
+        _mm_storeu_si128((__m128i*)(u + i), _mm_packus_epi16(_mm_and_si128(x0, lo), _mm_and_si128(x1, lo)));
+        _mm_storeu_si128((__m128i*)(v + i), _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8)));
+    }
+    split8Scalar(src + 2 * i, u + i, v + i, pairs - i);
+}
+
+MF_TARGET("sse4.1")
+static void merge8Sse41Row(const uint8_t* u, const uint8_t* v, uint8_t* dst, int pairs) {
+    int i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i uu = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(u + i)));
+        __m128i vv = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(v + i)));
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_or_si128(uu, _mm_slli_epi16(vv, 8)));
+    }
+    merge8Scalar(u + i, v + i, dst + 2 * i, pairs - i);
+}
+
+MF_TARGET("sse4.1")
+static void shift16Sse41Row(const uint16_t* src, uint16_t* dst, int count, int right, int left) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_sll_epi16(_mm_srl_epi16(x, r), l));
+    }
+    shift16Scalar(src + i, dst + i, count - i, right, left);
+}
+
+MF_TARGET("sse4.1")
+static void split16Sse41Row(const uint16_t* src, uint16_t* u, uint16_t* v, int pairs, int right) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m128i lo = _mm_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i*)(src + 2 * i + 8));
+        __m128i uu = _mm_packus_epi32(_mm_and_si128(x0, lo), _mm_and_si128(x1, lo));
+        __m128i vv = _mm_packus_epi32(_mm_srli_epi32(x0, 16), _mm_srli_epi32(x1, 16));
+        _mm_storeu_si128((__m128i*)(u + i), _mm_srl_epi16(uu, r));
+        _mm_storeu_si128((__m128i*)(v + i), _mm_srl_epi16(vv, r));
+    }
+    split16Scalar(src + 2 * i, u + i, v + i, pairs - i, right);
+}
+
+MF_TARGET("sse4.1")
+static void merge16Sse41Row(const uint16_t* u, const uint16_t* v, uint16_t* dst, int pairs, int left) {
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 4 <= pairs; i += 4) {
+        __m128i uu = _mm_cvtepu16_epi32(_mm_sll_epi16(_mm_loadl_epi64((const __m128i*)(u + i)), l));
+        __m128i vv = _mm_cvtepu16_epi32(_mm_sll_epi16(_mm_loadl_epi64((const __m128i*)(v + i)), l));
+        _mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_or_si128(uu, _mm_slli_epi32(vv, 16)));
+    }
+    merge16Scalar(u + i, v + i, dst + 2 * i, pairs - i, left);
+}
+
+static const RowKernels kSse41Rows = {
+    narrowSse41Row, narrowSplitSse41Row, narrowMergeSse41Row, split8Sse41Row,
+    merge8Sse41Row, shift16Sse41Row, split16Sse41Row, merge16Sse41Row,
+};
+
+// ---------------------------------------------------------------------------
+// AVX2: same shapes as SSE4.1 on 256 bits. The pack instructions work per 128-bit lane,
+// so their results are put back in order with permute4x64(0xD8).
+
+MF_TARGET("avx2")
+static inline __m256i narrowAvx2(__m256i x, __m256i round, __m128i shift) {
+    return _mm256_srl_epi16(_mm256_adds_epu16(x, round), shift);
+}
+
+MF_TARGET("avx2")
+static void narrowAvx2Row(const uint16_t* src, uint8_t* dst, int count, int shift) {
+    const __m256i round = _mm256_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = narrowAvx2(_mm256_loadu_si256((const __m256i*)(src + i)), round, sh);
+        __m256i b = narrowAvx2(_mm256_loadu_si256((const __m256i*)(src + i + 16)), round, sh);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    narrowScalar(src + i, dst + i, count - i, shift);
+}
+
+MF_TARGET("avx2")
+static void narrowSplitAvx2Row(const uint16_t* src, uint8_t* u, uint8_t* v, int pairs, int shift) {
+    const __m256i round = _mm256_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m256i lo = _mm256_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(src + 2 * i + 16));
+        __m256i uu = _mm256_packus_epi32(_mm256_and_si256(x0, lo), _mm256_and_si256(x1, lo));
+        __m256i vv = _mm256_packus_epi32(_mm256_srli_epi32(x0, 16), _mm256_srli_epi32(x1, 16));
+        uu = narrowAvx2(_mm256_permute4x64_epi64(uu, 0xD8), round, sh);
+        vv = narrowAvx2(_mm256_permute4x64_epi64(vv, 0xD8), round, sh);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(uu, vv), 0xD8);
+        _mm_storeu_si128((__m128i*)(u + i), _mm256_castsi256_si128(packed));
+        _mm_storeu_si128((__m128i*)(v + i), _mm256_extracti128_si256(packed, 1));
+    }
+    narrowSplitScalar(src + 2 * i, u + i, v + i, pairs - i, shift);
+}
+
+MF_TARGET("avx2")
+static void narrowMergeAvx2Row(const uint16_t* u, const uint16_t* v, uint8_t* dst, int pairs, int shift) {
+    const __m256i round = _mm256_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m256i max8 = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m256i uu = _mm256_min_epu16(narrowAvx2(_mm256_loadu_si256((const __m256i*)(u + i)), round, sh), max8);
+        __m256i vv = _mm256_min_epu16(narrowAvx2(_mm256_loadu_si256((const __m256i*)(v + i)), round, sh), max8);
+        _mm256_storeu_si256((__m256i*)(dst + 2 * i), _mm256_or_si256(uu, _mm256_slli_epi16(vv, 8)));
+    }
+    narrowMergeScalar(u + i, v + i, dst + 2 * i, pairs - i, shift);
+}
+
+MF_TARGET("avx2")
+static void split8Avx2Row(const uint8_t* src, uint8_t* u, uint8_t* v, int pairs) {
+    const __m256i lo = _mm256_set1_epi16(0xFF);
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(src + 2 * i + 32));
+        __m256i uu = _mm256_packus_epi16(_mm256_and_si256(x0, lo), _mm256_and_si256(x1, lo));
+        __m256i vv = _mm256_packus_epi16(_mm256_srli_epi16(x0, 8), _mm256_srli_epi16(x1, 8));
+        _mm256_storeu_si256((__m256i*)(u + i), _mm256_permute4x64_epi64(uu, 0xD8));
+        _mm256_storeu_si256((__m256i*)(v + i), _mm256_permute4x64_epi64(vv, 0xD8));
+    }
+    split8Scalar(src + 2 * i, u + i, v + i, pairs - i);
+}
+
+MF_TARGET("avx2")
+static void merge8Avx2Row(const uint8_t* u, const uint8_t* v, uint8_t* dst, int pairs) {
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m256i uu = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(u + i)));
+        __m256i vv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(v + i)));
+        _mm256_storeu_si256((__m256i*)(dst + 2 * i), _mm256_or_si256(uu, _mm256_slli_epi16(vv, 8)));
+    }
+    merge8Scalar(u + i, v + i, dst + 2 * i, pairs - i);
+}
+
+MF_TARGET("avx2")
+static void shift16Avx2Row(const uint16_t* src, uint16_t* dst, int count, int right, int left) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_sll_epi16(_mm256_srl_epi16(x, r), l));
+    }
+    shift16Scalar(src + i, dst + i, count - i, right, left);
+}
+
+MF_TARGET("avx2")
+static void split16Avx2Row(const uint16_t* src, uint16_t* u, uint16_t* v, int pairs, int right) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m256i lo = _mm256_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(src + 2 * i + 16));
+        __m256i uu = _mm256_packus_epi32(_mm256_and_si256(x0, lo), _mm256_and_si256(x1, lo));
+        __m256i vv = _mm256_packus_epi32(_mm256_srli_epi32(x0, 16), _mm256_srli_epi32(x1, 16));
+        _mm256_storeu_si256((__m256i*)(u + i), _mm256_srl_epi16(_mm256_permute4x64_epi64(uu, 0xD8), r));
+        _mm256_storeu_si256((__m256i*)(v + i), _mm256_srl_epi16(_mm256_permute4x64_epi64(vv, 0xD8), r));
+    }
+    split16Scalar(src + 2 * i, u + i, v + i, pairs - i, right);
+}
+
+MF_TARGET("avx2")
+static void merge16Avx2Row(const uint16_t* u, const uint16_t* v, uint16_t* dst, int pairs, int left) {
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 8 <= pairs; i += 8) {
+        __m256i uu = _mm256_cvtepu16_epi32(_mm_sll_epi16(_mm_loadu_si128((const __m128i*)(u + i)), l));
+        __m256i vv = _mm256_cvtepu16_epi32(_mm_sll_epi16(_mm_loadu_si128((const __m128i*)(v + i)), l));
+        _mm256_storeu_si256((__m256i*)(dst + 2 * i), _mm256_or_si256(uu, _mm256_slli_epi32(vv, 16)));
+    }
+    merge16Scalar(u + i, v + i, dst + 2 * i, pairs - i, left);
+}
+
+static const RowKernels kAvx2Rows = {
+    narrowAvx2Row, narrowSplitAvx2Row, narrowMergeAvx2Row, split8Avx2Row,
+    merge8Avx2Row, shift16Avx2Row, split16Avx2Row, merge16Avx2Row,
+};
+
+// ---------------------------------------------------------------------------
+// AVX-512 (F + BW): the down-converting moves (vpmovwb / vpmovdw / vpmovdb) keep element
+// order, so no lane fix-ups are needed.
+
+#define MF_AVX512 "avx512f,avx512bw"
+
+MF_TARGET(MF_AVX512)
+static inline __m512i narrowAvx512(__m512i x, __m512i round, __m128i shift, __m512i max8) {
+    return _mm512_min_epu16(_mm512_srl_epi16(_mm512_adds_epu16(x, round), shift), max8);
+}
+
+MF_TARGET(MF_AVX512)
+static void narrowAvx512Row(const uint16_t* src, uint8_t* dst, int count, int shift) {
+    const __m512i round = _mm512_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m512i max8 = _mm512_set1_epi16(255);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512i x = narrowAvx512(_mm512_loadu_si512((const void*)(src + i)), round, sh, max8);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm512_cvtepi16_epi8(x));
+    }
+    narrowScalar(src + i, dst + i, count - i, shift);
+}
+
+MF_TARGET(MF_AVX512)
+static void narrowSplitAvx512Row(const uint16_t* src, uint8_t* u, uint8_t* v, int pairs, int shift) {
+    const __m512i round = _mm512_set1_epi32(1 << (shift - 1));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m512i max8 = _mm512_set1_epi32(255);
+    const __m512i lo = _mm512_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(src + 2 * i));
+        __m512i uu = _mm512_and_si512(x, lo);
+        __m512i vv = _mm512_srli_epi32(x, 16);
+        uu = _mm512_min_epu32(_mm512_srl_epi32(_mm512_add_epi32(uu, round), sh), max8);
+        vv = _mm512_min_epu32(_mm512_srl_epi32(_mm512_add_epi32(vv, round), sh), max8);
+        _mm_storeu_si128((__m128i*)(u + i), _mm512_cvtepi32_epi8(uu));
+        _mm_storeu_si128((__m128i*)(v + i), _mm512_cvtepi32_epi8(vv));
+    }
+    narrowSplitScalar(src + 2 * i, u + i, v + i, pairs - i, shift);
+}
+
+MF_TARGET(MF_AVX512)
+static void narrowMergeAvx512Row(const uint16_t* u, const uint16_t* v, uint8_t* dst, int pairs, int shift) {
+    const __m512i round = _mm512_set1_epi16((short)(1 << (shift - 1)));
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m512i max8 = _mm512_set1_epi16(255);
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m512i uu = narrowAvx512(_mm512_loadu_si512((const void*)(u + i)), round, sh, max8);
+        __m512i vv = narrowAvx512(_mm512_loadu_si512((const void*)(v + i)), round, sh, max8);
+        _mm512_storeu_si512((void*)(dst + 2 * i), _mm512_or_si512(uu, _mm512_slli_epi16(vv, 8)));
+    }
+    narrowMergeScalar(u + i, v + i, dst + 2 * i, pairs - i, shift);
+}
+
+MF_TARGET(MF_AVX512)
+static void split8Avx512Row(const uint8_t* src, uint8_t* u, uint8_t* v, int pairs) {
+    const __m512i lo = _mm512_set1_epi16(0xFF);
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m512i x = _mm512_loadu_si512((const void*)(src + 2 * i));
+        _mm256_storeu_si256((__m256i*)(u + i), _mm512_cvtepi16_epi8(_mm512_and_si512(x, lo)));
+        _mm256_storeu_si256((__m256i*)(v + i), _mm512_cvtepi16_epi8(_mm512_srli_epi16(x, 8)));
+    }
+    split8Scalar(src + 2 * i, u + i, v + i, pairs - i);
+}
+
+MF_TARGET(MF_AVX512)
+static void merge8Avx512Row(const uint8_t* u, const uint8_t* v, uint8_t* dst, int pairs) {
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m512i uu = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(u + i)));
+        __m512i vv = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(v + i)));
+        _mm512_storeu_si512((void*)(dst + 2 * i), _mm512_or_si512(uu, _mm512_slli_epi16(vv, 8)));
+    }
+    merge8Scalar(u + i, v + i, dst + 2 * i, pairs - i);
+}
+
+MF_TARGET(MF_AVX512)
+static void shift16Avx512Row(const uint16_t* src, uint16_t* dst, int count, int right, int left) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512i x = _mm512_loadu_si512((const void*)(src + i));
+        _mm512_storeu_si512((void*)(dst + i), _mm512_sll_epi16(_mm512_srl_epi16(x, r), l));
+    }
+    shift16Scalar(src + i, dst + i, count - i, right, left);
+}
+
+MF_TARGET(MF_AVX512)
+static void split16Avx512Row(const uint16_t* src, uint16_t* u, uint16_t* v, int pairs, int right) {
+    const __m128i r = _mm_cvtsi32_si128(right);
+    const __m512i lo = _mm512_set1_epi32(0xFFFF);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(src + 2 * i));
+        __m256i uu = _mm512_cvtepi32_epi16(_mm512_and_si512(x, lo));
+        __m256i vv = _mm512_cvtepi32_epi16(_mm512_srli_epi32(x, 16));
+        _mm256_storeu_si256((__m256i*)(u + i), _mm256_srl_epi16(uu, r));
+        _mm256_storeu_si256((__m256i*)(v + i), _mm256_srl_epi16(vv, r));
+    }
+    split16Scalar(src + 2 * i, u + i, v + i, pairs - i, right);
+}
+
+MF_TARGET(MF_AVX512)
+static void merge16Avx512Row(const uint16_t* u, const uint16_t* v, uint16_t* dst, int pairs, int left) {
+    const __m128i l = _mm_cvtsi32_si128(left);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m512i uu = _mm512_cvtepu16_epi32(_mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(u + i)), l));
+        __m512i vv = _mm512_cvtepu16_epi32(_mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(v + i)), l));
+        _mm512_storeu_si512((void*)(dst + 2 * i), _mm512_or_si512(uu, _mm512_slli_epi32(vv, 16)));
+    }
+    merge16Scalar(u + i, v + i, dst + 2 * i, pairs - i, left);
+}
+
+static const RowKernels kAvx512Rows = {
+    narrowAvx512Row, narrowSplitAvx512Row, narrowMergeAvx512Row, split8Avx512Row,
+    merge8Avx512Row, shift16Avx512Row, split16Avx512Row, merge16Avx512Row,
+};
+
+#endif // MF_PIXCONV_X86
+
+// ---------------------------------------------------------------------------
+// Frame-level conversions, all 4:2:0 with identical source and destination size.
+
+template <typename T>
+static inline const T* srcRow(const AVFrame* frame, int plane, int y) {
+    return (const T*)(frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane]);
+}
+
+template <typename T>
+static inline T* dstRow(AVFrame* frame, int plane, int y) {
+    return (T*)(frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane]);
+}
+
+static inline int chromaWidth(const AVFrame* frame) { return (frame->width + 1) / 2; }
+static inline int chromaHeight(const AVFrame* frame) { return (frame->height + 1) / 2; }
+
+static void copyLuma8(const AVFrame* src, AVFrame* dst) {
+    for (int y = 0; y < src->height; y++) {
+        memcpy(dstRow<uint8_t>(dst, 0, y), srcRow<uint8_t>(src, 0, y), src->width);
+    }
+}
+
+static void narrowLuma(const RowKernels& rows, const AVFrame* src, AVFrame* dst, int shift) {
+    for (int y = 0; y < src->height; y++) {
+        rows.narrow(srcRow<uint16_t>(src, 0, y), dstRow<uint8_t>(dst, 0, y), src->width, shift);
+    }
+}
+
+static void shiftLuma(const RowKernels& rows, const AVFrame* src, AVFrame* dst, int right, int left) {
+    for (int y = 0; y < src->height; y++) {
+        rows.shift16(srcRow<uint16_t>(src, 0, y), dstRow<uint16_t>(dst, 0, y), src->width, right, left);
+    }
+}
+
+static void nv12ToYuv420p(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    copyLuma8(src, dst);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.split8(srcRow<uint8_t>(src, 1, y), dstRow<uint8_t>(dst, 1, y), dstRow<uint8_t>(dst, 2, y), chromaWidth(src));
+    }
+}
+
+static void yuv420pToNv12(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    copyLuma8(src, dst);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.merge8(srcRow<uint8_t>(src, 1, y), srcRow<uint8_t>(src, 2, y), dstRow<uint8_t>(dst, 1, y), chromaWidth(src));
+    }
+}
+
+// P010 keeps its 10 significant bits at the top of each 16-bit word.
+static void p010ToYuv420p(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    narrowLuma(rows, src, dst, 8);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.narrowSplit(srcRow<uint16_t>(src, 1, y), dstRow<uint8_t>(dst, 1, y), dstRow<uint8_t>(dst, 2, y), chromaWidth(src), 8);
+    }
+}
+
+static void p010ToNv12(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    narrowLuma(rows, src, dst, 8);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.narrow(srcRow<uint16_t>(src, 1, y), dstRow<uint8_t>(dst, 1, y), chromaWidth(src) * 2, 8);
+    }
+}
+
+static void p010ToYuv420p10(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    shiftLuma(rows, src, dst, 6, 0);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.split16(srcRow<uint16_t>(src, 1, y), dstRow<uint16_t>(dst, 1, y), dstRow<uint16_t>(dst, 2, y), chromaWidth(src), 6);
+    }
+}
+
+static void yuv420p10ToYuv420p(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    narrowLuma(rows, src, dst, 2);
+    for (int plane = 1; plane <= 2; plane++) {
+        for (int y = 0; y < chromaHeight(src); y++) {
+            rows.narrow(srcRow<uint16_t>(src, plane, y), dstRow<uint8_t>(dst, plane, y), chromaWidth(src), 2);
+        }
+    }
+}
+
+static void yuv420p10ToNv12(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    narrowLuma(rows, src, dst, 2);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.narrowMerge(srcRow<uint16_t>(src, 1, y), srcRow<uint16_t>(src, 2, y), dstRow<uint8_t>(dst, 1, y), chromaWidth(src), 2);
+    }
+}
+
+static void yuv420p10ToP010(const RowKernels& rows, const AVFrame* src, AVFrame* dst) {
+    shiftLuma(rows, src, dst, 0, 6);
+    for (int y = 0; y < chromaHeight(src); y++) {
+        rows.merge16(srcRow<uint16_t>(src, 1, y), srcRow<uint16_t>(src, 2, y), dstRow<uint16_t>(dst, 1, y), chromaWidth(src), 6);
+    }
+}
+
+struct PairEntry {
+    AVPixelFormat srcFmt;
+    AVPixelFormat dstFmt;
+    void (*convert)(const RowKernels& rows, const AVFrame* src, AVFrame* dst);
+};
+
+static const PairEntry kPairs[] = {
+    {AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P,     nv12ToYuv420p},
+    {AV_PIX_FMT_YUV420P,     AV_PIX_FMT_NV12,        yuv420pToNv12},
+    {AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P,     p010ToYuv420p},
+    {AV_PIX_FMT_P010LE,      AV_PIX_FMT_NV12,        p010ToNv12},
+    {AV_PIX_FMT_P010LE,      AV_PIX_FMT_YUV420P10LE, p010ToYuv420p10},
+    {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P,     yuv420p10ToYuv420p},
+    {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_NV12,        yuv420p10ToNv12},
+    {AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_P010LE,      yuv420p10ToP010},
+};
+
+SimdLevel PixelConvert::cpuLevel() {
+#ifdef MF_PIXCONV_X86
+    int flags = av_get_cpu_flags();
+    if (flags & AV_CPU_FLAG_AVX512) return SimdLevel::AVX512;
+    if (flags & AV_CPU_FLAG_AVX2) return SimdLevel::AVX2;
+    if (flags & AV_CPU_FLAG_SSE4) return SimdLevel::SSE41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+const char* PixelConvert::levelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE41: return "sse4.1";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+static const RowKernels* rowsForLevel(SimdLevel level) {
+#ifdef MF_PIXCONV_X86
+    switch (level) {
+        case SimdLevel::AVX512: return &kAvx512Rows;
+        case SimdLevel::AVX2: return &kAvx2Rows;
+        case SimdLevel::SSE41: return &kSse41Rows;
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return &kScalarRows;
+}
+
+PixelKernel PixelConvert::find(AVPixelFormat srcFmt, AVPixelFormat dstFmt, SimdLevel maxLevel) {
+    PixelKernel kernel;
+    for (const auto& pair : kPairs) {
+        if (pair.srcFmt != srcFmt || pair.dstFmt != dstFmt) continue;
+
+        SimdLevel level = maxLevel < cpuLevel() ? maxLevel : cpuLevel();
+        kernel.srcFmt = srcFmt;
+        kernel.dstFmt = dstFmt;
+        kernel.level = level;
+        kernel.convert = pair.convert;
+        kernel.rows = rowsForLevel(level);
+        break;
+    }
+    return kernel;
+}
+
+std::vector<std::pair<AVPixelFormat, AVPixelFormat>> PixelConvert::supportedPairs() {
+    std::vector<std::pair<AVPixelFormat, AVPixelFormat>> pairs;
+    for (const auto& pair : kPairs) {
+        pairs.emplace_back(pair.srcFmt, pair.dstFmt);
+    }
+    return pairs;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+enum class SimdLevel { Scalar, SSE41, AVX2, AVX512 };
+
+struct RowKernels;
+
+// A hand-written same-size conversion for one (source, destination) format pair at one SIMD level.
+// Both frames must already be allocated with the expected formats and dimensions.
+struct PixelKernel {
+    AVPixelFormat srcFmt = AV_PIX_FMT_NONE;
+    AVPixelFormat dstFmt = AV_PIX_FMT_NONE;
+    SimdLevel level = SimdLevel::Scalar;
+    void (*convert)(const RowKernels& rows, const AVFrame* src, AVFrame* dst) = nullptr;
+    const RowKernels* rows = nullptr;
+
+    bool valid() const { return convert != nullptr; }
+    void run(const AVFrame* src, AVFrame* dst) const { convert(*rows, src, dst); }
+};
+
+// Fast paths for the conversions the transcoder actually hits: NV12 / P010 / yuv420p10 decoder
+// output into yuv420p, nv12 or 10-bit encoder input. Everything else goes through swscale.
+class PixelConvert {
+public:
+    // Highest level both compiled in and reported by av_get_cpu_flags().
+    static SimdLevel cpuLevel();
+    static const char* levelName(SimdLevel level);
+
+    // Fastest kernel for the pair at or below maxLevel; invalid if the pair has no fast path.
+    static PixelKernel find(AVPixelFormat srcFmt, AVPixelFormat dstFmt, SimdLevel maxLevel = cpuLevel());
+    static std::vector<std::pair<AVPixelFormat, AVPixelFormat>> supportedPairs();
+};
@@ -0,0 +1,245 @@
+#include "prefetch_reader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+extern "C" {
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+namespace fs = std::filesystem;
+
+// AVIOContext's own buffer; FFmpeg's file protocol uses 32 KB.
+static const int kIoBufferSize = 64 * 1024;
+// The read-ahead thread waits for at least this much free space (or a quarter of the
+// ring, if smaller) so storage sees few large requests rather than many small ones.
+static const size_t kMinReadSize = 1024 * 1024;
+static const size_t kMaxReadSize = 4 * 1024 * 1024;
+static const size_t kMinBufferSize = 256 * 1024;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+
+static FILE* openFile(const std::string& path) {
+    return _wfopen(Utf8ToWide(path).c_str(), L"rb");
+}
+
+static int seekFile(FILE* f, int64_t offset) {
+    return _fseeki64(f, offset, SEEK_SET);
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+
+static FILE* openFile(const std::string& path) {
+    return fopen(path.c_str(), "rb");
+}
+
+static int seekFile(FILE* f, int64_t offset) {
+    return fseeko(f, (off_t)offset, SEEK_SET);
+}
+#endif
+
+PrefetchReader::~PrefetchReader() {
+    close();
+}
+
+bool PrefetchReader::open(const std::string& path, size_t bufferBytes, const AVIOInterruptCB& interrupt) {
+    close();
+
+    file_ = openFile(path);
+    if (!file_) return false;
+    // Reads are already large; stdio's buffer would only add a copy.
+    setvbuf(file_, nullptr, _IONBF, 0);
+
+    path_ = path;
+    interrupt_ = interrupt;
+    ring_.resize(std::max(bufferBytes, kMinBufferSize));
+    head_ = 0;
+    filled_ = 0;
+    position_ = 0;
+    generation_ = 0;
+    eof_ = false;
+    error_ = 0;
+    stop_ = false;
+    stats_ = Stats();
+
+    unsigned char* ioBuffer = (unsigned char*)av_malloc(kIoBufferSize);
+    ioContext_ = avio_alloc_context(ioBuffer, kIoBufferSize, 0, this, &PrefetchReader::readPacket, nullptr,
+                                    &PrefetchReader::seekPacket);
+    if (!ioContext_) {
+        av_free(ioBuffer);
+        close();
+        return false;
+    }
+
+    thread_ = std::thread(&PrefetchReader::readAhead, this);
+    return true;
+}
+
+void PrefetchReader::close() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        spaceReady_.notify_all();
+        dataReady_.notify_all();
+        thread_.join();
+    }
+    if (ioContext_) {
+        av_freep(&ioContext_->buffer);
+        avio_context_free(&ioContext_);
+    }
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    ring_.clear();
+    ring_.shrink_to_fit();
+}
+
+PrefetchReader::Stats PrefetchReader::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void PrefetchReader::readAhead() {
+    const size_t capacity = ring_.size();
+    const size_t minRead = std::min(kMinReadSize, capacity / 4);
+    int64_t filePosition = 0;   // Where the FILE stands; -1 after a failed seek
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        spaceReady_.wait(lock, [&] { return stop_ || (!eof_ && error_ == 0 && capacity - filled_ >= minRead); });
+        if (stop_) break;
+
+        // Fill the free space after the buffered data, up to the end of the ring. The
+        // consumer never touches that region, so the read itself runs unlocked.
+        uint64_t generation = generation_;
+        int64_t offset = position_ + (int64_t)filled_;
+        size_t tail = (head_ + filled_) % capacity;
+        size_t span = std::min({capacity - filled_, capacity - tail, kMaxReadSize});
+        lock.unlock();
+
+        size_t got = 0;
+        int error = 0;
+        if (filePosition != offset && seekFile(file_, offset) != 0) {
+            error = AVERROR(EIO);
+            filePosition = -1;
+        } else {
+            got = fread(&ring_[tail], 1, span, file_);
+            filePosition = offset + (int64_t)got;
+            if (got < span && ferror(file_)) {
+                error = AVERROR(EIO);
+                clearerr(file_);
+                filePosition = -1;
+            }
+        }
+
+        lock.lock();
+        if (generation != generation_) continue;   // A seek dropped what this read was for
+        filled_ += got;
+        if (error != 0) {
+            error_ = error;
+        } else if (got < span) {
+            eof_ = true;
+        }
+        dataReady_.notify_all();
+    }
+}
+
+int PrefetchReader::read(uint8_t* buf, int size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (filled_ == 0 && !eof_ && error_ == 0) {
+        stats_.stalls++;
+        auto start = std::chrono::steady_clock::now();
+        while (filled_ == 0 && !eof_ && error_ == 0 && !stop_) {
+            if (interrupt_.callback && interrupt_.callback(interrupt_.opaque)) return AVERROR_EXIT;
+            dataReady_.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        stats_.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (filled_ == 0) return error_ != 0 ? error_ : AVERROR_EOF;
+
+    const size_t capacity = ring_.size();
+    size_t count = std::min((size_t)size, filled_);
+    size_t first = std::min(count, capacity - head_);
+    memcpy(buf, &ring_[head_], first);
+    if (count > first) memcpy(buf + first, &ring_[0], count - first);
+    head_ = (head_ + count) % capacity;
+    filled_ -= count;
+    position_ += (int64_t)count;
+    stats_.bytesRead += count;
+    spaceReady_.notify_one();
+    return (int)count;
+}
+
+int64_t PrefetchReader::fileSize() {
+    std::error_code ec;
+    uintmax_t size = fs::file_size(Utf8ToPath(path_), ec);
+    return ec ? AVERROR(EIO) : (int64_t)size;
+}
+
+int64_t PrefetchReader::seek(int64_t offset, int whence) {
+    if (whence & AVSEEK_SIZE) return fileSize();
+    whence &= ~AVSEEK_FORCE;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t target;
+    if (whence == SEEK_SET) {
+        target = offset;
+    } else if (whence == SEEK_CUR) {
+        target = position_ + offset;
+    } else if (whence == SEEK_END) {
+        int64_t size = fileSize();
+        if (size < 0) return size;
+        target = size + offset;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    if (target < 0) return AVERROR(EINVAL);
+
+    if (target >= position_ && target <= position_ + (int64_t)filled_) {
+        // Already buffered: skip to it.
+        size_t skip = (size_t)(target - position_);
+        head_ = (head_ + skip) % ring_.size();
+        filled_ -= skip;
+    } else {
+        generation_++;
+        head_ = 0;
+        filled_ = 0;
+        eof_ = false;
+        error_ = 0;
+        stats_.refills++;
+    }
+    position_ = target;
+    spaceReady_.notify_one();
+    return target;
+}
+
+int PrefetchReader::readPacket(void* opaque, uint8_t* buf, int size) {
+    return static_cast<PrefetchReader*>(opaque)->read(buf, size);
+}
+
+int64_t PrefetchReader::seekPacket(void* opaque, int64_t offset, int whence) {
+    return static_cast<PrefetchReader*>(opaque)->seek(offset, whence);
+}
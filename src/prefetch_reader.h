@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+// Reads a file ahead of its consumer on a background thread into a ring buffer, and
+// serves it to FFmpeg through a custom AVIOContext. Sequential reads are answered from
+// memory while the thread keeps the buffer topped up in large requests, so a demuxer
+// only waits on storage when it consumes faster than the storage delivers. A seek inside
+// the buffered window just skips ahead; any other seek drops the buffer and restarts the
+// read-ahead at the new position.
+class PrefetchReader {
+public:
+    struct Stats {
+        uint64_t bytesRead = 0;     // Bytes delivered to the consumer
+        uint64_t stalls = 0;        // Reads that found the buffer empty and had to wait
+        double stallSeconds = 0.0;
+        uint64_t refills = 0;       // Seeks outside the buffer
+    };
+
+    PrefetchReader() = default;
+    ~PrefetchReader();
+    PrefetchReader(const PrefetchReader&) = delete;
+    PrefetchReader& operator=(const PrefetchReader&) = delete;
+
+    // Waits are cut short when `interrupt` fires, like FFmpeg's own blocking I/O.
+    bool open(const std::string& path, size_t bufferBytes, const AVIOInterruptCB& interrupt);
+    void close();
+
+    // Owned by the reader and freed by close(); install it as AVFormatContext::pb together
+    // with AVFMT_FLAG_CUSTOM_IO.
+    AVIOContext* ioContext() const { return ioContext_; }
+    Stats stats();
+
+private:
+    FILE* file_ = nullptr;
+    AVIOContext* ioContext_ = nullptr;
+    AVIOInterruptCB interrupt_ = {nullptr, nullptr};
+    std::string path_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable dataReady_;     // Consumer waits here
+    std::condition_variable spaceReady_;    // Read-ahead thread waits here
+    std::vector<uint8_t> ring_;
+    size_t head_ = 0;               // Ring index of the next byte to deliver
+    size_t filled_ = 0;             // Buffered bytes from head_
+    int64_t position_ = 0;          // File offset of head_
+    uint64_t generation_ = 0;       // Bumped by seeks that drop the buffer
+    bool eof_ = false;
+    int error_ = 0;
+    bool stop_ = false;
+    Stats stats_;
+
+    void readAhead();
+    int read(uint8_t* buf, int size);
+    int64_t seek(int64_t offset, int whence);
+    int64_t fileSize();
+
+    static int readPacket(void* opaque, uint8_t* buf, int size);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+};
@@ -0,0 +1,304 @@
+#include "seek_index.h"
+#include "demuxer.h"
+#include "transcode_control.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Sidecar layout, all integers little-endian:
+//   "MFIDX001" <i64 input size> <i64 input mtime> <u32 streams>
+//   per stream: <i32 media type> <i32 tb num> <i32 tb den> <u32 entries>, then per entry
+//   <u8 flags> [zigzag varint pts delta] [zigzag varint dts delta] <zigzag varint pos delta>
+//   <varint size>, deltas against the stream's previous present value.
+static const char kMagic[8] = {'M', 'F', 'I', 'D', 'X', '0', '0', '1'};
+static const uint8_t kFlagKeyframe = 1;
+static const uint8_t kFlagNoPts = 2;
+static const uint8_t kFlagNoDts = 4;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(Utf8ToWide(str));
+}
+
+static FILE* openFile(const std::string& path, const char* mode) {
+    std::wstring wideMode(mode, mode + strlen(mode));
+    return _wfopen(Utf8ToWide(path).c_str(), wideMode.c_str());
+}
+#else
+static fs::path Utf8ToPath(const std::string& str) {
+    return fs::path(str);
+}
+
+static FILE* openFile(const std::string& path, const char* mode) {
+    return fopen(path.c_str(), mode);
+}
+#endif
+
+static void putFixed(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static void putSigned(std::vector<uint8_t>& out, int64_t value) {
+    putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+// Bounds-checked reader over the sidecar's bytes; any overrun marks it failed.
+struct ByteReader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+    bool failed = false;
+
+    uint64_t fixed(int bytes) {
+        if (size - offset < (size_t)bytes) {
+            failed = true;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= (uint64_t)data[offset + i] << (8 * i);
+        offset += bytes;
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (offset >= size) break;
+            uint8_t byte = data[offset++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t signedVarint() {
+        uint64_t value = varint();
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+};
+
+std::string SeekIndex::sidecarPath(const std::string& inputPath) {
+    return inputPath + ".mfidx";
+}
+
+bool SeekIndex::fileStamp(const std::string& inputPath, int64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    fs::path p = Utf8ToPath(inputPath);
+    uintmax_t fileSize = fs::file_size(p, ec);
+    if (ec) return false;
+    auto writeTime = fs::last_write_time(p, ec);
+    if (ec) return false;
+    size = (int64_t)fileSize;
+    mtime = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+size_t SeekIndex::packetCount() const {
+    size_t count = 0;
+    for (const auto& stream : streams_) count += stream.entries.size();
+    return count;
+}
+
+void SeekIndex::sortKeyframes() {
+    for (auto& stream : streams_) {
+        stream.keyframes.clear();
+        for (size_t i = 0; i < stream.entries.size(); i++) {
+            const Entry& entry = stream.entries[i];
+            if (entry.keyframe && entryTime(entry) != AV_NOPTS_VALUE) stream.keyframes.push_back((uint32_t)i);
+        }
+        std::stable_sort(stream.keyframes.begin(), stream.keyframes.end(), [&](uint32_t a, uint32_t b) {
+            return entryTime(stream.entries[a]) < entryTime(stream.entries[b]);
+        });
+    }
+}
+
+const SeekIndex::Entry* SeekIndex::keyframeBefore(int streamIndex, int64_t timestamp) const {
+    if (streamIndex < 0 || streamIndex >= (int)streams_.size()) return nullptr;
+    const Stream& stream = streams_[streamIndex];
+    if (stream.keyframes.empty()) return nullptr;
+
+    auto it = std::upper_bound(stream.keyframes.begin(), stream.keyframes.end(), timestamp,
+                               [&](int64_t t, uint32_t i) { return t < entryTime(stream.entries[i]); });
+    if (it != stream.keyframes.begin()) --it;
+    return &stream.entries[*it];
+}
+
+std::shared_ptr<SeekIndex> SeekIndex::build(const std::string& inputPath, TranscodeControl* control) {
+    auto index = std::make_shared<SeekIndex>();
+    if (!fileStamp(inputPath, index->fileSize_, index->fileMtime_)) return nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    Demuxer demuxer;
+    // Only packet headers are needed, never the decoders' view of the streams.
+    demuxer.setProbe(Demuxer::Probe::Header);
+    if (control) demuxer.setInterruptCallback(&TranscodeControl::interruptCallback, control);
+    if (!demuxer.open(inputPath)) return nullptr;
+
+    AVFormatContext* fmtCtx = demuxer.getFormatContext();
+    index->streams_.resize(fmtCtx->nb_streams);
+    for (unsigned int i = 0; i < fmtCtx->nb_streams; i++) {
+        index->streams_[i].type = fmtCtx->streams[i]->codecpar->codec_type;
+        index->streams_[i].timeBase = fmtCtx->streams[i]->time_base;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    bool cancelled = false;
+    while (demuxer.readPacket(packet)) {
+        if (control && !control->checkpoint()) {
+            av_packet_unref(packet);
+            cancelled = true;
+            break;
+        }
+        // Streams that appear mid-file (e.g. in MPEG-TS) have no entry in the header's list.
+        if (packet->stream_index < (int)index->streams_.size()) {
+            Entry entry;
+            entry.pts = packet->pts;
+            entry.dts = packet->dts;
+            entry.pos = packet->pos;
+            entry.size = packet->size;
+            entry.keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+            index->streams_[packet->stream_index].entries.push_back(entry);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    if (cancelled || (control && control->isCancelled())) return nullptr;
+
+    index->sortKeyframes();
+    size_t keyframes = 0;
+    for (const auto& stream : index->streams_) keyframes += stream.keyframes.size();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[SeekIndex] Indexed " << index->packetCount() << " packets (" << keyframes << " keyframes) in "
+              << (int)(seconds * 1000.0) << " ms" << std::endl;
+    return index;
+}
+
+bool SeekIndex::save(const std::string& inputPath) const {
+    std::vector<uint8_t> out;
+    out.reserve(64 + packetCount() * 8);
+    out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
+    putFixed(out, (uint64_t)fileSize_, 8);
+    putFixed(out, (uint64_t)fileMtime_, 8);
+    putFixed(out, streams_.size(), 4);
+    for (const auto& stream : streams_) {
+        putFixed(out, (uint32_t)(int32_t)stream.type, 4);
+        putFixed(out, (uint32_t)stream.timeBase.num, 4);
+        putFixed(out, (uint32_t)stream.timeBase.den, 4);
+        putFixed(out, stream.entries.size(), 4);
+
+        int64_t lastPts = 0, lastDts = 0, lastPos = 0;
+        for (const auto& entry : stream.entries) {
+            uint8_t flags = (entry.keyframe ? kFlagKeyframe : 0) | (entry.pts == AV_NOPTS_VALUE ? kFlagNoPts : 0) |
+                            (entry.dts == AV_NOPTS_VALUE ? kFlagNoDts : 0);
+            out.push_back(flags);
+            if (entry.pts != AV_NOPTS_VALUE) {
+                putSigned(out, entry.pts - lastPts);
+                lastPts = entry.pts;
+            }
+            if (entry.dts != AV_NOPTS_VALUE) {
+                putSigned(out, entry.dts - lastDts);
+                lastDts = entry.dts;
+            }
+            putSigned(out, entry.pos - lastPos);
+            lastPos = entry.pos;
+            putVarint(out, (uint32_t)entry.size);
+        }
+    }
+
+    // Written aside and renamed over, so a reader never sees half a sidecar.
+    std::string path = sidecarPath(inputPath);
+    std::string tempPath = path + ".tmp";
+    FILE* f = openFile(tempPath, "wb");
+    if (!f) {
+        std::cerr << "[SeekIndex] Could not write " << path << std::endl;
+        return false;
+    }
+    bool written = fwrite(out.data(), 1, out.size(), f) == out.size();
+    written = fclose(f) == 0 && written;
+    std::error_code ec;
+    if (written) fs::rename(Utf8ToPath(tempPath), Utf8ToPath(path), ec);
+    if (!written || ec) {
+        fs::remove(Utf8ToPath(tempPath), ec);
+        std::cerr << "[SeekIndex] Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<SeekIndex> SeekIndex::load(const std::string& inputPath) {
+    int64_t size = 0, mtime = 0;
+    if (!fileStamp(inputPath, size, mtime)) return nullptr;
+
+    std::string path = sidecarPath(inputPath);
+    std::error_code ec;
+    uintmax_t sidecarSize = fs::file_size(Utf8ToPath(path), ec);
+    if (ec || sidecarSize < sizeof(kMagic)) return nullptr;
+
+    FILE* f = openFile(path, "rb");
+    if (!f) return nullptr;
+    std::vector<uint8_t> data((size_t)sidecarSize);
+    bool read = fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    if (!read || memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) return nullptr;
+
+    ByteReader reader{data.data(), data.size(), sizeof(kMagic)};
+    auto index = std::make_shared<SeekIndex>();
+    index->fileSize_ = (int64_t)reader.fixed(8);
+    index->fileMtime_ = (int64_t)reader.fixed(8);
+    // Written for an earlier version of the file.
+    if (reader.failed || index->fileSize_ != size || index->fileMtime_ != mtime) return nullptr;
+
+    uint32_t streamCount = (uint32_t)reader.fixed(4);
+    if (streamCount > 4096) return nullptr;
+    index->streams_.resize(streamCount);
+    for (auto& stream : index->streams_) {
+        stream.type = (AVMediaType)(int32_t)reader.fixed(4);
+        stream.timeBase.num = (int32_t)reader.fixed(4);
+        stream.timeBase.den = (int32_t)reader.fixed(4);
+        uint32_t count = (uint32_t)reader.fixed(4);
+        // Every entry takes at least three bytes, which bounds a corrupt count.
+        if (reader.failed || count > (data.size() - reader.offset) / 3) return nullptr;
+        stream.entries.resize(count);
+
+        int64_t lastPts = 0, lastDts = 0, lastPos = 0;
+        for (auto& entry : stream.entries) {
+            uint8_t flags = (uint8_t)reader.fixed(1);
+            entry.keyframe = (flags & kFlagKeyframe) != 0;
+            if (!(flags & kFlagNoPts)) entry.pts = lastPts += reader.signedVarint();
+            if (!(flags & kFlagNoDts)) entry.dts = lastDts += reader.signedVarint();
+            entry.pos = lastPos += reader.signedVarint();
+            entry.size = (int32_t)reader.varint();
+            if (reader.failed) return nullptr;
+        }
+    }
+
+    index->sortKeyframes();
+    return index;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/avutil.h>
+}
+
+class TranscodeControl;
+
+// Packet index of a media file: pts, dts, byte position, size and keyframe flag of every
+// packet of every stream, built by reading the file's packets once. It is kept in a
+// sidecar next to the input (<input>.mfidx, delta/varint coded, ~10 bytes per packet)
+// stamped with the input's size and modification time, so a later open loads it instead
+// of scanning again. Demuxer::seekIndexed() uses it to jump straight to a keyframe.
+class SeekIndex {
+public:
+    struct Entry {
+        int64_t pts = AV_NOPTS_VALUE;
+        int64_t dts = AV_NOPTS_VALUE;
+        int64_t pos = -1;           // Byte offset as reported by the demuxer; -1 if unknown
+        int32_t size = 0;
+        bool keyframe = false;
+    };
+
+    struct Stream {
+        AVMediaType type = AVMEDIA_TYPE_UNKNOWN;
+        AVRational timeBase{0, 1};
+        std::vector<Entry> entries;         // In file order
+        std::vector<uint32_t> keyframes;    // Indices into entries, sorted by time
+    };
+
+    static std::string sidecarPath(const std::string& inputPath);
+
+    // The sidecar's index if it exists and still matches the input; nullptr otherwise.
+    static std::shared_ptr<SeekIndex> load(const std::string& inputPath);
+    // Reads every packet of the input once. Returns nullptr if the input can't be read or
+    // `control` cancels the scan.
+    static std::shared_ptr<SeekIndex> build(const std::string& inputPath, TranscodeControl* control = nullptr);
+    // Writes the sidecar for `inputPath`, replacing any older one.
+    bool save(const std::string& inputPath) const;
+
+    const std::vector<Stream>& streams() const { return streams_; }
+    size_t packetCount() const;
+
+    // The keyframe to start decoding at to reach `timestamp` (in the stream's time base):
+    // the last one at or before it, or the first one for earlier timestamps. nullptr if the
+    // stream has no keyframes.
+    const Entry* keyframeBefore(int streamIndex, int64_t timestamp) const;
+
+    // The timestamp an entry is ordered and sought by: pts, or dts where pts is missing.
+    static int64_t entryTime(const Entry& entry) {
+        return entry.pts != AV_NOPTS_VALUE ? entry.pts : entry.dts;
+    }
+
+private:
+    int64_t fileSize_ = 0;
+    int64_t fileMtime_ = 0;
+    std::vector<Stream> streams_;
+
+    static bool fileStamp(const std::string& inputPath, int64_t& size, int64_t& mtime);
+    void sortKeyframes();
+};
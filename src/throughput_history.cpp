@@ -0,0 +1,155 @@
+#include "throughput_history.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Weight of the newest sample; old measurements fade out as hardware or settings change.
+static const double kSmoothing = 0.3;
+// Used before anything comparable has been measured: a software HEVC encode of 1080p.
+static const double kDefaultFps1080p = 25.0;
+static const double kDefaultRemuxFps = 2000.0;
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& str) {
+    if (str.empty()) return std::wstring();
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), NULL, 0);
+    std::wstring wstrTo(size_needed, 0);
+    MultiByteToWideChar(CP_UTF8, 0, &str[0], (int)str.size(), &wstrTo[0], size_needed);
+    return wstrTo;
+}
+#endif
+
+static FILE* openFile(const std::string& path, const char* mode) {
+#ifdef _WIN32
+    std::wstring wideMode(mode, mode + strlen(mode));
+    return _wfopen(Utf8ToWide(path).c_str(), wideMode.c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExW(Utf8ToWide(from).c_str(), Utf8ToWide(to).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+int ThroughputHistory::heightClass(int height) {
+    static const int classes[] = {480, 720, 1080, 1440, 2160, 4320};
+    for (int c : classes) {
+        if (height <= c) return c;
+    }
+    return 4320;
+}
+
+std::string ThroughputHistory::makeKey(const std::string& codec, int heightClass, const std::string& encoder) {
+    return codec + " " + std::to_string(heightClass) + " " + encoder;
+}
+
+bool ThroughputHistory::load(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    path_ = path;
+    entries_.clear();
+
+    FILE* f = openFile(path, "r");
+    if (!f) return false;
+
+    // One entry per line: <codec> <height class> <encoder> <fps> <samples>
+    char codec[64], encoder[64];
+    int height = 0, samples = 0;
+    double fps = 0.0;
+    while (fscanf(f, "%63s %d %63s %lf %d", codec, &height, encoder, &fps, &samples) == 5) {
+        if (fps > 0.0) {
+            entries_[makeKey(codec, height, encoder)] = Entry{fps, samples};
+        }
+    }
+    fclose(f);
+
+    std::cout << "[ThroughputHistory] Loaded " << entries_.size() << " entries from " << path << std::endl;
+    return true;
+}
+
+void ThroughputHistory::save() const {
+    if (path_.empty()) return;
+
+    // Written aside, flushed to disk and renamed over, so a crash mid-write leaves the old
+    // history rather than a truncated one.
+    std::string tempPath = path_ + ".tmp";
+    FILE* f = openFile(tempPath, "w");
+    if (!f) {
+        std::cerr << "[ThroughputHistory] Could not write " << tempPath << std::endl;
+        return;
+    }
+    bool ok = true;
+    for (const auto& [key, entry] : entries_) {
+        ok = ok && fprintf(f, "%s %.3f %d\n", key.c_str(), entry.fps, entry.samples) > 0;
+    }
+    ok = ok && fflush(f) == 0;
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+    ok = fclose(f) == 0 && ok;
+    if (!ok || !replaceFile(tempPath, path_)) {
+        std::cerr << "[ThroughputHistory] Could not write " << path_ << std::endl;
+    }
+}
+
+void ThroughputHistory::record(const std::string& codec, int height, const std::string& encoder, double fps) {
+    if (!(fps > 0.0) || codec.empty() || encoder.empty()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entries_[makeKey(codec, heightClass(height), encoder)];
+    entry.fps = entry.samples == 0 ? fps : entry.fps + kSmoothing * (fps - entry.fps);
+    entry.samples++;
+    save();
+}
+
+double ThroughputHistory::expectedFps(const std::string& codec, int width, int height, const std::string& encoder) const {
+    if (encoder == "copy") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(makeKey(codec, heightClass(height), encoder));
+        return it != entries_.end() ? it->second.fps : kDefaultRemuxFps;
+    }
+
+    int cls = heightClass(height);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(makeKey(codec, cls, encoder));
+    if (it != entries_.end()) return it->second.fps;
+
+    // Encode speed is roughly inversely proportional to pixel count (16:9 per class).
+    auto pixelsOf = [](int h) { return (double)h * h * 16.0 / 9.0; };
+    double pixels = width > 0 && height > 0 ? (double)width * height : pixelsOf(cls);
+
+    double bestFps = 0.0;
+    int bestDistance = 0;
+    std::string prefix = codec + " ";
+    std::string suffix = " " + encoder;
+    for (const auto& [key, entry] : entries_) {
+        if (key.compare(0, prefix.size(), prefix) != 0) continue;
+        if (key.size() < suffix.size() || key.compare(key.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+        int otherClass = std::atoi(key.c_str() + prefix.size());
+        int distance = std::abs(otherClass - cls);
+        if (bestFps == 0.0 || distance < bestDistance) {
+            bestFps = entry.fps * pixelsOf(otherClass) / pixels;
+            bestDistance = distance;
+        }
+    }
+    if (bestFps > 0.0) return bestFps;
+
+    return kDefaultFps1080p * (1920.0 * 1080.0) / pixels;
+}
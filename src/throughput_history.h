@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+// Measured encode speed of past jobs, keyed by source codec, resolution class and encoder,
+// persisted to a small text file so estimates improve across sessions.
+class ThroughputHistory {
+public:
+    // Loads existing entries; later record() calls write back to the same file.
+    bool load(const std::string& path);
+
+    // fps = source frames processed per wall-clock second, folded into a moving average.
+    void record(const std::string& codec, int height, const std::string& encoder, double fps);
+
+    // Best guess for an unseen combination: the same codec/encoder at another resolution,
+    // scaled by pixel count, or a conservative default.
+    double expectedFps(const std::string& codec, int width, int height, const std::string& encoder) const;
+
+    // Standard resolution class (480, 720, 1080, 1440, 2160, 4320) that height falls into.
+    static int heightClass(int height);
+
+private:
+    struct Entry {
+        double fps = 0.0;
+        int samples = 0;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::string path_;
+
+    static std::string makeKey(const std::string& codec, int heightClass, const std::string& encoder);
+    void save() const;
+};
@@ -0,0 +1,90 @@
+#include "transcode_control.h"
+#include <algorithm>
+
+static int64_t toNanos(TranscodeControl::Clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+static TranscodeControl::Clock::time_point fromNanos(int64_t nanos) {
+    return TranscodeControl::Clock::time_point(
+        std::chrono::duration_cast<TranscodeControl::Clock::duration>(std::chrono::nanoseconds(nanos)));
+}
+
+void TranscodeControl::setState(int set, int clear) {
+    {
+        // Taking the lock orders the change against a waiter's predicate check,
+        // so a notify can't slip in between the check and the wait.
+        std::lock_guard<std::mutex> lock(mutex_);
+        int state = state_.load();
+        state_.store((state | set) & ~clear, std::memory_order_release);
+    }
+    cv_.notify_all();
+}
+
+void TranscodeControl::pause() {
+    setState(kPaused, 0);
+}
+
+void TranscodeControl::resume() {
+    setState(0, kPaused);
+}
+
+void TranscodeControl::cancel() {
+    setState(kCancelled, 0);
+}
+
+void TranscodeControl::reset() {
+    deadlineNanos_ = 0;
+    setState(0, kPaused | kCancelled);
+}
+
+void TranscodeControl::setDeadline(Clock::time_point deadline) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deadlineNanos_ = std::max<int64_t>(1, toNanos(deadline));
+    }
+    cv_.notify_all();
+}
+
+void TranscodeControl::clearDeadline() {
+    deadlineNanos_ = 0;
+}
+
+bool TranscodeControl::deadlinePassed() const {
+    int64_t deadline = deadlineNanos_.load(std::memory_order_relaxed);
+    return deadline != 0 && toNanos(Clock::now()) >= deadline;
+}
+
+bool TranscodeControl::isCancelled() const {
+    return (state_.load(std::memory_order_acquire) & kCancelled) != 0 || deadlinePassed();
+}
+
+bool TranscodeControl::checkpoint() {
+    int state = state_.load(std::memory_order_acquire);
+    if (state == 0) {
+        return !deadlinePassed();
+    }
+    if (state & kCancelled) return false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto released = [this] { return (state_.load() & kPaused) == 0 || (state_.load() & kCancelled) != 0; };
+    while (!released()) {
+        int64_t deadline = deadlineNanos_;
+        if (deadline == 0) {
+            cv_.wait(lock);
+        } else if (cv_.wait_until(lock, fromNanos(deadline)) == std::cv_status::timeout && deadlinePassed()) {
+            return false;
+        }
+    }
+    return (state_.load() & kCancelled) == 0 && !deadlinePassed();
+}
+
+bool TranscodeControl::waitFor(Clock::duration timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [this] { return (state_.load() & kCancelled) != 0; });
+    return !isCancelled();
+}
+
+int TranscodeControl::interruptCallback(void* opaque) {
+    return opaque && static_cast<TranscodeControl*>(opaque)->isCancelled() ? 1 : 0;
+}
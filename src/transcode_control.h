@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Pause/resume/cancel token shared between a controller (UI, JobManager) and the threads
+// doing the work. Workers call checkpoint() once per packet or frame: while running it is a
+// single atomic load, while paused it blocks on a condition variable until resumed or
+// cancelled, and it returns false once the operation is cancelled or its deadline passes.
+class TranscodeControl {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void pause();
+    void resume();
+    void cancel();
+    // Clears pause, cancel and deadline so the token can drive another run.
+    void reset();
+
+    // Cancels automatically at the given time, including while paused.
+    void setDeadline(Clock::time_point deadline);
+    void clearDeadline();
+
+    bool isPaused() const { return (state_.load(std::memory_order_acquire) & kPaused) != 0; }
+    bool isCancelled() const;
+
+    // Returns true to keep going, false to stop. Blocks while paused.
+    bool checkpoint();
+
+    // Sleeps up to timeout, returning early on cancel. Returns false if cancelled.
+    bool waitFor(Clock::duration timeout);
+
+    // For AVFormatContext::interrupt_callback, so blocking FFmpeg I/O also notices cancel.
+    static int interruptCallback(void* opaque);
+
+private:
+    static const int kPaused = 1;
+    static const int kCancelled = 2;
+
+    std::atomic<int> state_{0};
+    std::atomic<int64_t> deadlineNanos_{0};   // steady_clock ticks, 0 = none
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    bool deadlinePassed() const;
+    void setState(int set, int clear);
+};
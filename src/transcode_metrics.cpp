@@ -0,0 +1,173 @@
+#include "transcode_metrics.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+// currentFps is recomputed once per window.
+static const int64_t kFpsWindowNanos = 1000000000;
+
+void TranscodeMetrics::start(int64_t durationMicros) {
+    framesDecoded_ = 0;
+    framesEncoded_ = 0;
+    bytesRead_ = 0;
+    bytesWritten_ = 0;
+    for (auto& nanos : stageNanos_) nanos = 0;
+    for (auto& depth : queueDepth_) depth = 0;
+    positionMicros_ = 0;
+    durationMicros_ = durationMicros > 0 ? durationMicros : 0;
+    pausedNanos_ = 0;
+    pausers_ = 0;
+    currentFps_ = 0.0f;
+    windowStartFrames_ = 0;
+
+    int64_t now = nowNanos();
+    windowStartNanos_ = now;
+    endNanos_ = 0;
+    startNanos_ = now;
+}
+
+void TranscodeMetrics::finish() {
+    if (startNanos_ != 0 && endNanos_ == 0) {
+        endNanos_ = nowNanos();
+    }
+    for (auto& depth : queueDepth_) depth = 0;
+}
+
+void TranscodeMetrics::addFramesEncoded(uint64_t count) {
+    uint64_t frames = framesEncoded_.fetch_add(count, std::memory_order_relaxed) + count;
+
+    int64_t now = nowNanos();
+    int64_t windowStart = windowStartNanos_.load(std::memory_order_relaxed);
+    if (now - windowStart < kFpsWindowNanos) return;
+
+    // Only the thread that wins the exchange closes the window.
+    if (windowStartNanos_.compare_exchange_strong(windowStart, now)) {
+        uint64_t startFrames = windowStartFrames_.exchange(frames);
+        currentFps_ = (float)((double)(frames - startFrames) * 1e9 / (double)(now - windowStart));
+    }
+}
+
+void TranscodeMetrics::setPosition(int64_t micros) {
+    positionMicros_.store(std::max<int64_t>(0, micros), std::memory_order_relaxed);
+}
+
+void TranscodeMetrics::beginPause() {
+    if (pausers_++ == 0) {
+        pauseStartNanos_ = nowNanos();
+    }
+}
+
+void TranscodeMetrics::endPause() {
+    if (--pausers_ == 0) {
+        int64_t now = nowNanos();
+        pausedNanos_ += now - pauseStartNanos_;
+        // Don't let the pause count as a slow fps window.
+        windowStartNanos_ = now;
+        windowStartFrames_ = framesEncoded_.load();
+    }
+}
+
+int64_t TranscodeMetrics::activeNanos(int64_t now) const {
+    int64_t start = startNanos_;
+    if (start == 0) return 0;
+
+    int64_t end = endNanos_;
+    if (end == 0) end = now;
+    int64_t paused = pausedNanos_;
+    if (pausers_ > 0) paused += end - pauseStartNanos_;
+    return std::max<int64_t>(0, end - start - paused);
+}
+
+TranscodeMetrics::Snapshot TranscodeMetrics::snapshot() const {
+    Snapshot s;
+    int64_t now = nowNanos();
+
+    s.framesDecoded = framesDecoded_.load(std::memory_order_relaxed);
+    s.framesEncoded = framesEncoded_.load(std::memory_order_relaxed);
+    s.bytesRead = bytesRead_.load(std::memory_order_relaxed);
+    s.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+    for (int i = 0; i < StageCount; i++) {
+        s.stageBusySeconds[i] = stageNanos_[i].load(std::memory_order_relaxed) / 1e9;
+    }
+    for (int i = 0; i < QueueCount; i++) {
+        s.queueDepth[i] = queueDepth_[i].load(std::memory_order_relaxed);
+    }
+
+    s.running = startNanos_ != 0 && endNanos_ == 0;
+    s.elapsedSeconds = activeNanos(now) / 1e9;
+    s.positionSeconds = positionMicros_.load(std::memory_order_relaxed) / 1e6;
+    s.durationSeconds = durationMicros_.load(std::memory_order_relaxed) / 1e6;
+    s.positionSeconds = std::min(s.positionSeconds, s.durationSeconds);
+
+    if (s.elapsedSeconds > 0.0) {
+        s.averageFps = s.framesEncoded / s.elapsedSeconds;
+    }
+    s.currentFps = s.running ? currentFps_.load(std::memory_order_relaxed) : 0.0;
+    if (s.running && s.currentFps == 0.0) {
+        s.currentFps = s.averageFps;
+    }
+
+    // Media seconds per wall second so far; needs a little history to be meaningful.
+    if (s.running && s.elapsedSeconds >= 1.0 && s.positionSeconds > 0.0 && s.durationSeconds > 0.0) {
+        double speed = s.positionSeconds / s.elapsedSeconds;
+        s.etaSeconds = (s.durationSeconds - s.positionSeconds) / speed;
+    } else if (!s.running && startNanos_ != 0) {
+        s.etaSeconds = 0.0;
+    }
+    return s;
+}
+
+float TranscodeMetrics::progress() const {
+    int64_t duration = durationMicros_.load(std::memory_order_relaxed);
+    if (duration <= 0) return 0.0f;
+    return (float)std::min(1.0, (double)positionMicros_.load(std::memory_order_relaxed) / (double)duration);
+}
+
+float TranscodeMetrics::Snapshot::progress() const {
+    if (durationSeconds <= 0.0) return 0.0f;
+    return (float)std::min(1.0, positionSeconds / durationSeconds);
+}
+
+void TranscodeMetrics::Snapshot::add(const Snapshot& other) {
+    framesDecoded += other.framesDecoded;
+    framesEncoded += other.framesEncoded;
+    bytesRead += other.bytesRead;
+    bytesWritten += other.bytesWritten;
+    for (int i = 0; i < StageCount; i++) stageBusySeconds[i] += other.stageBusySeconds[i];
+    for (int i = 0; i < QueueCount; i++) queueDepth[i] += other.queueDepth[i];
+    elapsedSeconds = std::max(elapsedSeconds, other.elapsedSeconds);
+    positionSeconds += other.positionSeconds;
+    durationSeconds += other.durationSeconds;
+    averageFps += other.averageFps;
+    currentFps += other.currentFps;
+    running = running || other.running;
+
+    // Concurrent jobs finish when the slowest one does; unknown stays unknown.
+    if (etaSeconds < 0.0 || other.etaSeconds < 0.0) {
+        etaSeconds = -1.0;
+    } else {
+        etaSeconds = std::max(etaSeconds, other.etaSeconds);
+    }
+}
+
+std::string TranscodeMetrics::Snapshot::summary() const {
+    static const char* stageNames[StageCount] = {"demux", "decode", "convert", "encode", "mux"};
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "frames=" << framesEncoded << "/" << framesDecoded
+        << " fps=" << currentFps << " (avg " << averageFps << ")"
+        << " in=" << bytesRead / (1024 * 1024) << "MB"
+        << " out=" << bytesWritten / (1024 * 1024) << "MB"
+        << " pos=" << positionSeconds << "/" << durationSeconds << "s";
+    if (etaSeconds >= 0.0) {
+        oss << " eta=" << std::setprecision(0) << etaSeconds << "s" << std::setprecision(1);
+    }
+    oss << " busy:";
+    for (int i = 0; i < StageCount; i++) {
+        oss << " " << stageNames[i] << "=" << stageBusySeconds[i] << "s";
+    }
+    oss << " queues: " << queueDepth[PacketQueue] << "/" << queueDepth[DecodedQueue]
+        << "/" << queueDepth[ConvertedQueue] << "/" << queueDepth[MuxQueue];
+    return oss.str();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Live counters for one transcode. Pipeline stages write them with relaxed atomics;
+// the UI, CLI and JobManager read them through snapshot() on their own schedule,
+// so nothing on the hot path calls back into the caller.
+class TranscodeMetrics {
+public:
+    enum Stage { Demux, Decode, Convert, Encode, Mux, StageCount };
+    enum Queue { PacketQueue, DecodedQueue, ConvertedQueue, MuxQueue, QueueCount };
+
+    struct Snapshot {
+        uint64_t framesDecoded = 0;
+        uint64_t framesEncoded = 0;
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+        std::array<double, StageCount> stageBusySeconds{};
+        std::array<int, QueueCount> queueDepth{};
+        double elapsedSeconds = 0.0;    // Wall time since start(), excluding pauses
+        double positionSeconds = 0.0;   // Media time the encoder has reached
+        double durationSeconds = 0.0;
+        double averageFps = 0.0;
+        double currentFps = 0.0;        // Over the last second or so
+        double etaSeconds = -1.0;       // -1 until there is enough throughput to estimate
+        bool running = false;
+
+        float progress() const;
+        // Combines concurrent jobs: counters and rates add up, ETA is the slowest job's.
+        void add(const Snapshot& other);
+        std::string summary() const;
+    };
+
+    // Clears all counters; called at the start of every run.
+    void start(int64_t durationMicros);
+    void finish();
+
+    void addFramesDecoded(uint64_t count = 1) { framesDecoded_.fetch_add(count, std::memory_order_relaxed); }
+    void addFramesEncoded(uint64_t count = 1);
+    void addBytesRead(int64_t bytes) { if (bytes > 0) bytesRead_.fetch_add((uint64_t)bytes, std::memory_order_relaxed); }
+    void addBytesWritten(int64_t bytes) { if (bytes > 0) bytesWritten_.fetch_add((uint64_t)bytes, std::memory_order_relaxed); }
+    void addStageTime(Stage stage, int64_t nanos) { stageNanos_[stage].fetch_add(nanos, std::memory_order_relaxed); }
+    void setPosition(int64_t micros);
+    // Storage for BoundedQueue::setDepthGauge().
+    std::atomic<int>* queueDepthGauge(Queue queue) { return &queueDepth_[queue]; }
+
+    // Paused time is left out of elapsed time, fps and ETA. Safe to nest from several threads.
+    void beginPause();
+    void endPause();
+
+    Snapshot snapshot() const;
+    // Cheap subset of snapshot().progress() for per-packet callers.
+    float progress() const;
+
+    static int64_t nowNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Adds the lifetime of the scope to one stage's busy time.
+    class StageTimer {
+    public:
+        StageTimer(TranscodeMetrics& metrics, Stage stage) : metrics_(metrics), stage_(stage), start_(nowNanos()) {}
+        ~StageTimer() { metrics_.addStageTime(stage_, nowNanos() - start_); }
+
+    private:
+        TranscodeMetrics& metrics_;
+        Stage stage_;
+        int64_t start_;
+    };
+
+private:
+    std::atomic<uint64_t> framesDecoded_{0};
+    std::atomic<uint64_t> framesEncoded_{0};
+    std::atomic<uint64_t> bytesRead_{0};
+    std::atomic<uint64_t> bytesWritten_{0};
+    std::array<std::atomic<int64_t>, StageCount> stageNanos_{};
+    std::array<std::atomic<int>, QueueCount> queueDepth_{};
+    std::atomic<int64_t> positionMicros_{0};
+    std::atomic<int64_t> durationMicros_{0};
+
+    std::atomic<int64_t> startNanos_{0};
+    std::atomic<int64_t> endNanos_{0};        // 0 while running
+    std::atomic<int64_t> pausedNanos_{0};
+    std::atomic<int64_t> pauseStartNanos_{0};
+    std::atomic<int> pausers_{0};
+
+    // Rolling window for currentFps, advanced by whichever encoder thread crosses the boundary.
+    std::atomic<int64_t> windowStartNanos_{0};
+    std::atomic<uint64_t> windowStartFrames_{0};
+    std::atomic<float> currentFps_{0.0f};
+
+    int64_t activeNanos(int64_t now) const;
+};
@@ -2,25 +2,31 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <atomic>
+
+#include "bounded_queue.h"
+#include "media_probe.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 }
 
-Transcoder::Transcoder() {}
+// Compressed data kept for replaying a GOP into a software decoder.
+static const int64_t kMaxGopBytes = 256ll * 1024 * 1024;
 
-Transcoder::~Transcoder() {}
+Transcoder::Transcoder() {}
 
-void Transcoder::setPauseCallback(std::function<bool()> cb) {
-    pauseCallback = cb;
+Transcoder::~Transcoder() {
+    clearGopPackets();
 }
 
 void Transcoder::setProgressCallback(std::function<void(float)> callback) {
     onProgress = callback;
 }
 
-bool Transcoder::initVideo(const std::string& encoderName, bool allowHardwareDecoders) {
+bool Transcoder::initVideo(const std::string& encoderName, bool allowHardwareDecoders,
+                           const VideoDecoder::Options& decoderOptions) {
     videoStreamIndex_ = demuxer_.getVideoStreamIndex();
     if (videoStreamIndex_ < 0) {
         std::cerr << "[Transcoder] No video stream found" << std::endl;
@@ -30,7 +36,9 @@ bool Transcoder::initVideo(const std::string& encoderName, bool allowHardwareDec
     const auto& streams = demuxer_.getStreams();
     const Demuxer::StreamInfo& videoStream = streams[videoStreamIndex_];
 
-    if (!videoDecoder_.open(videoStream.codecParams, allowHardwareDecoders)) {
+    decoderOptions_ = decoderOptions;
+    if (!videoDecoder_.open(videoStream.codecParams, allowHardwareDecoders, decoderOptions) &&
+        !(allowHardwareDecoders && decoderFallback_ && videoDecoder_.open(videoStream.codecParams, false, decoderOptions))) {
         std::cerr << "[Transcoder] Failed to open video decoder" << std::endl;
         return false;
     }
@@ -59,93 +67,557 @@ bool Transcoder::initVideo(const std::string& encoderName, bool allowHardwareDec
 }
 
 bool Transcoder::initAudio() {
-    audioStreamIndex_ = demuxer_.getAudioStreamIndex();
-    if (audioStreamIndex_ < 0) {
+    const auto& streams = demuxer_.getStreams();
+    streamMapping_.assign(streams.size(), -1);
+
+    int copied = 0;
+    for (const auto& stream : streams) {
+        bool wanted = stream.codecType == AVMEDIA_TYPE_AUDIO ||
+                      (copySubtitles_ && stream.codecType == AVMEDIA_TYPE_SUBTITLE);
+        if (wanted && addCopiedStream(stream)) {
+            copied++;
+        }
+    }
+
+    if (copied == 0) {
         std::cout << "[Transcoder] No audio stream found" << std::endl;
-        return true;
+    } else {
+        std::cout << "[Transcoder] Stream copy: " << copied << " audio/subtitle stream(s)" << std::endl;
     }
+    return true;
+}
 
-    std::cout << "[Transcoder] Audio: skipping (video only output)" << std::endl;
-    audioStreamIndex_ = -1;
+bool Transcoder::addCopiedStream(const Demuxer::StreamInfo& stream) {
+    if (!muxer_.supportsCodec(stream.codecParams->codec_id)) {
+        std::cout << "[Transcoder] Dropping stream " << stream.streamIndex
+                  << " (codec " << avcodec_get_name(stream.codecParams->codec_id)
+                  << " not supported by output container)" << std::endl;
+        return false;
+    }
+
+    int outIndex = muxer_.addStream(stream.codecParams, stream.timeBase);
+    if (outIndex < 0) {
+        std::cerr << "[Transcoder] Failed to add stream " << stream.streamIndex << " to muxer" << std::endl;
+        return false;
+    }
+    streamMapping_[stream.streamIndex] = outIndex;
     return true;
 }
 
-bool Transcoder::process() {
-    AVPacket* packet = av_packet_alloc();
-    AVFrame* frame = av_frame_alloc();
-    int64_t nextVideoPts = 0;
-    int64_t nextAudioPts = 0;
+bool Transcoder::remapCopiedPacket(AVPacket* packet) const {
+    int inIndex = packet->stream_index;
+    if (inIndex < 0 || inIndex >= (int)streamMapping_.size() || streamMapping_[inIndex] < 0) {
+        return false;
+    }
+    packet->stream_index = streamMapping_[inIndex];
+    packet->pos = -1;
+    return true;
+}
+
+bool Transcoder::checkpoint() {
+    bool keepGoing;
+    if (control_->isPaused()) {
+        metrics_->beginPause();
+        keepGoing = control_->checkpoint();
+        metrics_->endPause();
+    } else {
+        keepGoing = control_->checkpoint();
+    }
+    if (!keepGoing) cancelled_ = true;
+    return keepGoing;
+}
+
+void Transcoder::setPosition(int64_t pts, AVRational timeBase) {
+    if (pts == AV_NOPTS_VALUE) return;
+    metrics_->setPosition(av_rescale_q(pts, timeBase, AV_TIME_BASE_Q) - startTime_);
+}
+
+void Transcoder::reportProgress() {
+    if (!onProgress || totalDuration_ <= 0) return;
+
+    // The position comes from the encoder side, so this reports work done rather than
+    // how far ahead the demuxer has read.
+    int permille = (int)(metrics_->progress() * 1000.0f);
+    if (permille != reportedPermille_.exchange(permille)) {
+        onProgress(permille / 1000.0f);
+    }
+}
+
+bool Transcoder::demuxPacket(AVPacket* packet) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Demux);
+    if (!demuxer_.readPacket(packet)) return false;
+    metrics_->addBytesRead(packet->size);
+    return true;
+}
+
+void Transcoder::rememberGopPacket(const AVPacket* packet) {
+    if (!decoderFallback_ || !videoDecoder_.isHardware()) return;
+
+    if (packet && (packet->flags & AV_PKT_FLAG_KEY)) {
+        clearGopPackets();
+    }
+    if (gopOverflow_) return;
+
+    AVPacket* copy = nullptr;
+    if (packet) {
+        copy = packetPool_.acquire();
+        if (av_packet_ref(copy, packet) < 0) {
+            packetPool_.release(copy);
+            gopOverflow_ = true;
+            return;
+        }
+        gopBytes_ += packet->size;
+    }
+    gopPackets_.push_back(copy);
+
+    // Past this the GOP is too long to keep around; a failure before the next keyframe
+    // is left to the caller's retry.
+    if (gopBytes_ > kMaxGopBytes) {
+        clearGopPackets();
+        gopOverflow_ = true;
+    }
+}
+
+void Transcoder::clearGopPackets() {
+    for (AVPacket* packet : gopPackets_) {
+        if (packet) packetPool_.release(packet);
+    }
+    gopPackets_.clear();
+    gopBytes_ = 0;
+    gopOverflow_ = false;
+    replayIndex_ = SIZE_MAX;
+}
+
+bool Transcoder::switchToSoftwareDecoder() {
+    if (!decoderFallback_ || !videoDecoder_.isHardware() || gopOverflow_ || gopPackets_.empty() ||
+        !(gopPackets_.front() && (gopPackets_.front()->flags & AV_PKT_FLAG_KEY))) {
+        return false;
+    }
 
-    int64_t totalDuration = demuxer_.getDuration();
+    std::cerr << "[Transcoder] Hardware decoder failed, continuing with a software decoder from the last keyframe ("
+              << gopPackets_.size() << " packet(s) to replay)" << std::endl;
+    AVCodecParameters* params = demuxer_.getStreams()[videoStreamIndex_].codecParams;
+    if (!videoDecoder_.open(params, false, decoderOptions_)) {
+        std::cerr << "[Transcoder] Failed to open software decoder" << std::endl;
+        return false;
+    }
+
+    usedDecoderFallback_ = true;
+    replayIndex_ = 0;
+    skipDecodedFrames_ = lastDecodedPts_ != AV_NOPTS_VALUE;
+    return true;
+}
+
+bool Transcoder::decodePacket(AVPacket* packet) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Decode);
+    rememberGopPacket(packet);
+    if (videoDecoder_.sendPacket(packet)) return true;
+    // The packet is in gopPackets_, so the replay driven by receiveDecodedFrame() covers it.
+    return videoDecoder_.hasFailed() && switchToSoftwareDecoder();
+}
 
+bool Transcoder::receiveDecodedFrame(AVFrame* frame) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Decode);
     while (true) {
-        if (pauseCallback) {
-            while (pauseCallback()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (videoDecoder_.receiveFrame(frame)) {
+            if (skipDecodedFrames_ && frame->pts != AV_NOPTS_VALUE && frame->pts <= lastDecodedPts_) {
+                av_frame_unref(frame);   // Already decoded by the failed decoder
+                continue;
             }
+            skipDecodedFrames_ = false;
+            if (frame->pts != AV_NOPTS_VALUE) lastDecodedPts_ = frame->pts;
+            metrics_->addFramesDecoded();
+            return true;
         }
+        if (videoDecoder_.hasFailed() && switchToSoftwareDecoder()) {
+            continue;
+        }
+        if (replayIndex_ < gopPackets_.size()) {
+            videoDecoder_.sendPacket(gopPackets_[replayIndex_++]);
+            continue;
+        }
+        return false;
+    }
+}
+
+bool Transcoder::convertFrame(const AVFrame* src, AVFrame* dst) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Convert);
+    return videoEncoder_.convertFrame(src, dst);
+}
+
+bool Transcoder::encodeFrame(AVFrame* frame) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Encode);
+    // sendFrame() converts as well when needed, which the serial path relies on.
+    bool ok = pipelineOptions_.enabled ? videoEncoder_.encodeFrame(frame) : videoEncoder_.sendFrame(frame);
+    if (ok && frame) noteFrameEncoded(frame);
+    return ok;
+}
+
+bool Transcoder::receiveEncodedPacket(AVPacket* packet) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Encode);
+    if (!videoEncoder_.receivePacket(packet)) return false;
+    packet->stream_index = videoOutStreamIndex_;
+    return true;
+}
+
+bool Transcoder::muxPacket(AVPacket* packet) {
+    TranscodeMetrics::StageTimer timer(*metrics_, TranscodeMetrics::Mux);
+    int size = packet->size;
+    if (!muxer_.writePacket(packet)) return false;
+    metrics_->addBytesWritten(size);
+    return true;
+}
+
+void Transcoder::prepareFrameForEncode(AVFrame* frame, int64_t& nextVideoPts) {
+    if (frame->pts == AV_NOPTS_VALUE) {
+        frame->pts = nextVideoPts++;
+    } else {
+        AVRational srcTimeBase = demuxer_.getFormatContext()->streams[videoStreamIndex_]->time_base;
+        AVRational dstTimeBase = videoEncoder_.getCodecContext()->time_base;
+        frame->pts = av_rescale_q(frame->pts, srcTimeBase, dstTimeBase);
+        nextVideoPts = frame->pts + 1;
+    }
+    frame->pict_type = AV_PICTURE_TYPE_NONE;
+}
+
+bool Transcoder::shouldRemux(const std::string& encoderName) const {
+    if (remuxPolicy_ == RemuxPolicy::Never) return false;
+    if (remuxPolicy_ == RemuxPolicy::Always) return true;
+
+    int videoIdx = demuxer_.getVideoStreamIndex();
+    if (videoIdx < 0) return false;
+
+    AVCodecID sourceCodec = demuxer_.getStreams()[videoIdx].codecParams->codec_id;
+    return sourceCodec == VideoEncoder::targetCodecId(encoderName);
+}
+
+bool Transcoder::initRemux() {
+    const auto& streams = demuxer_.getStreams();
+    streamMapping_.assign(streams.size(), -1);
+
+    videoStreamIndex_ = demuxer_.getVideoStreamIndex();
+    if (videoStreamIndex_ < 0) {
+        std::cerr << "[Transcoder] No video stream found" << std::endl;
+        return false;
+    }
+
+    for (const auto& stream : streams) {
+        bool isMainVideo = stream.streamIndex == videoStreamIndex_;
+        bool wanted = isMainVideo || stream.codecType == AVMEDIA_TYPE_AUDIO ||
+                      (copySubtitles_ && stream.codecType == AVMEDIA_TYPE_SUBTITLE);
+        if (!wanted) continue;
 
-        if (!demuxer_.readPacket(packet)) {
+        if (!addCopiedStream(stream) && isMainVideo) {
+            return false;
+        }
+    }
+
+    videoOutStreamIndex_ = streamMapping_[videoStreamIndex_];
+    std::cout << "[Transcoder] Remux: stream copy, no decode/encode" << std::endl;
+    return true;
+}
+
+bool Transcoder::processRemux() {
+    AVPacket* packet = packetPool_.acquire();
+    AVRational videoTimeBase = demuxer_.getStreams()[videoStreamIndex_].timeBase;
+    bool failed = false;
+
+    while (!failed && checkpoint()) {
+        if (!demuxPacket(packet)) {
             break;
         }
 
-        if (onProgress && totalDuration > 0) {
-            int64_t currentPts = packet->pts;
-            AVRational timeBase = demuxer_.getFormatContext()->streams[packet->stream_index]->time_base;
-            int64_t currentTime = av_rescale_q(currentPts, timeBase, AV_TIME_BASE_Q);
-            float progress = (float)currentTime / (float)totalDuration;
-            if (progress >= 0.0f && progress <= 1.0f) {
-                onProgress(progress);
+        if (packet->stream_index == videoStreamIndex_) {
+            setPosition(packet->pts, videoTimeBase);
+            reportProgress();
+        }
+        if (remapCopiedPacket(packet) && !muxPacket(packet)) {
+            failed = true;
+        }
+
+        av_packet_unref(packet);
+    }
+
+    packetPool_.release(packet);
+    return !failed && !cancelled_;
+}
+
+uint64_t Transcoder::poolAllocations() const {
+    return packetPool_.allocations() + framePool_.allocations();
+}
+
+void Transcoder::noteFrameEncoded(const AVFrame* frame) {
+    metrics_->addFramesEncoded();
+    setPosition(frame->pts, videoEncoder_.getCodecContext()->time_base);
+
+    // Once every queue has been filled, pool misses mean the hot loop is allocating again.
+    int warmupFrames = 2 * (pipelineOptions_.packetQueueSize + pipelineOptions_.frameQueueSize) + 16;
+    if (++framesEncoded_ == warmupFrames) {
+        warmupAllocations_ = poolAllocations();
+    }
+}
+
+void Transcoder::logPoolStats() const {
+    int64_t misses = steadyStateAllocations();
+    if (misses < 0) {
+        std::cout << "[Transcoder] Pool allocations: " << poolAllocations()
+                  << " (too few frames to reach steady state)" << std::endl;
+        return;
+    }
+    std::cout << "[Transcoder] Pool allocations: " << poolAllocations()
+              << ", misses after warm-up: " << misses << std::endl;
+}
+
+bool Transcoder::process() {
+    if (pipelineOptions_.enabled) {
+        return processPipelined();
+    }
+
+    AVPacket* packet = packetPool_.acquire();
+    AVPacket* encPkt = packetPool_.acquire();
+    AVFrame* frame = framePool_.acquire();
+    int64_t nextVideoPts = 0;
+    bool failed = false;
+
+    auto encodeAndMux = [&](AVFrame* frameToEncode) {
+        if (encodeFrame(frameToEncode)) {
+            while (!failed && !control_->isCancelled() && receiveEncodedPacket(encPkt)) {
+                if (!muxPacket(encPkt)) failed = true;
+                av_packet_unref(encPkt);
             }
+        } else if (videoEncoder_.conversionFailed()) {
+            failed = true;
+        }
+    };
+
+    while (!failed && checkpoint()) {
+        if (!demuxPacket(packet)) {
+            break;
         }
 
         if (packet->stream_index == videoStreamIndex_) {
-            if (videoDecoder_.sendPacket(packet) && videoDecoder_.receiveFrame(frame)) {
-                do {
-                    if (frame->pts == AV_NOPTS_VALUE) {
-                        frame->pts = nextVideoPts++;
-                    } else {
-                        AVRational srcTimeBase = demuxer_.getFormatContext()->streams[videoStreamIndex_]->time_base;
-                        AVRational dstTimeBase = videoEncoder_.getCodecContext()->time_base;
-                        frame->pts = av_rescale_q(frame->pts, srcTimeBase, dstTimeBase);
-                        nextVideoPts = frame->pts + 1;
-                    }
-                    frame->pict_type = AV_PICTURE_TYPE_NONE;
-
-                    if (videoEncoder_.sendFrame(frame)) {
-                        AVPacket* encPkt = av_packet_alloc();
-                        while (videoEncoder_.receivePacket(encPkt)) {
-                            encPkt->stream_index = videoOutStreamIndex_;
-                            muxer_.writePacket(encPkt);
-                        }
-                        av_packet_free(&encPkt);
-                    }
-                } while (videoDecoder_.receiveFrame(frame));
+            if (decodePacket(packet)) {
+                while (!failed && receiveDecodedFrame(frame) && checkpoint()) {
+                    prepareFrameForEncode(frame, nextVideoPts);
+                    encodeAndMux(frame);
+                    av_frame_unref(frame);
+                }
             }
-        } else if (packet->stream_index == audioStreamIndex_) {
-            packet->stream_index = audioOutStreamIndex_;
-            muxer_.writePacket(packet);
+            reportProgress();
+        } else if (remapCopiedPacket(packet) && !muxPacket(packet)) {
+            failed = true;
         }
 
         av_packet_unref(packet);
     }
 
-    videoEncoder_.flush();
-    AVPacket* encPkt = av_packet_alloc();
-    while (videoEncoder_.receivePacket(encPkt)) {
-        encPkt->stream_index = videoOutStreamIndex_;
-        muxer_.writePacket(encPkt);
+    // Drain frames still buffered in the decoder, then the encoder.
+    if (!failed && !cancelled_ && decodePacket(nullptr)) {
+        while (!failed && receiveDecodedFrame(frame) && checkpoint()) {
+            prepareFrameForEncode(frame, nextVideoPts);
+            encodeAndMux(frame);
+            av_frame_unref(frame);
+        }
+    }
+    if (!failed && !cancelled_) {
+        encodeAndMux(nullptr);
     }
-    av_packet_free(&encPkt);
 
-    av_packet_free(&packet);
-    av_frame_free(&frame);
+    av_frame_unref(frame);
+    packetPool_.release(packet);
+    packetPool_.release(encPkt);
+    framePool_.release(frame);
 
-    return true;
+    return !failed && !cancelled_;
+}
+
+bool Transcoder::processPipelined() {
+    // demux -> decode -> convert -> encode -> mux, each stage on its own thread.
+    // Bounded queues provide back-pressure so the slowest stage sets the pace.
+    // Packets and frames circulate through packetPool_/framePool_ rather than the allocator.
+    BoundedQueue<AVPacket*> packetQueue(pipelineOptions_.packetQueueSize);
+    BoundedQueue<AVFrame*> decodedQueue(pipelineOptions_.frameQueueSize);
+    BoundedQueue<AVFrame*> convertedQueue(pipelineOptions_.frameQueueSize);
+    BoundedQueue<AVPacket*> muxQueue(pipelineOptions_.packetQueueSize, 2);
+    packetQueue.setDepthGauge(metrics_->queueDepthGauge(TranscodeMetrics::PacketQueue));
+    decodedQueue.setDepthGauge(metrics_->queueDepthGauge(TranscodeMetrics::DecodedQueue));
+    convertedQueue.setDepthGauge(metrics_->queueDepthGauge(TranscodeMetrics::ConvertedQueue));
+    muxQueue.setDepthGauge(metrics_->queueDepthGauge(TranscodeMetrics::MuxQueue));
+
+    std::atomic<bool> failed{false};
+    auto abortAll = [&]() {
+        failed = true;
+        packetQueue.abort();
+        decodedQueue.abort();
+        convertedQueue.abort();
+        muxQueue.abort();
+    };
+
+    std::thread demuxThread([&]() {
+        while (!failed) {
+            if (!checkpoint()) {
+                abortAll();
+                break;
+            }
+
+            AVPacket* packet = packetPool_.acquire();
+            if (!demuxPacket(packet)) {
+                packetPool_.release(packet);
+                break;
+            }
+
+            reportProgress();
+
+            bool queued = false;
+            if (packet->stream_index == videoStreamIndex_) {
+                queued = packetQueue.push(packet);
+            } else if (remapCopiedPacket(packet)) {
+                queued = muxQueue.push(packet);
+            } else {
+                packetPool_.release(packet);
+                continue;
+            }
+
+            if (!queued) {
+                packetPool_.release(packet);
+                break;
+            }
+        }
+        packetQueue.close();
+        muxQueue.close();
+    });
+
+    std::thread decodeThread([&]() {
+        auto forwardFrames = [&]() {
+            while (true) {
+                AVFrame* decoded = framePool_.acquire();
+                if (!receiveDecodedFrame(decoded)) {
+                    framePool_.release(decoded);
+                    return true;
+                }
+                if (!decodedQueue.push(decoded)) {
+                    framePool_.release(decoded);
+                    return false;
+                }
+            }
+        };
+
+        AVPacket* packet = nullptr;
+        bool ok = true;
+        while (ok && packetQueue.pop(packet)) {
+            if (!checkpoint()) {
+                packetPool_.release(packet);
+                abortAll();
+                break;
+            }
+            if (decodePacket(packet)) {
+                ok = forwardFrames();
+            }
+            packetPool_.release(packet);
+        }
+        if (ok && !failed && decodePacket(nullptr)) {
+            forwardFrames();
+        }
+
+        decodedQueue.close();
+    });
+
+    std::thread convertThread([&]() {
+        int64_t nextVideoPts = 0;
+        AVFrame* frame = nullptr;
+        while (decodedQueue.pop(frame)) {
+            prepareFrameForEncode(frame, nextVideoPts);
+
+            if (videoEncoder_.needsConversion(frame)) {
+                AVFrame* converted = framePool_.acquireVideo(
+                    videoEncoder_.width(), videoEncoder_.height(), videoEncoder_.pixFmt());
+                if (!converted || !convertFrame(frame, converted)) {
+                    framePool_.release(converted);
+                    framePool_.release(frame);
+                    abortAll();
+                    break;
+                }
+                framePool_.release(frame);
+                frame = converted;
+            }
+
+            if (!convertedQueue.push(frame)) {
+                framePool_.release(frame);
+                break;
+            }
+        }
+        convertedQueue.close();
+    });
+
+    std::thread encodeThread([&]() {
+        auto forwardPackets = [&]() {
+            while (true) {
+                // Flushing a deep lookahead can take a while; stop as soon as we're cancelled.
+                if (control_->isCancelled()) return false;
+                AVPacket* encPkt = packetPool_.acquire();
+                if (!receiveEncodedPacket(encPkt)) {
+                    packetPool_.release(encPkt);
+                    return true;
+                }
+                if (!muxQueue.push(encPkt)) {
+                    packetPool_.release(encPkt);
+                    return false;
+                }
+            }
+        };
+
+        AVFrame* frame = nullptr;
+        bool ok = true;
+        while (ok && convertedQueue.pop(frame)) {
+            if (!checkpoint()) {
+                framePool_.release(frame);
+                abortAll();
+                break;
+            }
+            if (encodeFrame(frame)) {
+                ok = forwardPackets();
+            }
+            framePool_.release(frame);
+        }
+        if (ok && !failed && encodeFrame(nullptr)) {
+            forwardPackets();
+        }
+        muxQueue.close();
+    });
+
+    AVPacket* packet = nullptr;
+    while (muxQueue.pop(packet)) {
+        // A write error (e.g. a full disk) fails the run like any other stage.
+        if (!failed && !muxPacket(packet)) {
+            abortAll();
+        }
+        packetPool_.release(packet);
+    }
+
+    demuxThread.join();
+    decodeThread.join();
+    convertThread.join();
+    encodeThread.join();
+
+    // Reclaim anything left behind by an aborted run.
+    AVFrame* frame = nullptr;
+    while (packetQueue.tryPop(packet)) packetPool_.release(packet);
+    while (decodedQueue.tryPop(frame)) framePool_.release(frame);
+    while (convertedQueue.tryPop(frame)) framePool_.release(frame);
+    while (muxQueue.tryPop(packet)) packetPool_.release(packet);
+
+    // The queues are gone; don't leave their gauges pointing at them.
+    for (int i = 0; i < TranscodeMetrics::QueueCount; i++) {
+        metrics_->queueDepthGauge((TranscodeMetrics::Queue)i)->store(0);
+    }
+
+    if (control_->isCancelled()) cancelled_ = true;
+    return !failed && !cancelled_;
 }
 
 bool Transcoder::run(const std::string& inputPath, const std::string& outputPath,
-                     const std::string& encoderName, bool allowHardwareDecoders) {
+                     const std::string& encoderName, bool allowHardwareDecoders,
+                     const VideoDecoder::Options& decoderOptions) {
     std::cout << "[Transcoder::run] this=" << this << " input=" << inputPath << std::endl;
 
     demuxer_.close();
@@ -153,10 +625,16 @@ bool Transcoder::run(const std::string& inputPath, const std::string& outputPath
     videoDecoder_.close();
     videoEncoder_.close();
     videoStreamIndex_ = -1;
-    audioStreamIndex_ = -1;
     videoOutStreamIndex_ = -1;
-    audioOutStreamIndex_ = -1;
-
+    streamMapping_.clear();
+    remuxed_ = false;
+    cancelled_ = false;
+    usedDecoderFallback_ = false;
+    clearGopPackets();
+    lastDecodedPts_ = AV_NOPTS_VALUE;
+    skipDecodedFrames_ = false;
+
+    demuxer_.setInterruptCallback(&TranscodeControl::interruptCallback, control_);
     if (!demuxer_.open(inputPath)) {
         return false;
     }
@@ -164,42 +642,57 @@ bool Transcoder::run(const std::string& inputPath, const std::string& outputPath
     if (!muxer_.open(outputPath)) {
         return false;
     }
+    // Sizes a reserved index; a growing input's length is unknown.
+    muxer_.setExpectedDuration(demuxer_.isTailing() ? 0 : demuxer_.getDuration(), demuxer_.hasExactDuration());
 
-    if (!initVideo(encoderName, allowHardwareDecoders)) {
-        return false;
-    }
+    remuxed_ = shouldRemux(encoderName);
+    if (remuxed_) {
+        if (!initRemux()) {
+            return false;
+        }
+    } else {
+        if (!initVideo(encoderName, allowHardwareDecoders, decoderOptions)) {
+            return false;
+        }
 
-    if (!initAudio()) {
-        return false;
+        if (!initAudio()) {
+            return false;
+        }
     }
 
     if (!muxer_.writeHeader()) {
         return false;
     }
 
-    bool success = process();
+    framesEncoded_ = 0;
+    warmupAllocations_ = UINT64_MAX;
+    // A growing input's current duration says nothing about where it will end.
+    totalDuration_ = demuxer_.isTailing() ? 0 : demuxer_.getDuration();
+    AVFormatContext* inCtx = demuxer_.getFormatContext();
+    startTime_ = inCtx->start_time != AV_NOPTS_VALUE ? inCtx->start_time : 0;
+    reportedPermille_ = -1;
+    metrics_->start(totalDuration_);
+
+    bool success = remuxed_ ? processRemux() : process();
+    clearGopPackets();
+    metrics_->finish();
+    if (!remuxed_) {
+        logPoolStats();
+    }
+    std::cout << "[Transcoder] " << metrics_->snapshot().summary() << std::endl;
+    if (cancelled_) {
+        std::cout << "[Transcoder] Cancelled" << std::endl;
+    }
 
-    if (success) {
-        muxer_.writeTrailer();
+    // The trailer is where the index is written; an MP4 whose moov outgrew its reservation fails here.
+    if (success && !muxer_.writeTrailer()) {
+        success = false;
     }
 
     return success;
 }
 
 bool Transcoder::isHevc(const std::string& inputPath) {
-    Demuxer dm;
-    if (!dm.open(inputPath)) {
-        return false;
-    }
-
-    int videoIdx = dm.getVideoStreamIndex();
-    if (videoIdx < 0) {
-        return false;
-    }
-
-    const auto& streams = dm.getStreams();
-    bool isHevc = streams[videoIdx].codecParams->codec_id == AV_CODEC_ID_HEVC;
-
-    dm.close();
-    return isHevc;
+    MediaInfo info = MediaProbe::shared().get(inputPath);
+    return info.valid && info.codecId == AV_CODEC_ID_HEVC;
 }
\ No newline at end of file
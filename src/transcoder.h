@@ -3,39 +3,161 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <vector>
+#include <atomic>
+#include <cstdint>
 
 #include "demuxer.h"
 #include "video_decoder.h"
 #include "video_encoder.h"
 #include "muxer.h"
+#include "media_pool.h"
+#include "transcode_metrics.h"
+#include "transcode_control.h"
 
 class Transcoder {
 public:
+    // Queue depths between pipeline stages. Raw frame queues are sized in frames so that
+    // memory stays bounded at high resolutions (a 4K 10-bit frame is roughly 24 MB).
+    struct PipelineOptions {
+        bool enabled = true;
+        int packetQueueSize = 128;
+        int frameQueueSize = 4;
+    };
+
+    // Auto stream-copies inputs whose video codec already matches the encoder's target codec,
+    // without opening a decoder or encoder. Always forces a container-only rewrap.
+    enum class RemuxPolicy { Auto, Never, Always };
+
     Transcoder();
     ~Transcoder();
 
-    bool run(const std::string& inputPath, const std::string& outputPath, const std::string& encoderName = "auto", bool allowHardwareDecoders = true);
+    bool run(const std::string& inputPath, const std::string& outputPath, const std::string& encoderName = "auto", bool allowHardwareDecoders = true,
+             const VideoDecoder::Options& decoderOptions = VideoDecoder::Options());
     static bool isHevc(const std::string& inputPath);
 
-    void setPauseCallback(std::function<bool()> cb);
+    // Pause/cancel token checked once per packet and frame by every pipeline stage.
+    // By default the Transcoder owns one; setControl() shares a caller-owned token.
+    void setControl(TranscodeControl* control) { control_ = control ? control : &ownControl_; }
+    TranscodeControl& control() { return *control_; }
+    bool wasCancelled() const { return cancelled_; }
+
+    // Called from the demux thread each time progress advances by 0.1%. Callers that
+    // poll should sample metrics() instead.
     void setProgressCallback(std::function<void(float)> callback);
+    void setPipelineOptions(const PipelineOptions& options) { pipelineOptions_ = options; }
+    void setRemuxPolicy(RemuxPolicy policy) { remuxPolicy_ = policy; }
+    // Audio streams are always copied through; subtitles only when enabled and the container accepts them.
+    void setCopySubtitles(bool copy) { copySubtitles_ = copy; }
+    bool wasRemuxed() const { return remuxed_; }
+
+    // When a hardware decoder fails mid-stream, switch to a software decoder in place: the
+    // packets since the last keyframe are replayed into it and frames that were already
+    // passed on are dropped, so encoding and muxing carry on. Enabled by default.
+    void setDecoderFallback(bool enabled) { decoderFallback_ = enabled; }
+    bool usedDecoderFallback() const { return usedDecoderFallback_; }
+
+    // Follows an input that is still being written (see Demuxer::setTailMode), so the run
+    // ends shortly after the writer closes the file or goes idle rather than at today's EOF.
+    void setTailInput(bool enabled, std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(10000)) {
+        demuxer_.setTailMode(enabled, idleTimeout);
+    }
+    // Index placement of MP4/Matroska outputs (see Muxer::Layout).
+    void setOutputLayout(Muxer::Layout layout) { muxer_.setLayout(layout); }
+    // Reads the input through a memory mapping (see Demuxer::setMemoryMapped).
+    void setMappedInput(bool enabled) { demuxer_.setMemoryMapped(enabled); }
+
+    // Live counters for the current run. By default the Transcoder owns them; setMetrics()
+    // points it at caller-owned storage (e.g. a job) that outlives the Transcoder.
+    void setMetrics(TranscodeMetrics* metrics) { metrics_ = metrics ? metrics : &ownMetrics_; }
+    const TranscodeMetrics& metrics() const { return *metrics_; }
+
+    // Slice threads for decoder->encoder pixel conversion (0 = one per core).
+    void setConversionThreads(int threads) { videoEncoder_.setConversionThreads(threads); }
+    // Caps the video encoder's worker threads (0 = encoder default); see VideoEncoder::setEncoderThreads().
+    void setEncoderThreads(int threads) { videoEncoder_.setEncoderThreads(threads); }
+    const LatencyHistogram& conversionLatency() const { return videoEncoder_.conversionLatency(); }
+
+    // Packet/frame pool misses during the last run after the pipeline warmed up, or -1 if the
+    // run was too short to warm up and nothing was measured. Zero means the pools covered
+    // every packet and frame the loop needed; payloads from av_read_frame, the codecs' own
+    // buffers and av_packet_ref copies are still allocated and aren't counted.
+    int64_t steadyStateAllocations() const {
+        uint64_t warmup = warmupAllocations_;
+        return warmup == UINT64_MAX ? -1 : (int64_t)(poolAllocations() - warmup);
+    }
 
 private:
-    std::function<bool()> pauseCallback;
     std::function<void(float)> onProgress;
+    TranscodeControl ownControl_;
+    TranscodeControl* control_ = &ownControl_;
+    std::atomic<bool> cancelled_{false};
+    PipelineOptions pipelineOptions_;
+    RemuxPolicy remuxPolicy_ = RemuxPolicy::Auto;
+    bool remuxed_ = false;
+    bool copySubtitles_ = false;
+    TranscodeMetrics ownMetrics_;
+    TranscodeMetrics* metrics_ = &ownMetrics_;
+    int64_t totalDuration_ = 0;
+    int64_t startTime_ = 0;
+    std::atomic<int> reportedPermille_{-1};
 
     Demuxer demuxer_;
     VideoDecoder videoDecoder_;
     VideoEncoder videoEncoder_;
     Muxer muxer_;
 
-    int videoStreamIndex_ = -1;
-    int audioStreamIndex_ = -1;
+    PacketPool packetPool_;
+    FramePool framePool_;
+    std::atomic<int> framesEncoded_{0};
+    std::atomic<uint64_t> warmupAllocations_{UINT64_MAX};
 
+    int videoStreamIndex_ = -1;
     int videoOutStreamIndex_ = -1;
-    int audioOutStreamIndex_ = -1;
 
-    bool initVideo(const std::string& encoderName, bool allowHardwareDecoders);
+    // Decoder fallback state, only touched by whichever thread runs the decode stage.
+    bool decoderFallback_ = true;
+    bool usedDecoderFallback_ = false;
+    VideoDecoder::Options decoderOptions_;
+    std::vector<AVPacket*> gopPackets_;     // Packet refs since the last keyframe; nullptr = flush
+    int64_t gopBytes_ = 0;
+    bool gopOverflow_ = false;
+    size_t replayIndex_ = SIZE_MAX;         // Next gopPackets_ entry to resend, SIZE_MAX when not replaying
+    int64_t lastDecodedPts_ = AV_NOPTS_VALUE;
+    bool skipDecodedFrames_ = false;        // Dropping replayed frames up to lastDecodedPts_
+
+    // Input stream index -> output stream index for stream-copied packets, -1 if dropped.
+    std::vector<int> streamMapping_;
+
+    bool initVideo(const std::string& encoderName, bool allowHardwareDecoders, const VideoDecoder::Options& decoderOptions);
+    void rememberGopPacket(const AVPacket* packet);
+    void clearGopPackets();
+    bool switchToSoftwareDecoder();
     bool initAudio();
+    bool addCopiedStream(const Demuxer::StreamInfo& stream);
+    bool remapCopiedPacket(AVPacket* packet) const;
+    bool shouldRemux(const std::string& encoderName) const;
+    bool initRemux();
+    bool processRemux();
     bool process();
+    bool processPipelined();
+
+    uint64_t poolAllocations() const;
+    void noteFrameEncoded(const AVFrame* frame);
+    void logPoolStats() const;
+
+    // Stage wrappers that keep metrics_ up to date.
+    bool demuxPacket(AVPacket* packet);
+    bool decodePacket(AVPacket* packet);
+    bool receiveDecodedFrame(AVFrame* frame);
+    bool convertFrame(const AVFrame* src, AVFrame* dst);
+    bool encodeFrame(AVFrame* frame);
+    bool receiveEncodedPacket(AVPacket* packet);
+    bool muxPacket(AVPacket* packet);
+
+    // Blocks while paused; returns false (and records it) once cancelled.
+    bool checkpoint();
+    void setPosition(int64_t pts, AVRational timeBase);
+    void reportProgress();
+    void prepareFrameForEncode(AVFrame* frame, int64_t& nextVideoPts);
 };
\ No newline at end of file
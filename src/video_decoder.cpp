@@ -11,7 +11,7 @@ VideoDecoder::~VideoDecoder() {
     close();
 }
 
-bool VideoDecoder::open(AVCodecParameters* codecParams, bool allowHardware) {
+bool VideoDecoder::open(AVCodecParameters* codecParams, bool allowHardware, const Options& options) {
     close();
 
     AVCodecID codecId = codecParams->codec_id;
@@ -32,6 +32,7 @@ bool VideoDecoder::open(AVCodecParameters* codecParams, bool allowHardware) {
         }
     }
 
+    hardware_ = codec_ != nullptr;
     if (!codec_) {
         codec_ = avcodec_find_decoder(codecId);
     }
@@ -49,6 +50,15 @@ bool VideoDecoder::open(AVCodecParameters* codecParams, bool allowHardware) {
 
     avcodec_parameters_to_context(codecCtx_, codecParams);
 
+    codecCtx_->thread_count = options.threadCount;
+    switch (options.threadType) {
+        case Options::ThreadType::Frame: codecCtx_->thread_type = FF_THREAD_FRAME; break;
+        case Options::ThreadType::Slice: codecCtx_->thread_type = FF_THREAD_SLICE; break;
+        default: codecCtx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+    }
+    codecCtx_->skip_loop_filter = options.skipLoopFilter;
+    codecCtx_->skip_frame = options.skipFrame;
+
     if (avcodec_open2(codecCtx_, codec_, nullptr) < 0) {
         std::cerr << "[VideoDecoder] Failed to open decoder: " << codec_->name << std::endl;
         avcodec_free_context(&codecCtx_);
@@ -56,8 +66,11 @@ bool VideoDecoder::open(AVCodecParameters* codecParams, bool allowHardware) {
         return false;
     }
 
+    const char* threadMode = codecCtx_->active_thread_type == FF_THREAD_FRAME ? "frame" :
+                             codecCtx_->active_thread_type == FF_THREAD_SLICE ? "slice" : "none";
     std::cout << "[VideoDecoder] Opened decoder: " << codec_->name
-              << " (" << codecCtx_->width << "x" << codecCtx_->height << ")" << std::endl;
+              << " (" << codecCtx_->width << "x" << codecCtx_->height << ")"
+              << ", threads: " << codecCtx_->thread_count << " (" << threadMode << ")" << std::endl;
 
     return true;
 }
@@ -68,11 +81,17 @@ void VideoDecoder::close() {
         codecCtx_ = nullptr;
     }
     codec_ = nullptr;
+    hardware_ = false;
+    consecutiveErrors_ = 0;
 }
 
 bool VideoDecoder::sendPacket(AVPacket* packet) {
     if (!codecCtx_) return false;
-    return avcodec_send_packet(codecCtx_, packet) >= 0;
+    int ret = avcodec_send_packet(codecCtx_, packet);
+    if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+        consecutiveErrors_++;
+    }
+    return ret >= 0;
 }
 
 bool VideoDecoder::receiveFrame(AVFrame* frame) {
@@ -83,8 +102,10 @@ bool VideoDecoder::receiveFrame(AVFrame* frame) {
     }
     if (ret < 0) {
         std::cerr << "[VideoDecoder] Decode error: " << ret << std::endl;
+        consecutiveErrors_++;
         return false;
     }
+    consecutiveErrors_ = 0;
     return true;
 }
 
@@ -8,12 +8,24 @@ extern "C" {
 #include <libavutil/avutil.h>
 }
 
+// Software decoder tuning. Hardware decoders ignore the threading fields.
+struct VideoDecoderOptions {
+    enum class ThreadType { Auto, Frame, Slice };
+
+    int threadCount = 0;  // 0 = one thread per core, chosen by FFmpeg
+    ThreadType threadType = ThreadType::Auto;
+    AVDiscard skipLoopFilter = AVDISCARD_DEFAULT;
+    AVDiscard skipFrame = AVDISCARD_DEFAULT;
+};
+
 class VideoDecoder {
 public:
+    using Options = VideoDecoderOptions;
+
     VideoDecoder();
     ~VideoDecoder();
 
-    bool open(AVCodecParameters* codecParams, bool allowHardware = true);
+    bool open(AVCodecParameters* codecParams, bool allowHardware = true, const Options& options = Options());
     void close();
 
     bool sendPacket(AVPacket* packet);
@@ -24,9 +36,20 @@ public:
     int height() const { return codecCtx_ ? codecCtx_->height : 0; }
     AVPixelFormat pixFmt() const { return codecCtx_ ? codecCtx_->pix_fmt : AV_PIX_FMT_NONE; }
     AVRational framerate() const { return codecCtx_ ? codecCtx_->framerate : AVRational{0, 1}; }
+    int threadCount() const { return codecCtx_ ? codecCtx_->thread_count : 0; }
+    int activeThreadType() const { return codecCtx_ ? codecCtx_->active_thread_type : 0; }
+
+    bool isHardware() const { return hardware_; }
+    // Several decode errors in a row with no frame in between: the decoder (typically a
+    // hardware session that lost its device) won't recover and should be replaced.
+    bool hasFailed() const { return consecutiveErrors_ >= kMaxConsecutiveErrors; }
 
 private:
+    static const int kMaxConsecutiveErrors = 3;
+
     AVCodecContext* codecCtx_ = nullptr;
     const AVCodec* codec_ = nullptr;
     int refCount_ = 0;
+    bool hardware_ = false;
+    int consecutiveErrors_ = 0;
 };
\ No newline at end of file
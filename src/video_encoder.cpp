@@ -1,9 +1,15 @@
 #include "video_encoder.h"
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 extern "C" {
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 }
 
 static int64_t calculateRecommendedBitrate(int width, int height, double fps) {
@@ -47,28 +53,110 @@ static int64_t calculateRecommendedBitrate(int width, int height, double fps) {
 
 VideoEncoder::VideoEncoder() {}
 
+AVCodecID VideoEncoder::targetCodecId(const std::string& encoderName) {
+    if (encoderName.empty() || encoderName == "auto") {
+        return AV_CODEC_ID_HEVC;
+    }
+    if (const AVCodec* encoder = avcodec_find_encoder_by_name(encoderName.c_str())) {
+        return encoder->id;
+    }
+    if (const AVCodecDescriptor* desc = avcodec_descriptor_get_by_name(encoderName.c_str())) {
+        return desc->id;
+    }
+    return AV_CODEC_ID_NONE;
+}
+
+std::string VideoEncoder::resolveEncoderName(const std::string& encoderName, int width, int height,
+                                             AVPixelFormat pixFmt) {
+    using Key = std::tuple<std::string, int, int, AVPixelFormat>;
+    static std::mutex mutex;
+    static std::map<Key, std::string> resolved;
+
+    Key key(encoderName, width, height, pixFmt);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = resolved.find(key);
+        if (it != resolved.end()) return it->second;
+    }
+
+    // Opened outside the lock: probing the hardware encoders can take a moment.
+    VideoEncoder encoder;
+    encoder.setEncoderThreads(1);
+    encoder.setConversionThreads(1);
+    std::string name;
+    if (encoder.open(width, height, pixFmt, AVRational{30, 1}, encoderName)) {
+        name = encoder.getCodecContext()->codec->name;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    resolved[key] = name;
+    return name;
+}
+
 VideoEncoder::~VideoEncoder() {
     close();
 }
 
-bool VideoEncoder::initSwsContext(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt) {
+// Prefers the source format itself so no conversion is needed, then the format that loses the
+// least (keeps bit depth and chroma). Hardware surface formats are skipped since frames arrive in system memory.
+static AVPixelFormat chooseEncoderPixFmt(const AVCodec* encoder, AVPixelFormat srcPixFmt) {
+    const AVPixelFormat* pixFmts = nullptr;
+    int count = 0;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void* configs = nullptr;
+    if (avcodec_get_supported_config(nullptr, encoder, AV_CODEC_CONFIG_PIX_FORMAT, 0, &configs, &count) >= 0) {
+        pixFmts = static_cast<const AVPixelFormat*>(configs);
+    }
+#else
+    // FFmpeg before 7.1 (e.g. the 6.x of current LTS distributions) only has the
+    // AV_PIX_FMT_NONE-terminated list.
+    pixFmts = encoder->pix_fmts;
+    while (pixFmts && pixFmts[count] != AV_PIX_FMT_NONE) count++;
+#endif
+    if (!pixFmts || count == 0) {
+        return srcPixFmt != AV_PIX_FMT_NONE ? srcPixFmt : AV_PIX_FMT_YUV420P;
+    }
+    if (srcPixFmt == AV_PIX_FMT_NONE) {
+        return pixFmts[0];
+    }
+
+    std::vector<AVPixelFormat> candidates;
+    for (int i = 0; i < count; i++) {
+        if (pixFmts[i] == srcPixFmt) return srcPixFmt;
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFmts[i]);
+        if (desc && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            candidates.push_back(pixFmts[i]);
+        }
+    }
+    if (candidates.empty()) {
+        return pixFmts[0];
+    }
+    candidates.push_back(AV_PIX_FMT_NONE);
+
+    AVPixelFormat best = avcodec_find_best_pix_fmt_of_list(candidates.data(), srcPixFmt, 0, nullptr);
+    return best != AV_PIX_FMT_NONE ? best : candidates[0];
+}
+
+bool VideoEncoder::initConverter(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt) {
+    inputWidth_ = srcWidth;
+    inputHeight_ = srcHeight;
+    inputPixFmt_ = srcPixFmt;
+    converter_.close();
+
     if (codecCtx_->pix_fmt == srcPixFmt &&
         codecCtx_->width == srcWidth &&
         codecCtx_->height == srcHeight) {
         return true;
     }
 
-    swsCtx_ = sws_getContext(
-        srcWidth, srcHeight, srcPixFmt,
-        codecCtx_->width, codecCtx_->height, codecCtx_->pix_fmt,
-        SWS_BICUBIC, nullptr, nullptr, nullptr
-    );
-
-    if (!swsCtx_) {
-        std::cerr << "[VideoEncoder] Failed to create SwsContext for conversion" << std::endl;
+    if (!converter_.init(srcWidth, srcHeight, srcPixFmt,
+                         codecCtx_->width, codecCtx_->height, codecCtx_->pix_fmt,
+                         conversionThreads_)) {
         return false;
     }
 
+    if (encFrame_) return true;
+
     encFrame_ = av_frame_alloc();
     encFrame_->format = codecCtx_->pix_fmt;
     encFrame_->width = codecCtx_->width;
@@ -81,6 +169,22 @@ bool VideoEncoder::initSwsContext(int srcWidth, int srcHeight, AVPixelFormat src
     return true;
 }
 
+bool VideoEncoder::needsConversion(const AVFrame* frame) {
+    if (frame && codecCtx_ &&
+        (frame->format != inputPixFmt_ || frame->width != inputWidth_ || frame->height != inputHeight_)) {
+        // Hardware decoders can report one format at open and deliver another (e.g. NV12 / P010).
+        std::cout << "[VideoEncoder] Input changed to " << av_get_pix_fmt_name((AVPixelFormat)frame->format)
+                  << " " << frame->width << "x" << frame->height << std::endl;
+        conversionFailed_ = !initConverter(frame->width, frame->height, (AVPixelFormat)frame->format);
+        if (conversionFailed_) {
+            std::cerr << "[VideoEncoder] Can't convert the new input format" << std::endl;
+        }
+    }
+    // A failed re-init still reports a conversion so convertFrame() refuses the frame rather
+    // than the encoder being handed one in the wrong format.
+    return conversionFailed_ || converter_.isActive();
+}
+
 bool VideoEncoder::tryOpenEncoder(const char* encoderName, AVDictionary** opts) {
     const AVCodec* encoder = avcodec_find_encoder_by_name(encoderName);
     if (!encoder) return false;
@@ -91,7 +195,7 @@ bool VideoEncoder::tryOpenEncoder(const char* encoderName, AVDictionary** opts)
     tempCtx->height = codecCtx_->height;
     tempCtx->width = codecCtx_->width;
     tempCtx->sample_aspect_ratio = codecCtx_->sample_aspect_ratio;
-    tempCtx->pix_fmt = encoder->pix_fmts ? encoder->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+    tempCtx->pix_fmt = chooseEncoderPixFmt(encoder, codecCtx_->pix_fmt);
     tempCtx->framerate = codecCtx_->framerate;
     tempCtx->time_base = av_inv_q(codecCtx_->framerate);
     tempCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
@@ -108,19 +212,28 @@ bool VideoEncoder::tryOpenEncoder(const char* encoderName, AVDictionary** opts)
     double gop_fps = (tempCtx->framerate.num > 0) ? av_q2d(tempCtx->framerate) : 30.0;
     tempCtx->gop_size = (int)(gop_fps * 2.0);
 
-    if (opts && *opts) {
-        if (avcodec_open2(tempCtx, encoder, opts) < 0) {
-            avcodec_free_context(&tempCtx);
-            return false;
-        }
-    } else {
-        AVDictionary* tmpOpts = nullptr;
-        if (avcodec_open2(tempCtx, encoder, &tmpOpts) < 0) {
-            avcodec_free_context(&tempCtx);
-            return false;
+    AVDictionary* tmpOpts = nullptr;
+    AVDictionary** openOpts = (opts && *opts) ? opts : &tmpOpts;
+
+    if (encoderThreads_ > 0) {
+        tempCtx->thread_count = encoderThreads_;
+        // libx265 sizes its own thread pool from the core count and ignores thread_count.
+        if (strcmp(encoder->name, "libx265") == 0) {
+            // Appended so x265-params the caller passed in opts are kept.
+            std::string params = "pools=" + std::to_string(encoderThreads_);
+            if (const AVDictionaryEntry* existing = av_dict_get(*openOpts, "x265-params", nullptr, 0)) {
+                if (existing->value[0]) params = std::string(existing->value) + ":" + params;
+            }
+            av_dict_set(openOpts, "x265-params", params.c_str(), 0);
         }
+    }
+
+    if (avcodec_open2(tempCtx, encoder, openOpts) < 0) {
         av_dict_free(&tmpOpts);
+        avcodec_free_context(&tempCtx);
+        return false;
     }
+    av_dict_free(&tmpOpts);
 
     avcodec_free_context(&codecCtx_);
     codecCtx_ = tempCtx;
@@ -165,14 +278,16 @@ bool VideoEncoder::open(int width, int height, AVPixelFormat pixFmt, AVRational
         return false;
     }
 
-    if (!initSwsContext(width, height, pixFmt)) {
+    if (!initConverter(width, height, pixFmt)) {
         close();
         return false;
     }
 
     std::cout << "[VideoEncoder] Opened: " << codec_->name
               << " (" << width << "x" << height << " @ " << av_q2d(framerate) << " fps)"
-              << " -> (" << codecCtx_->width << "x" << codecCtx_->height << ")" << std::endl;
+              << " -> (" << codecCtx_->width << "x" << codecCtx_->height << " "
+              << av_get_pix_fmt_name(codecCtx_->pix_fmt) << ")"
+              << (converter_.isActive() ? "" : ", no conversion") << std::endl;
 
     return true;
 }
@@ -182,10 +297,11 @@ void VideoEncoder::close() {
         av_frame_free(&encFrame_);
         encFrame_ = nullptr;
     }
-    if (swsCtx_) {
-        sws_freeContext(swsCtx_);
-        swsCtx_ = nullptr;
+    if (converter_.isActive() && converter_.latency().count() > 0) {
+        std::cout << "[VideoEncoder] Conversion latency: " << converter_.latency().summary() << std::endl;
     }
+    converter_.close();
+    conversionFailed_ = false;
     if (codecCtx_) {
         avcodec_free_context(&codecCtx_);
         codecCtx_ = nullptr;
@@ -197,16 +313,38 @@ bool VideoEncoder::sendFrame(AVFrame* frame) {
     if (!codecCtx_) return false;
 
     AVFrame* frameToSend = frame;
-    if (frame && swsCtx_) {
-        sws_scale(swsCtx_,
-            (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height,
-            encFrame_->data, encFrame_->linesize);
-        encFrame_->pts = frame->pts;
-        encFrame_->pict_type = AV_PICTURE_TYPE_NONE;
+    if (frame && needsConversion(frame)) {
+        if (!convertFrame(frame, encFrame_)) return false;
         frameToSend = encFrame_;
     }
 
-    return avcodec_send_frame(codecCtx_, frameToSend) >= 0;
+    return encodeFrame(frameToSend);
+}
+
+bool VideoEncoder::convertFrame(const AVFrame* src, AVFrame* dst) {
+    if (!codecCtx_ || !converter_.isActive() || !src || !dst) return false;
+
+    if (!dst->buf[0]) {
+        dst->format = codecCtx_->pix_fmt;
+        dst->width = codecCtx_->width;
+        dst->height = codecCtx_->height;
+        if (av_frame_get_buffer(dst, 32) < 0) {
+            std::cerr << "[VideoEncoder] Failed to allocate conversion buffer" << std::endl;
+            return false;
+        }
+    }
+
+    if (!converter_.convert(src, dst)) {
+        return false;
+    }
+    dst->pts = src->pts;
+    dst->pict_type = AV_PICTURE_TYPE_NONE;
+    return true;
+}
+
+bool VideoEncoder::encodeFrame(AVFrame* frame) {
+    if (!codecCtx_) return false;
+    return avcodec_send_frame(codecCtx_, frame) >= 0;
 }
 
 bool VideoEncoder::receivePacket(AVPacket* packet) {
@@ -10,6 +10,8 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include "frame_converter.h"
+
 class VideoEncoder {
 public:
     using ProgressCallback = std::function<void(float)>;
@@ -23,6 +25,17 @@ public:
 
     bool sendFrame(AVFrame* frame);
     bool receivePacket(AVPacket* packet);
+
+    // Split form of sendFrame() for pipelined callers: convertFrame() runs the pixel format
+    // conversion into dst (allocated on demand), encodeFrame() submits a frame already in the encoder format.
+    // open() picks the encoder format closest to the source, so when they match no converter exists
+    // and decoded frames are submitted by reference. Passing a frame re-checks its actual format;
+    // if the converter can't be rebuilt for it, convertFrame()/sendFrame() fail until the next open().
+    bool needsConversion() const { return converter_.isActive(); }
+    bool needsConversion(const AVFrame* frame);
+    bool conversionFailed() const { return conversionFailed_; }
+    bool convertFrame(const AVFrame* src, AVFrame* dst);
+    bool encodeFrame(AVFrame* frame);
     void flush();
 
     int width() const { return codecCtx_ ? codecCtx_->width : 0; }
@@ -32,13 +45,37 @@ public:
 
     void setProgressCallback(ProgressCallback callback) { onProgress_ = callback; }
 
+    // Worker threads for pixel format conversion, applied on the next open(). 0 = one per core.
+    void setConversionThreads(int threads) { conversionThreads_ = threads; }
+    const LatencyHistogram& conversionLatency() const { return converter_.latency(); }
+
+    // Caps the encoder's own worker threads, applied on the next open(). 0 = encoder default.
+    // Used when several encoders share the machine, e.g. chunked encoding.
+    void setEncoderThreads(int threads) { encoderThreads_ = threads; }
+
+    // Codec an encoder name produces: "auto" -> HEVC, otherwise an encoder ("libx265")
+    // or codec ("hevc") name. Returns AV_CODEC_ID_NONE for unknown names.
+    static AVCodecID targetCodecId(const std::string& encoderName);
+
+    // Name of the encoder open() ends up with for this source: "auto" and an unavailable
+    // named encoder both fall back through the hardware encoders to libx265. Found by
+    // opening a throwaway encoder once per name, format and size; empty if none opens.
+    static std::string resolveEncoderName(const std::string& encoderName, int width, int height,
+                                          AVPixelFormat pixFmt);
+
 private:
     bool tryOpenEncoder(const char* encoderName, AVDictionary** opts = nullptr);
-    bool initSwsContext(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt);
+    bool initConverter(int srcWidth, int srcHeight, AVPixelFormat srcPixFmt);
 
     AVCodecContext* codecCtx_ = nullptr;
     const AVCodec* codec_ = nullptr;
-    SwsContext* swsCtx_ = nullptr;
+    FrameConverter converter_;
+    int conversionThreads_ = 0;
+    int encoderThreads_ = 0;
+    bool conversionFailed_ = false;
+    int inputWidth_ = 0;
+    int inputHeight_ = 0;
+    AVPixelFormat inputPixFmt_ = AV_PIX_FMT_NONE;
     AVFrame* encFrame_ = nullptr;
     ProgressCallback onProgress_;
 };
\ No newline at end of file
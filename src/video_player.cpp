@@ -20,6 +20,12 @@ VideoPlayer::~VideoPlayer() {
 void VideoPlayer::cleanup() {
     stop();
 
+    if (indexBuild_.valid()) {
+        indexControl_.cancel();
+        indexBuild_.wait();
+        indexBuild_ = {};
+    }
+
     if (swsContext) {
         sws_freeContext(swsContext);
         swsContext = nullptr;
@@ -33,9 +39,12 @@ void VideoPlayer::cleanup() {
     currentTime = 0.0;
 }
 
-bool VideoPlayer::open(const std::string& path) {
+bool VideoPlayer::open(const std::string& path, const VideoDecoder::Options& decoderOptions) {
     cleanup();
 
+    // Opening should feel instant, so take the header's word where it suffices; the pixel
+    // format comes from the first decoded frame instead.
+    demuxer_.setProbe(Demuxer::Probe::Header);
     if (!demuxer_.open(path)) {
         return false;
     }
@@ -50,30 +59,45 @@ bool VideoPlayer::open(const std::string& path) {
     const auto& streams = demuxer_.getStreams();
     auto& streamInfo = streams[videoStreamIndex];
 
-    if (!decoder_.open(streamInfo.codecParams)) {
+    if (!decoder_.open(streamInfo.codecParams, true, decoderOptions)) {
         cleanup();
         return false;
     }
 
     duration = (double)demuxer_.getDuration() / AV_TIME_BASE;
 
+    // Seeks use the file's index sidecar, or one built now for the next seeks (and the
+    // splitter). A file still being written is left alone.
+    if (std::shared_ptr<SeekIndex> index = SeekIndex::load(path)) {
+        demuxer_.setIndex(index);
+    } else if (!Demuxer::isGrowing(path, std::chrono::milliseconds(10000))) {
+        indexControl_.reset();
+        TranscodeControl* control = &indexControl_;
+        indexBuild_ = std::async(std::launch::async, [path, control]() {
+            std::shared_ptr<SeekIndex> index = SeekIndex::build(path, control);
+            if (index) index->save(path);
+            return index;
+        });
+    }
+
     AVRational frameRate = decoder_.framerate();
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        frameRate = demuxer_.getFormatContext()->streams[videoStreamIndex]->avg_frame_rate;
+    }
     if (frameRate.num > 0 && frameRate.den > 0) {
         fps = av_q2d(frameRate);
     }
 
-    initSwsContext();
-
     std::cout << "Video opened: " << getWidth() << "x" << getHeight()
               << " @ " << fps << " fps, duration: " << duration << "s" << std::endl;
 
     return true;
 }
 
-bool VideoPlayer::initSwsContext() {
-    swsContext = sws_getContext(
-        decoder_.width(), decoder_.height(), decoder_.pixFmt(),
-        decoder_.width(), decoder_.height(), AV_PIX_FMT_RGB24,
+bool VideoPlayer::initSwsContext(const AVFrame* frame) {
+    swsContext = sws_getCachedContext(swsContext,
+        frame->width, frame->height, (AVPixelFormat)frame->format,
+        frame->width, frame->height, AV_PIX_FMT_RGB24,
         SWS_BILINEAR, nullptr, nullptr, nullptr
     );
 
@@ -82,11 +106,15 @@ bool VideoPlayer::initSwsContext() {
         return false;
     }
 
-    rgbBufferSize = av_image_get_buffer_size(AV_PIX_FMT_RGB24, decoder_.width(), decoder_.height(), 1);
+    if (rgbBuffer) av_freep(&rgbBuffer);
+    rgbBufferSize = av_image_get_buffer_size(AV_PIX_FMT_RGB24, frame->width, frame->height, 1);
     rgbBuffer = (uint8_t*)av_malloc(rgbBufferSize);
 
     av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, rgbBuffer,
-                        AV_PIX_FMT_RGB24, decoder_.width(), decoder_.height(), 1);
+                        AV_PIX_FMT_RGB24, frame->width, frame->height, 1);
+    rgbWidth = frame->width;
+    rgbHeight = frame->height;
+    rgbSourceFormat = frame->format;
 
     return true;
 }
@@ -110,12 +138,19 @@ void VideoPlayer::stop() {
     currentTime = 0.0;
 }
 
+void VideoPlayer::adoptIndex() {
+    if (!indexBuild_.valid() || indexBuild_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+    std::shared_ptr<SeekIndex> index = indexBuild_.get();
+    if (index) demuxer_.setIndex(index);
+}
+
 bool VideoPlayer::seekTo(double timeSeconds) {
     if (!demuxer_.getFormatContext() || videoStreamIndex == -1) return false;
 
+    adoptIndex();
     int64_t timestamp = (int64_t)(timeSeconds * AV_TIME_BASE);
 
-    if (!demuxer_.seek(videoStreamIndex, timestamp, AVSEEK_FLAG_BACKWARD)) {
+    if (!demuxer_.seekIndexed(timestamp)) {
         std::cerr << "Seek failed" << std::endl;
         return false;
     }
@@ -123,7 +158,15 @@ bool VideoPlayer::seekTo(double timeSeconds) {
     decoder_.flush();
     currentTime = timeSeconds;
 
-    return decodeNextFrame();
+    if (!decodeNextFrame()) return false;
+    // With an index the seek lands on the keyframe just before the target, so decoding on
+    // to the target frame costs at most one GOP.
+    if (demuxer_.index()) {
+        double halfFrame = fps > 0.0 ? 0.5 / fps : 0.0;
+        while (currentTime + halfFrame < timeSeconds && decodeNextFrame()) {
+        }
+    }
+    return true;
 }
 
 bool VideoPlayer::decodeNextFrame() {
@@ -131,7 +174,7 @@ bool VideoPlayer::decodeNextFrame() {
 
     std::lock_guard<std::mutex> lock(frameMutex);
 
-    AVPacket* packet = av_packet_alloc();
+    AVPacket* packet = packetPool_.acquire();
     bool frameDecoded = false;
 
     while (demuxer_.readPacket(packet)) {
@@ -139,8 +182,9 @@ bool VideoPlayer::decodeNextFrame() {
             if (decoder_.sendPacket(packet)) {
                 if (decoder_.receiveFrame(currentFrame)) {
                     if (currentFrame->pts != AV_NOPTS_VALUE) {
+                        // Relative to the file's start, like duration and seekTo().
                         AVRational timeBase = demuxer_.getStreams()[videoStreamIndex].timeBase;
-                        currentTime = currentFrame->pts * av_q2d(timeBase);
+                        currentTime = currentFrame->pts * av_q2d(timeBase) - (double)demuxer_.getStartTime() / AV_TIME_BASE;
                     }
                     frameDecoded = true;
                     av_packet_unref(packet);
@@ -151,7 +195,7 @@ bool VideoPlayer::decodeNextFrame() {
         av_packet_unref(packet);
     }
 
-    av_packet_free(&packet);
+    packetPool_.release(packet);
     return frameDecoded;
 }
 
@@ -160,17 +204,24 @@ AVFrame* VideoPlayer::getCurrentFrame() {
 }
 
 bool VideoPlayer::getRGBFrame(uint8_t** rgbData, int* width, int* height) {
-    if (!currentFrame || !swsContext) return false;
+    if (!currentFrame) return false;
 
     std::lock_guard<std::mutex> lock(frameMutex);
+    if (!currentFrame->data[0]) return false;
+
+    // Set up from the frames themselves, which also follows mid-stream size changes.
+    if (!swsContext || currentFrame->width != rgbWidth || currentFrame->height != rgbHeight ||
+        currentFrame->format != rgbSourceFormat) {
+        if (!initSwsContext(currentFrame)) return false;
+    }
 
     sws_scale(swsContext,
-              currentFrame->data, currentFrame->linesize, 0, decoder_.height(),
+              currentFrame->data, currentFrame->linesize, 0, currentFrame->height,
               rgbFrame->data, rgbFrame->linesize);
 
     *rgbData = rgbBuffer;
-    *width = decoder_.width();
-    *height = decoder_.height();
+    *width = rgbWidth;
+    *height = rgbHeight;
 
     return true;
 }
@@ -4,6 +4,7 @@
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <future>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -13,13 +14,16 @@ extern "C" {
 
 #include "demuxer.h"
 #include "video_decoder.h"
+#include "media_pool.h"
+#include "seek_index.h"
+#include "transcode_control.h"
 
 class VideoPlayer {
 public:
     VideoPlayer();
     ~VideoPlayer();
 
-    bool open(const std::string& path);
+    bool open(const std::string& path, const VideoDecoder::Options& decoderOptions = VideoDecoder::Options());
     void close();
 
     void play();
@@ -43,10 +47,16 @@ public:
 
 private:
     void cleanup();
-    bool initSwsContext();
+    bool initSwsContext(const AVFrame* frame);
+    void adoptIndex();
 
     Demuxer demuxer_;
     VideoDecoder decoder_;
+    PacketPool packetPool_;
+
+    // A missing seek index is built in the background while the file is open.
+    std::future<std::shared_ptr<SeekIndex>> indexBuild_;
+    TranscodeControl indexControl_;
 
     AVFrame* currentFrame = nullptr;
     AVFrame* rgbFrame = nullptr;
@@ -63,4 +73,7 @@ private:
 
     uint8_t* rgbBuffer = nullptr;
     int rgbBufferSize = 0;
+    int rgbWidth = 0;
+    int rgbHeight = 0;
+    int rgbSourceFormat = -1;
 };
\ No newline at end of file
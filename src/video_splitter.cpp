@@ -1,4 +1,5 @@
 #include "video_splitter.h"
+#include "demuxer.h"
 #include <algorithm>
 #include <iostream>
 #include <sstream>
@@ -147,11 +148,8 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
                                   const std::string& outputPath,
                                   double startTime,
                                   double duration) {
-    AVFormatContext* inputFmt = nullptr;
     AVFormatContext* outputFmt = nullptr;
     
-    std::string inputShortPath = GetShortPath(inputPath);
-    
     // Create output file first to get short path
     {
         std::wstring wideOutPath = Utf8ToWide(outputPath);
@@ -166,28 +164,28 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
     
     std::string outputShortPath = GetShortPath(outputPath);
     
-    // Open input
-    if (avformat_open_input(&inputFmt, inputShortPath.c_str(), nullptr, nullptr) < 0) {
+    // Open input through Demuxer for its read-ahead; it closes the input on return
+    Demuxer demuxer;
+    demuxer.setMemoryMapped(mappedInput_);
+    // Stream copy needs no more than the header describes.
+    demuxer.setProbe(Demuxer::Probe::Header);
+    if (!demuxer.open(inputPath)) {
         std::cerr << "Could not open input file" << std::endl;
         return false;
     }
-    
-    if (avformat_find_stream_info(inputFmt, nullptr) < 0) {
-        std::cerr << "Could not find stream info" << std::endl;
-        avformat_close_input(&inputFmt);
-        return false;
-    }
+    AVFormatContext* inputFmt = demuxer.getFormatContext();
+    // The player leaves an index sidecar behind for files it has opened.
+    demuxer.setIndex(SeekIndex::load(inputPath));
     
     // Seek to start time
     int64_t startPts = (int64_t)(startTime * AV_TIME_BASE);
-    if (av_seek_frame(inputFmt, -1, startPts, AVSEEK_FLAG_BACKWARD) < 0) {
+    if (!demuxer.seekIndexed(startPts)) {
         std::cerr << "Seek failed" << std::endl;
     }
     
     // Create output
     if (avformat_alloc_output_context2(&outputFmt, nullptr, nullptr, outputShortPath.c_str()) < 0) {
         std::cerr << "Could not create output context" << std::endl;
-        avformat_close_input(&inputFmt);
         return false;
     }
     
@@ -199,7 +197,6 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
         if (!outStream) {
             std::cerr << "Failed to allocate output stream" << std::endl;
             avformat_free_context(outputFmt);
-            avformat_close_input(&inputFmt);
             return false;
         }
         
@@ -213,7 +210,6 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
         if (avio_open(&outputFmt->pb, outputShortPath.c_str(), AVIO_FLAG_WRITE) < 0) {
             std::cerr << "Could not open output file" << std::endl;
             avformat_free_context(outputFmt);
-            avformat_close_input(&inputFmt);
             return false;
         }
     }
@@ -224,15 +220,22 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
         if (!(outputFmt->oformat->flags & AVFMT_NOFILE))
             avio_closep(&outputFmt->pb);
         avformat_free_context(outputFmt);
-        avformat_close_input(&inputFmt);
         return false;
     }
     
     // Copy packets
-    AVPacket* pkt = av_packet_alloc();
-    int64_t endPts = (int64_t)((startTime + duration) * AV_TIME_BASE);
+    AVPacket* pkt = packetPool.acquire();
+    // Packet timestamps count from the input's start time, which seekIndexed() adds itself.
+    int64_t endPts = (int64_t)((startTime + duration) * AV_TIME_BASE) + demuxer.getStartTime();
+    bool cancelled = false;
     
     while (av_read_frame(inputFmt, pkt) >= 0) {
+        if (!control_->checkpoint()) {
+            av_packet_unref(pkt);
+            cancelled = true;
+            break;
+        }
+        
         AVStream* inStream = inputFmt->streams[pkt->stream_index];
         AVStream* outStream = outputFmt->streams[pkt->stream_index];
         
@@ -258,7 +261,7 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
         av_packet_unref(pkt);
     }
     
-    av_packet_free(&pkt);
+    packetPool.release(pkt);
     
     // Write trailer
     av_write_trailer(outputFmt);
@@ -267,7 +270,12 @@ bool VideoSplitter::exportSegment(const std::string& inputPath,
     if (!(outputFmt->oformat->flags & AVFMT_NOFILE))
         avio_closep(&outputFmt->pb);
     avformat_free_context(outputFmt);
-    avformat_close_input(&inputFmt);
+    
+    if (cancelled) {
+        std::error_code ec;
+        fs::remove(Utf8ToPath(outputPath), ec);
+        return false;
+    }
     
     return true;
 }
@@ -310,7 +318,11 @@ bool VideoSplitter::exportSegments(const std::string& inputPath,
         std::cout << "Exporting segment: " << outputPathStr << std::endl;
         
         if (!exportSegment(inputPath, outputPathStr, segment.startTime, segment.getDuration())) {
-            std::cerr << "Failed to export segment: " << segment.name << std::endl;
+            if (control_->isCancelled()) {
+                std::cout << "Export cancelled" << std::endl;
+            } else {
+                std::cerr << "Failed to export segment: " << segment.name << std::endl;
+            }
             return false;
         }
     }
@@ -522,8 +534,15 @@ bool VideoSplitter::exportSegmentsMerged(const std::string& inputPath,
     }
     
     // Copy packets
-    AVPacket* pkt = av_packet_alloc();
+    AVPacket* pkt = packetPool.acquire();
+    bool cancelled = false;
     while (av_read_frame(inputFmt, pkt) >= 0) {
+        if (!control_->checkpoint()) {
+            av_packet_unref(pkt);
+            cancelled = true;
+            break;
+        }
+        
         AVStream* inStream = inputFmt->streams[pkt->stream_index];
         AVStream* outStream = outputFmt->streams[pkt->stream_index];
         
@@ -541,7 +560,7 @@ bool VideoSplitter::exportSegmentsMerged(const std::string& inputPath,
         av_packet_unref(pkt);
     }
     
-    av_packet_free(&pkt);
+    packetPool.release(pkt);
     av_write_trailer(outputFmt);
     
     // Cleanup
@@ -555,6 +574,15 @@ bool VideoSplitter::exportSegmentsMerged(const std::string& inputPath,
     }
     fs::remove_all(tempDir);
     
+    if (cancelled) {
+        std::error_code ec;
+        fs::remove(Utf8ToPath(outputPath), ec);
+        if (callback) {
+            callback(total + 1, total + 1, "Merge cancelled");
+        }
+        return false;
+    }
+    
     if (callback) {
         callback(total + 1, total + 1, "Merge completed!");
     }
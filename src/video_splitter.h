@@ -4,6 +4,9 @@
 #include <vector>
 #include <functional>
 
+#include "media_pool.h"
+#include "transcode_control.h"
+
 struct CutPoint {
     double time;
     std::string name;
@@ -38,6 +41,13 @@ public:
     std::vector<Segment> getSegments(double videoDuration) const;
     
     // Export
+    // Pause/cancel token checked once per copied packet; cancelling removes partial output.
+    void setControl(TranscodeControl* control) { control_ = control ? control : &ownControl_; }
+    TranscodeControl& control() { return *control_; }
+    // Read the input through a memory mapping (see Demuxer::setMemoryMapped); segments are
+    // stream copies, so this takes the read syscalls out of most of the work.
+    void setMappedInput(bool enabled) { mappedInput_ = enabled; }
+
     using ProgressCallback = std::function<void(int current, int total, const std::string& message)>;
     bool exportSegments(const std::string& inputPath, 
                        const std::string& outputDir,
@@ -51,6 +61,10 @@ public:
     
 private:
     std::vector<CutPoint> cutPoints;
+    PacketPool packetPool;
+    TranscodeControl ownControl_;
+    TranscodeControl* control_ = &ownControl_;
+    bool mappedInput_ = false;
     
     bool exportSegment(const std::string& inputPath,
                       const std::string& outputPath,